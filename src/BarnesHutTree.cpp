@@ -0,0 +1,219 @@
+#include "BarnesHutTree.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+int const BarnesHutTree::kTopDepth{3};
+std::size_t const BarnesHutTree::kLeafSize{8};
+int const BarnesHutTree::kMaxSubtreeDepth{16};
+
+namespace {
+
+// each opened node replaces itself with its four children, so the stack grows by 3 per level
+std::size_t const kStackSize{64};
+
+// index of a top-level cell in depth-first order, x in the even bits
+std::uint32_t topCellIndex(glm::ivec2 const& cell)
+{
+    std::uint32_t index{0};
+    for (int bit = 0; bit < BarnesHutTree::kTopDepth; bit++)
+    {
+        index |= ((static_cast<std::uint32_t>(cell.x) >> bit) & 1u) << (2 * bit);
+        index |= ((static_cast<std::uint32_t>(cell.y) >> bit) & 1u) << (2 * bit + 1);
+    }
+    return index;
+}
+
+glm::ivec2 topCell(std::uint32_t index)
+{
+    glm::ivec2 cell{0, 0};
+    for (int bit = 0; bit < BarnesHutTree::kTopDepth; bit++)
+    {
+        cell.x |= static_cast<int>((index >> (2 * bit)) & 1u) << bit;
+        cell.y |= static_cast<int>((index >> (2 * bit + 1)) & 1u) << bit;
+    }
+    return cell;
+}
+
+} // namespace
+
+void BarnesHutTree::build(glm::vec2 const* positions, std::size_t count, glm::vec2 const& lower, glm::vec2 const& upper)
+{
+    glm::vec2 extent = upper - lower;
+    m_origin = lower;
+    m_size = std::max(extent.x, extent.y);
+    m_nodes.clear();
+    m_points.resize(count);
+    if (count == 0) return;
+
+    // counting sort into the top-level cells, in the order their subtrees end up in
+    int const cellsPerSide = 1 << kTopDepth;
+    std::size_t const cellCount = static_cast<std::size_t>(cellsPerSide) * cellsPerSide;
+    float const toCell = cellsPerSide / m_size;
+    m_cellStart.assign(cellCount + 1, 0u);
+    m_pointCells.resize(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        glm::vec2 cell = (positions[i] - m_origin) * toCell;
+        std::uint32_t index = topCellIndex(glm::ivec2{std::clamp(static_cast<int>(cell.x), 0, cellsPerSide - 1),
+                                                      std::clamp(static_cast<int>(cell.y), 0, cellsPerSide - 1)});
+        m_pointCells[i] = index;
+        m_cellStart[index]++;
+    }
+    std::uint32_t offset{0};
+    for (std::size_t c = 0; c < cellCount; c++)
+    {
+        std::uint32_t cellPoints = m_cellStart[c];
+        m_cellStart[c] = offset;
+        offset += cellPoints;
+    }
+    for (std::size_t i = 0; i < count; i++)
+    {
+        m_points[m_cellStart[m_pointCells[i]]++] = positions[i];
+    }
+    for (std::size_t c = cellCount; c > 0; c--)
+    {
+        m_cellStart[c] = m_cellStart[c - 1];
+    }
+    m_cellStart[0] = 0u;
+
+    // the subtrees only touch their own cell's points and node pool
+    m_subtrees.resize(cellCount);
+    float const cellSize = m_size / cellsPerSide;
+    ThreadPool::instance().parallelFor(cellCount, 4, [this, cellSize](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t c = begin; c < end; c++)
+        {
+            auto& nodes = m_subtrees[c];
+            nodes.clear();
+            nodes.push_back(Node{});
+            glm::vec2 origin = m_origin + cellSize * glm::vec2{topCell(static_cast<std::uint32_t>(c))};
+            buildSubtree(nodes, 0, m_cellStart[c], m_cellStart[c + 1], origin, cellSize, 0);
+        }
+    });
+
+    m_nodes.push_back(Node{});
+    buildTop(0, 0, glm::ivec2{0, 0});
+}
+
+void BarnesHutTree::buildSubtree(std::vector<Node>& nodes, std::uint32_t index, std::uint32_t begin, std::uint32_t end,
+                                 glm::vec2 const& origin, float size, int depth)
+{
+    Node node{};
+    node.size = size;
+    node.firstPoint = begin;
+    node.pointCount = end - begin;
+    node.mass = static_cast<float>(node.pointCount);
+    glm::vec2 sum{0.0f, 0.0f};
+    for (std::uint32_t i = begin; i < end; i++) sum += m_points[i];
+    node.centerOfMass = node.pointCount > 0 ? sum / node.mass : origin + 0.5f * glm::vec2{size, size};
+    if (node.pointCount <= kLeafSize || depth >= kMaxSubtreeDepth)
+    {
+        nodes[index] = node;
+        return;
+    }
+
+    // children in the order (low x, low y), (high x, low y), (low x, high y), (high x, high y)
+    glm::vec2 const center = origin + 0.5f * glm::vec2{size, size};
+    auto first = m_points.begin() + begin;
+    auto last = m_points.begin() + end;
+    auto yMiddle = std::partition(first, last, [&center](glm::vec2 const& p) { return p.y < center.y; });
+    auto lowXMiddle = std::partition(first, yMiddle, [&center](glm::vec2 const& p) { return p.x < center.x; });
+    auto highXMiddle = std::partition(yMiddle, last, [&center](glm::vec2 const& p) { return p.x < center.x; });
+    std::array<std::uint32_t, 5> bounds{begin,
+                                        static_cast<std::uint32_t>(lowXMiddle - m_points.begin()),
+                                        static_cast<std::uint32_t>(yMiddle - m_points.begin()),
+                                        static_cast<std::uint32_t>(highXMiddle - m_points.begin()),
+                                        end};
+
+    node.firstChild = static_cast<std::uint32_t>(nodes.size());
+    nodes[index] = node;
+    nodes.resize(nodes.size() + 4);
+    float const half = 0.5f * size;
+    for (std::uint32_t q = 0; q < 4; q++)
+    {
+        glm::vec2 childOrigin = origin + half * glm::vec2{static_cast<float>(q & 1u), static_cast<float>(q >> 1)};
+        buildSubtree(nodes, node.firstChild + q, bounds[q], bounds[q + 1], childOrigin, half, depth + 1);
+    }
+}
+
+void BarnesHutTree::buildTop(std::uint32_t index, int depth, glm::ivec2 const& cell)
+{
+    auto const firstChild = static_cast<std::uint32_t>(m_nodes.size());
+    m_nodes.resize(m_nodes.size() + 4);
+    for (std::uint32_t q = 0; q < 4; q++)
+    {
+        glm::ivec2 childCell{2 * cell.x + static_cast<int>(q & 1u), 2 * cell.y + static_cast<int>(q >> 1)};
+        if (depth + 1 < kTopDepth)
+        {
+            buildTop(firstChild + q, depth + 1, childCell);
+            continue;
+        }
+        // a subtree's root takes the child's place, the rest goes at the end with its links moved along
+        auto const& subtree = m_subtrees[topCellIndex(childCell)];
+        auto const base = static_cast<std::uint32_t>(m_nodes.size());
+        auto relocate = [base](Node node)
+        {
+            if (node.firstChild != 0) node.firstChild += base - 1;
+            return node;
+        };
+        m_nodes[firstChild + q] = relocate(subtree[0]);
+        for (std::size_t k = 1; k < subtree.size(); k++) m_nodes.push_back(relocate(subtree[k]));
+    }
+
+    Node node{};
+    node.size = m_size / static_cast<float>(1 << depth);
+    node.firstChild = firstChild;
+    node.firstPoint = m_nodes[firstChild].firstPoint;
+    glm::vec2 weightedSum{0.0f, 0.0f};
+    for (std::uint32_t q = 0; q < 4; q++)
+    {
+        Node const& child = m_nodes[firstChild + q];
+        node.mass += child.mass;
+        node.pointCount += child.pointCount;
+        weightedSum += child.mass * child.centerOfMass;
+    }
+    node.centerOfMass = node.mass > 0.0f ? weightedSum / node.mass : m_origin;
+    m_nodes[index] = node;
+}
+
+glm::vec2 BarnesHutTree::field(glm::vec2 const& p, float openingAngle, float softening) const
+{
+    if (m_points.empty()) return glm::vec2{0.0f, 0.0f};
+    float const squaredOpeningAngle = openingAngle * openingAngle;
+    float const squaredSoftening = softening * softening;
+
+    glm::vec2 sum{0.0f, 0.0f};
+    auto pull = [&](glm::vec2 const& q, float mass)
+    {
+        glm::vec2 d = q - p;
+        float inverseDistance = 1.0f / std::sqrt(d.x * d.x + d.y * d.y + squaredSoftening);
+        sum += d * (mass * inverseDistance * inverseDistance * inverseDistance);
+    };
+
+    std::array<std::uint32_t, kStackSize> stack;
+    std::size_t top{0};
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        Node const& node = m_nodes[stack[--top]];
+        if (node.mass <= 0.0f) continue;
+        glm::vec2 d = node.centerOfMass - p;
+        if (node.size * node.size < squaredOpeningAngle * (d.x * d.x + d.y * d.y))
+        {
+            pull(node.centerOfMass, node.mass);
+            continue;
+        }
+        if (node.firstChild == 0)
+        {
+            for (std::uint32_t i = node.firstPoint; i < node.firstPoint + node.pointCount; i++)
+            {
+                if (m_points[i] != p) pull(m_points[i], 1.0f);
+            }
+            continue;
+        }
+        for (std::uint32_t q = 0; q < 4; q++) stack[top++] = node.firstChild + q;
+    }
+    return sum / static_cast<float>(m_points.size());
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Quadtree of point masses for evaluating the pull of n points on each other in O(n log n), after
+// Barnes and Hut: nodes that look smaller than openingAngle from the evaluated position count as
+// one mass at their center of mass.
+// build() counting-sorts the points into a fixed grid of top-level cells, builds the subtree of every
+// top-level cell on the library thread pool and then stitches them under the top levels. Nodes are
+// stored depth first with the four children of a node next to each other, and the points of a leaf
+// are contiguous, so evaluation walks mostly sequential memory. All of it is reused between builds.
+// field() may run on several threads at once, but not at the same time as build().
+struct BarnesHutTree
+{
+    // points outside lower..upper count as if on its edge for placing them in the tree
+    void build(glm::vec2 const* positions, std::size_t count, glm::vec2 const& lower, glm::vec2 const& upper);
+
+    // mean over the points of (q - p) / (|q - p|^2 + softening^2)^(3/2), i.e. gravity of total mass 1
+    // towards them, skipping points exactly at p
+    glm::vec2 field(glm::vec2 const& p, float openingAngle, float softening) const;
+
+    std::size_t pointCount() const { return m_points.size(); }
+    std::size_t nodeCount() const { return m_nodes.size(); }
+
+    // top-level cells per side are 2^kTopDepth
+    static int const kTopDepth;
+    static std::size_t const kLeafSize;
+    static int const kMaxSubtreeDepth;
+
+private:
+    struct Node
+    {
+        glm::vec2 centerOfMass;
+        float mass;
+        // side length of the node's square
+        float size;
+        // index of the first of four children, 0 for leaves (the root is never a child)
+        std::uint32_t firstChild;
+        std::uint32_t firstPoint;
+        std::uint32_t pointCount;
+    };
+
+    void buildSubtree(std::vector<Node>& nodes, std::uint32_t index, std::uint32_t begin, std::uint32_t end,
+                      glm::vec2 const& origin, float size, int depth);
+    void buildTop(std::uint32_t index, int depth, glm::ivec2 const& cell);
+
+    std::vector<Node> m_nodes;
+    std::vector<glm::vec2> m_points;
+    std::vector<std::vector<Node>> m_subtrees;
+    std::vector<std::uint32_t> m_cellStart;
+    std::vector<std::uint32_t> m_pointCells;
+    glm::vec2 m_origin{};
+    float m_size{1.0f};
+};
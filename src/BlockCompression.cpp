@@ -0,0 +1,157 @@
+#include "BlockCompression.h"
+
+#include <cstring>
+
+namespace {
+
+std::size_t const kMinMatch{4};
+std::size_t const kLastLiterals{5};
+std::size_t const kMatchSafeDistance{12};
+std::size_t const kMaxOffset{65535};
+unsigned const kHashBits{14};
+
+std::uint32_t read32(std::uint8_t const* p)
+{
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+std::uint32_t hash(std::uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+void writeLength(std::vector<std::uint8_t>& destination, std::size_t length)
+{
+    while (length >= 255)
+    {
+        destination.push_back(255);
+        length -= 255;
+    }
+    destination.push_back(static_cast<std::uint8_t>(length));
+}
+
+void writeSequence(std::vector<std::uint8_t>& destination, std::uint8_t const* pLiterals, std::size_t literalLength, std::size_t offset, std::size_t matchLength)
+{
+    std::size_t const tokenLiteral = literalLength < 15 ? literalLength : 15;
+    std::size_t const matchCode = matchLength - kMinMatch;
+    std::size_t const tokenMatch = matchLength == 0 ? 0 : (matchCode < 15 ? matchCode : 15);
+    destination.push_back(static_cast<std::uint8_t>((tokenLiteral << 4) | tokenMatch));
+    if (literalLength >= 15) writeLength(destination, literalLength - 15);
+    destination.insert(destination.end(), pLiterals, pLiterals + literalLength);
+    if (matchLength == 0) return;
+    destination.push_back(static_cast<std::uint8_t>(offset & 0xff));
+    destination.push_back(static_cast<std::uint8_t>(offset >> 8));
+    if (matchCode >= 15) writeLength(destination, matchCode - 15);
+}
+
+} // namespace
+
+std::size_t compressBound(std::size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+void compressBlock(std::uint8_t const* pSource, std::size_t size, std::vector<std::uint8_t>& destination)
+{
+    destination.clear();
+    destination.reserve(compressBound(size));
+
+    std::uint8_t const* pLiterals = pSource;
+    std::uint8_t const* const pEnd = pSource + size;
+    if (size < kMatchSafeDistance + 1)
+    {
+        writeSequence(destination, pLiterals, size, 0, 0);
+        return;
+    }
+
+    std::uint8_t const* const pMatchLimit = pEnd - kMatchSafeDistance;
+    std::uint8_t const* const pCopyLimit = pEnd - kLastLiterals;
+    std::vector<std::uint32_t> table(std::size_t{1} << kHashBits, 0);
+
+    std::uint8_t const* p = pSource + 1;
+    while (p < pMatchLimit)
+    {
+        std::uint32_t sequence = read32(p);
+        std::uint32_t& entry = table[hash(sequence)];
+        std::uint8_t const* pCandidate = pSource + entry;
+        entry = static_cast<std::uint32_t>(p - pSource);
+
+        if (pCandidate >= p || static_cast<std::size_t>(p - pCandidate) > kMaxOffset || read32(pCandidate) != sequence)
+        {
+            p++;
+            continue;
+        }
+
+        // extend the match backwards over pending literals, then forwards
+        while (p > pLiterals && pCandidate > pSource && p[-1] == pCandidate[-1])
+        {
+            p--;
+            pCandidate--;
+        }
+        std::uint8_t const* pMatchEnd = p + kMinMatch;
+        std::uint8_t const* pCandidateEnd = pCandidate + kMinMatch;
+        while (pMatchEnd < pCopyLimit && *pMatchEnd == *pCandidateEnd)
+        {
+            pMatchEnd++;
+            pCandidateEnd++;
+        }
+
+        writeSequence(destination, pLiterals, static_cast<std::size_t>(p - pLiterals),
+                      static_cast<std::size_t>(p - pCandidate), static_cast<std::size_t>(pMatchEnd - p));
+        p = pMatchEnd;
+        pLiterals = p;
+    }
+    writeSequence(destination, pLiterals, static_cast<std::size_t>(pEnd - pLiterals), 0, 0);
+}
+
+Error decompressBlock(std::uint8_t const* pSource, std::size_t size, std::vector<std::uint8_t>& destination, std::size_t decompressedSize)
+{
+    destination.resize(decompressedSize);
+    std::uint8_t* pOut = destination.data();
+    std::uint8_t* const pOutEnd = pOut + decompressedSize;
+    std::uint8_t const* p = pSource;
+    std::uint8_t const* const pEnd = pSource + size;
+
+    auto readLength = [&p, pEnd](std::size_t& length) -> bool
+    {
+        std::uint8_t byte;
+        do
+        {
+            if (p >= pEnd) return false;
+            byte = *p++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    while (p < pEnd)
+    {
+        std::uint8_t token = *p++;
+        std::size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(literalLength)) return makeError("truncated literal length");
+        if (literalLength > static_cast<std::size_t>(pEnd - p) || literalLength > static_cast<std::size_t>(pOutEnd - pOut))
+        {
+            return makeError("literals overrun block");
+        }
+        std::memcpy(pOut, p, literalLength);
+        pOut += literalLength;
+        p += literalLength;
+        if (p == pEnd) break;
+
+        if (pEnd - p < 2) return makeError("truncated match offset");
+        std::size_t offset = p[0] | (std::size_t{p[1]} << 8);
+        p += 2;
+        std::size_t matchLength = token & 0x0f;
+        if (matchLength == 15 && !readLength(matchLength)) return makeError("truncated match length");
+        matchLength += kMinMatch;
+        if (offset == 0 || offset > static_cast<std::size_t>(pOut - destination.data())) return makeError("match offset out of range");
+        if (matchLength > static_cast<std::size_t>(pOutEnd - pOut)) return makeError("match overruns block");
+        std::uint8_t const* pMatch = pOut - offset;
+        for (std::size_t i = 0; i < matchLength; i++) pOut[i] = pMatch[i];
+        pOut += matchLength;
+    }
+    if (pOut != pOutEnd) return makeError("decompressed", pOut - destination.data(), "bytes, expected", decompressedSize);
+    return nil;
+}
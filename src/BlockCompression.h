@@ -0,0 +1,13 @@
+#pragma once
+
+#include "Error.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Small LZ77 block codec writing the LZ4 block format (token, literals, 16 bit offset, match length),
+// greedy with a single-entry hash table: fast enough to run behind a live recording and to decode
+// at I/O speed.
+std::size_t compressBound(std::size_t size);
+void compressBlock(std::uint8_t const* pSource, std::size_t size, std::vector<std::uint8_t>& destination);
+Error decompressBlock(std::uint8_t const* pSource, std::size_t size, std::vector<std::uint8_t>& destination, std::size_t decompressedSize);
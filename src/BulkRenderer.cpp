@@ -2,58 +2,161 @@
 #include "Trace.h"
 #include "Utils.h"
 #include <glm/glm.hpp>
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
 
-BulkRenderer::BulkRenderer(GLuint const& traceProgram, GLuint const& vertexBuffer)
-    : program{traceProgram}
-    , buffer{vertexBuffer}
+BulkRenderer::BulkRenderer(std::shared_ptr<const GLuint> pTraceProgram, std::shared_ptr<const GLuint> pVertexBuffer, float windowHeightOverWidth_)
+    : pProgram{pTraceProgram}
+    , pBuffer{pVertexBuffer}
+    , windowHeightOverWidth{windowHeightOverWidth_}
+    , viewScale{windowHeightOverWidth_, 1.0f}
 {}
 
 void BulkRenderer::add(std::shared_ptr<Trace> pTrace)
 {
-    vpTraces.push_back(pTrace);
+    if (!pTrace) return;
+    addSegment(pTrace->prevPosition_, pTrace->position_);
+}
+
+void BulkRenderer::addSegment(glm::vec2 const& from, glm::vec2 const& to)
+{
+    segmentVertices.push_back(from);
+    segmentVertices.push_back(to);
+}
+
+void BulkRenderer::addPoint(glm::vec2 const& point)
+{
+    pointVertices.push_back(point);
+}
+
+void BulkRenderer::addSegments(glm::vec2 const* vertices, std::size_t vertexCount)
+{
+    segmentVertices.insert(segmentVertices.end(), vertices, vertices + vertexCount);
+}
+
+void BulkRenderer::addPoints(glm::vec2 const* points, std::size_t count)
+{
+    pointVertices.insert(pointVertices.end(), points, points + count);
+}
+
+void BulkRenderer::reserve(std::size_t segmentCount, std::size_t pointCount)
+{
+    // bufferData() appends the points to the segment vertices
+    segmentVertices.reserve(2 * segmentCount + pointCount);
+    pointVertices.reserve(pointCount);
+}
+
+void BulkRenderer::takeVertices(std::vector<glm::vec2>& segmentVertices_, std::vector<glm::vec2>& points)
+{
+    segmentVertices.swap(segmentVertices_);
+    pointVertices.swap(points);
+    segmentVertices.clear();
+    pointVertices.clear();
 }
 
 void BulkRenderer::bufferData()
 {
-    glUseProgram(program);
-    std::vector<glm::vec2> vs;
-    for (auto const pTrace : vpTraces)
-    {
-        if (!pTrace) continue;
-        vs.push_back(pTrace->prevPosition_);
-        vs.push_back(pTrace->position_);
-    }
-    glBindBuffer(GL_ARRAY_BUFFER, buffer);
-    glBufferData(GL_ARRAY_BUFFER, static_cast<int>(vs.size()) * sizeof(vs[0]), vs.data(), GL_STATIC_DRAW);
+    // segments first, points right after them in the same buffer
+    segmentVertexCount = static_cast<GLsizei>(segmentVertices.size());
+    pointVertexCount = static_cast<GLsizei>(pointVertices.size());
+    segmentVertices.insert(segmentVertices.end(), pointVertices.begin(), pointVertices.end());
+
+    glBindBuffer(GL_ARRAY_BUFFER, *pBuffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<int>(segmentVertices.size()) * sizeof(glm::vec2), segmentVertices.data(), GL_STREAM_DRAW);
     glBindBuffer(GL_ARRAY_BUFFER, InvalidId);
-    glUseProgram(InvalidId);
+
+    segmentVertices.clear();
+    pointVertices.clear();
 }
 
 void BulkRenderer::render()
 {
-    if (program == InvalidId) return;
+    if (program() == InvalidId) return;
 
-    glUseProgram(program);
+    use();
+    draw();
+    unuse();
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+void BulkRenderer::use()
+{
+    glUseProgram(program());
+}
+
+void BulkRenderer::draw()
+{
+    glm::mat2 toNormalCoordinates{
+        glm::vec2{viewScale.x, 0.0f},
+        glm::vec2{0.0f, viewScale.y}};
+    glUniformMatrix2fv(glGetUniformLocation(program(), "toNormalCoordinates"),
+                       1,
+                       GL_FALSE,
+                       glm::value_ptr(toNormalCoordinates));
+    glUniform2f(glGetUniformLocation(program(), "normalOffset"), viewOffset.x, viewOffset.y);
+    glUniform3f(glGetUniformLocation(program(), "color"), color.r, color.g, color.b);
+    glUniform3f(glGetUniformLocation(program(), "secondaryColor"), secondaryColor.r, secondaryColor.g, secondaryColor.b);
+    glLineWidth(lineWidth);
+    glPointSize(lineWidth);
 
-    GLint positionLocation = glGetAttribLocation(program, "positionMonometric");
+    glBindBuffer(GL_ARRAY_BUFFER, *pBuffer);
+
+    GLint positionLocation = glGetAttribLocation(program(), "positionMonometric");
     glVertexAttribPointer(positionLocation, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
     glEnableVertexAttribArray(positionLocation);
 
-    glDrawArrays(GL_LINES, 0, vpTraces.size() * sizeof(vpTraces[0]));
+    if (segmentVertexCount > 0)
+    {
+        if (lineAntialiasing)
+        {
+            glEnable(GL_LINE_SMOOTH);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        }
+        glDrawArrays(GL_LINES, 0, segmentVertexCount);
+        if (lineAntialiasing)
+        {
+            glDisable(GL_BLEND);
+            glDisable(GL_LINE_SMOOTH);
+        }
+    }
+    if (pointVertexCount > 0) glDrawArrays(GL_POINTS, segmentVertexCount, pointVertexCount);
 
     glDisableVertexAttribArray(positionLocation);
+}
+
+void BulkRenderer::unuse()
+{
     glBindBuffer(GL_ARRAY_BUFFER, InvalidId);
     glUseProgram(InvalidId);
+}
 
-    vpTraces.clear();
+void BulkRenderer::setColor(glm::vec3 const& color_)
+{
+    color = color_;
 }
 
-void BulkRenderer::setColor(glm::vec3 const& color)
+void BulkRenderer::setSecondaryColor(glm::vec3 const& color_)
 {
-    if (program == InvalidId) return;
-    glUseProgram(program);
-    glUniform3f(glGetUniformLocation(program, "color"), color.r, color.g, color.b);
-    glUseProgram(InvalidId);
+    secondaryColor = color_;
+}
+
+void BulkRenderer::setLineWidth(float width)
+{
+    lineWidth = std::max(width, 1.0f);
+}
+
+GLuint BulkRenderer::program() const
+{
+    return pProgram ? *pProgram : InvalidId;
+}
+
+void BulkRenderer::setLineAntialiasing(bool enabled)
+{
+    lineAntialiasing = enabled;
+}
+
+void BulkRenderer::setView(glm::vec2 const& lower, glm::vec2 const& upper)
+{
+    viewScale = glm::vec2{2.0f / (upper.x - lower.x), 2.0f / (upper.y - lower.y)};
+    viewOffset = glm::vec2{-1.0f - lower.x * viewScale.x, -1.0f - lower.y * viewScale.y};
 }
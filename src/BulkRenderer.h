@@ -1,7 +1,9 @@
 #pragma once
 
 #include <GL/glew.h>
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <cstddef>
 #include <memory>
 #include <vector>
 
@@ -9,17 +11,54 @@ struct Trace;
 
 struct BulkRenderer
 {
-    BulkRenderer(GLuint const& traceProgram, GLuint const& vertexBuffer);
+    BulkRenderer(std::shared_ptr<const GLuint> pTraceProgram, std::shared_ptr<const GLuint> pVertexBuffer, float windowHeightOverWidth);
     ~BulkRenderer() = default;
 
     void add(std::shared_ptr<Trace> pTrace);
+    void addSegment(glm::vec2 const& from, glm::vec2 const& to);
+    void addPoint(glm::vec2 const& point);
+    // vertexCount / 2 segments from consecutive pairs of vertices
+    void addSegments(glm::vec2 const* vertices, std::size_t vertexCount);
+    void addPoints(glm::vec2 const* points, std::size_t count);
+    // room for segmentCount segments and pointCount points between two bufferData() calls
+    void reserve(std::size_t segmentCount, std::size_t pointCount);
+    // Hands the segment vertices and points added since the last bufferData() to the caller instead of
+    // drawing them. The vectors' previous contents are dropped and their memory goes to the renderer.
+    void takeVertices(std::vector<glm::vec2>& segmentVertices, std::vector<glm::vec2>& points);
     void bufferData();
     void render();
 
+    // Batched variants: use() once, then draw() for every BulkRenderer sharing the same program, then unuse().
+    void use();
+    void draw();
+    void unuse();
+
     void setColor(glm::vec3 const& color);
+    // color at the top of the window, for programs built with kShaderColorGradient
+    void setSecondaryColor(glm::vec3 const& color);
+    // in pixels of the framebuffer drawn to, for segments and points alike
+    void setLineWidth(float width);
+    // smooths the edges of segments by blending their coverage into the framebuffer
+    void setLineAntialiasing(bool enabled);
+    // draws the rectangle from lower to upper, in monometric coordinates, over the whole viewport
+    // instead of the window
+    void setView(glm::vec2 const& lower, glm::vec2 const& upper);
+
+    GLuint program() const;
 
 private:
-    GLuint const& program;
-    GLuint const& buffer;
-    std::vector<std::shared_ptr<Trace>> vpTraces;
+    std::shared_ptr<const GLuint> pProgram;
+    std::shared_ptr<const GLuint> pBuffer;
+    float windowHeightOverWidth;
+    // normal coordinates are viewScale * monometric + viewOffset
+    glm::vec2 viewScale;
+    glm::vec2 viewOffset{0.0f, 0.0f};
+    glm::vec3 color;
+    glm::vec3 secondaryColor;
+    float lineWidth{1.0f};
+    bool lineAntialiasing{false};
+    std::vector<glm::vec2> segmentVertices;
+    std::vector<glm::vec2> pointVertices;
+    GLsizei segmentVertexCount{0};
+    GLsizei pointVertexCount{0};
 };
@@ -1,126 +1,181 @@
 #include "DoubleFramebuffer.h"
 #include "Program.h"
-#include "Shader.h"
+#include "ProgramCache.h"
 #include "ShaderSources.h"
 #include "Utils.h"
 #include <GL/glew.h>
+#include <iostream>
+#include <mutex>
 
-std::pair<std::shared_ptr<DoubleFramebuffer>, Error> DoubleFramebuffer::get(int width, int height)
-{
-    if (pInstance)
-        return std::make_pair(pInstance, nil);
-    if (!pInstance && creationError)
-        return std::make_pair(nullptr, creationError);
+char const* const DoubleFramebuffer::kSharedProgramKey{"texturedQuad"};
 
-    auto [pProgram, err] = makeQuadRenderProgram();
+std::pair<std::shared_ptr<DoubleFramebuffer>, Error> DoubleFramebuffer::make(int width, int height, ShaderFeatures feedbackFeatures)
+{
+    auto [pProgram, err] = getSharedProgram(shaderVariantKey(kSharedProgramKey, feedbackFeatures), [feedbackFeatures]
+    {
+        return makeQuadRenderProgram(feedbackFeatures);
+    });
     if (err != nil)
     {
         return std::make_pair(nullptr, makeError("could not create DoubleFramebuffer instance:", err.value()));
     }
+    return make(width, height, pProgram);
+}
 
-    pQuadRenderProgram = pProgram;
-    pQuadBuffer = genBuffer();
-    fillBuffer();
+std::pair<std::shared_ptr<DoubleFramebuffer>, Error> DoubleFramebuffer::make(int width, int height, std::shared_ptr<const GLuint> pFeedbackProgram)
+{
+    std::shared_ptr<DoubleFramebuffer> pDoubleFramebuffer{new (std::nothrow) DoubleFramebuffer()};
+    if (!pDoubleFramebuffer) return std::make_pair(nullptr, makeError("could not instantiate DoubleFramebuffer"));
 
-    screenSize.x = width;
-    screenSize.y = height;
+    pDoubleFramebuffer->pFeedbackProgram = pFeedbackProgram;
+    pDoubleFramebuffer->pQuadBuffer = getQuadBuffer();
+    pDoubleFramebuffer->screenSize = glm::ivec2{width, height};
 
-    glGenFramebuffers(2, framebuffers.data());
-    glGenTextures(2, textures.data());
     for (int i = 0; i < 2; i++)
     {
-        glBindTexture(GL_TEXTURE_2D, textures[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glBindTexture(GL_TEXTURE_2D, 0);
-
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[i]);
-        glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textures[i], 0);
-        if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        Error err;
+        std::tie(pDoubleFramebuffer->targets[i], err) = RenderTargetPool::acquire(glm::ivec2{width, height});
+        if (err != nil)
         {
-            glDeleteFramebuffers(2, framebuffers.data());
-            glDeleteTextures(2, textures.data());
-            auto eError = glGetError();
-            auto err = makeError("could not setup framebuffer", i, ":", glewGetErrorString(eError));
-            creationError = err;
-            return std::make_pair(nullptr, err);
+            return std::make_pair(nullptr, makeError("could not setup framebuffer", i, ":", err.value()));
         }
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, pDoubleFramebuffer->targets[i].framebuffer);
+        glClearColor(0, 0, 0, 1.0);
+        glClear(GL_COLOR_BUFFER_BIT);
     }
-    auto pDoubleFramebuffer = std::make_shared<DoubleFramebuffer>();
-    pDoubleFramebuffer.reset(new (std::nothrow) DoubleFramebuffer(), [](DoubleFramebuffer *pDfb)
-                             {
-                                 glDeleteFramebuffers(2, framebuffers.data());
-                                 glDeleteTextures(2, textures.data());
-                             });
 
-    pInstance->bindFramebuffer();
+    pDoubleFramebuffer->bindFramebuffer();
 
     return std::make_pair(pDoubleFramebuffer, nil);
 }
 
-void DoubleFramebuffer::renderPreviousFrame()
+DoubleFramebuffer::~DoubleFramebuffer()
 {
-    renderPreviousFrame(0.0f, 1.0f);
+    for (auto const& target : targets) RenderTargetPool::release(target);
 }
 
-void DoubleFramebuffer::renderPreviousFrame(float blurStandardDeviation, float fadeFactor)
+void DoubleFramebuffer::renderPreviousFrame()
 {
     if (noPreviousFrame) return;
-    glUseProgram(*pQuadRenderProgram);
+    useQuadProgram(*pFeedbackProgram);
+    drawPreviousFrame(*pFeedbackProgram, 0.0f, 1.0f);
+    unuseQuadProgram(*pFeedbackProgram);
+}
+
+void DoubleFramebuffer::useQuadProgram(GLuint program)
+{
+    if (program == InvalidId) return;
+    glUseProgram(program);
 
     glBindBuffer(GL_ARRAY_BUFFER, *pQuadBuffer);
-    GLint positionLocation = glGetAttribLocation(*pQuadRenderProgram, "position");
+    GLint positionLocation = glGetAttribLocation(program, "position");
     glVertexAttribPointer(positionLocation, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
     glEnableVertexAttribArray(positionLocation);
 
-    GLint frameTextureLocation = glGetUniformLocation(*pQuadRenderProgram, "frameTexture");
+    GLint frameTextureLocation = glGetUniformLocation(program, "frameTexture");
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textures[previousIndex()]);
     glUniform1i(frameTextureLocation, 0);
+}
+
+void DoubleFramebuffer::drawPreviousFrame(GLuint program, float blurStandardDeviation, float fadeFactor)
+{
+    if (noPreviousFrame || program == InvalidId) return;
+
+    glBindTexture(GL_TEXTURE_2D, targets[previousIndex()].texture);
 
-    GLint standardDeviationLocation = glGetUniformLocation(*pQuadRenderProgram, "standardDeviation");
+    // uniforms of features the variant was built without are not found, setting them does nothing
+    GLint standardDeviationLocation = glGetUniformLocation(program, "standardDeviation");
     glUniform1f(standardDeviationLocation, blurStandardDeviation);
 
-    GLint fadeFactorLocation = glGetUniformLocation(*pQuadRenderProgram, "fadeFactor");
+    GLint fadeFactorLocation = glGetUniformLocation(program, "fadeFactor");
     glUniform1f(fadeFactorLocation, fadeFactor);
 
-    GLint xCorrectionLocation = glGetUniformLocation(*pQuadRenderProgram, "xCorrection");
-    glUniform1f(xCorrectionLocation, static_cast<float>(screenSize.y)/screenSize.x);
+    GLint fadeStepLocation = glGetUniformLocation(program, "fadeStep");
+    glUniform1f(fadeStepLocation, 1.0f - fadeFactor);
 
+    GLint xCorrectionLocation = glGetUniformLocation(program, "xCorrection");
+    glUniform1f(xCorrectionLocation, static_cast<float>(screenSize.y)/screenSize.x);
 
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+void DoubleFramebuffer::drawToScreen(GLuint program)
+{
+    noPreviousFrame = false;
+
+    currentIndex_ = (currentIndex_ + 1) % 2;
+    if (!outputFramebuffer) return;
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, outputFramebuffer.value());
+    glm::ivec4 viewport = outputViewport.value_or(glm::ivec4{0, 0, screenSize.x, screenSize.y});
+    glViewport(viewport.x, viewport.y, viewport.z, viewport.w);
+    drawPreviousFrame(program, m_blurStandardDeviationOnBlitAndSwap, 1.0);
+}
 
+void DoubleFramebuffer::unuseQuadProgram(GLuint program)
+{
+    if (program == InvalidId) return;
+    GLint positionLocation = glGetAttribLocation(program, "position");
     glDisableVertexAttribArray(positionLocation);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
 }
 
 void DoubleFramebuffer::blitAndSwap()
 {
-    noPreviousFrame = false;
+    auto [pProgram, err] = presentProgram();
+    if (err != nil) std::cerr << "could not present frame: " << err.value() << std::endl;
+    GLuint program = pProgram ? *pProgram : InvalidId;
+    useQuadProgram(program);
+    drawToScreen(program);
+    unuseQuadProgram(program);
 
-    currentIndex_ = (currentIndex_ + 1) % 2;
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-    renderPreviousFrame(m_blurStandardDeviationOnBlitAndSwap, 1.0);
-    //glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-    //glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[currentIndex_]);
-    //glBlitFramebuffer(0, 0, screenSize.x, screenSize.y,
-    //                  0, 0, screenSize.x, screenSize.y,
-    //                  GL_COLOR_BUFFER_BIT, GL_NEAREST);
-    //glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    bindFramebuffer();
+}
+
+void DoubleFramebuffer::bindFramebuffer()
+{
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targets[currentIndex_].framebuffer);
+    glViewport(0, 0, targets[currentIndex_].size.x, targets[currentIndex_].size.y);
+}
+
+void DoubleFramebuffer::requestRenderSize(glm::ivec2 const& size)
+{
+    pendingRenderSize = glm::max(size, glm::ivec2{1, 1});
+}
+
+Error DoubleFramebuffer::applyRenderSize()
+{
+    if (!pendingRenderSize) return nil;
+    glm::ivec2 size = pendingRenderSize.value();
+    pendingRenderSize.reset();
+    if (size == renderSize()) return nil;
 
-    //currentIndex_ = (currentIndex_ + 1) % 2;
+    std::array<RenderTarget, 2> resized;
+    for (int i = 0; i < 2; i++)
+    {
+        Error err;
+        std::tie(resized[i], err) = RenderTargetPool::acquire(size);
+        if (err != nil)
+        {
+            for (int j = 0; j < i; j++) RenderTargetPool::release(resized[j]);
+            return makeError("could not resize framebuffer", i, ":", err.value());
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, targets[i].framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resized[i].framebuffer);
+        glBlitFramebuffer(0, 0, targets[i].size.x, targets[i].size.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 
+    for (auto const& target : targets) RenderTargetPool::release(target);
+    targets = resized;
     bindFramebuffer();
+    return nil;
 }
 
-void DoubleFramebuffer::bindFramebuffer()
+glm::ivec2 DoubleFramebuffer::renderSize() const
 {
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[currentIndex_]);
+    return targets[currentIndex_].size;
 }
 
 void DoubleFramebuffer::setBlurStandardDeviationOnBlitAndSwap(float standardDeviation)
@@ -133,33 +188,49 @@ float DoubleFramebuffer::blurStandardDeviationOnBlitAndSwap()
     return m_blurStandardDeviationOnBlitAndSwap;
 }
 
-std::pair<std::shared_ptr<const GLuint>, Error> DoubleFramebuffer::makeQuadRenderProgram()
+std::pair<std::shared_ptr<const GLuint>, Error> DoubleFramebuffer::presentProgram()
+{
+    ShaderFeatures features = presentFeatures(m_blurStandardDeviationOnBlitAndSwap);
+    auto& pProgram = presentPrograms[(features & kShaderBlur) ? 1 : 0];
+    if (pProgram) return std::make_pair(pProgram, nil);
+
+    Error err;
+    std::tie(pProgram, err) = getSharedProgram(shaderVariantKey(kSharedProgramKey, features), [features]
+    {
+        return makeQuadRenderProgram(features);
+    });
+    return std::make_pair(pProgram, err);
+}
+
+ShaderFeatures DoubleFramebuffer::presentFeatures(float blurStandardDeviation)
 {
-    auto [pVert, pFrag, err] = makeShaderPair(textureQuad_vert, texturedQuad_frag);
+    return blurStandardDeviation > 0.0f ? kShaderBlur : 0;
+}
+
+std::pair<std::shared_ptr<const GLuint>, Error> DoubleFramebuffer::makeQuadRenderProgram(ShaderFeatures features)
+{
+    auto [pProgram, err] = makeCachedProgram(textureQuad_vert, texturedQuad_frag, shaderDefines(features));
     if (err != nil)
     {
         return std::make_pair(nullptr, makeError("could not build texturedQuad program:", err.value()));
     }
-    auto [pProgram, err2] = makeProgram(pVert, pFrag);
-    if (err2 != nil)
-    {
-        return std::make_pair(nullptr, makeError("could not build texturedQuad program:", err2.value()));
-    }
     return std::make_pair(pProgram, nil);
 }
 
-int DoubleFramebuffer::currentIndex()
+std::pair<std::shared_ptr<PendingProgram>, Error> DoubleFramebuffer::startQuadRenderProgram(ShaderFeatures features)
 {
-    return currentIndex_;
+    return startCachedProgram(textureQuad_vert, texturedQuad_frag, shaderDefines(features));
 }
 
-int DoubleFramebuffer::previousIndex()
+std::shared_ptr<const GLuint> DoubleFramebuffer::getQuadBuffer()
 {
-    return (currentIndex_+1)%2;
-}
+    static std::mutex mutex;
+    static std::weak_ptr<const GLuint> wpQuadBuffer;
 
-void DoubleFramebuffer::fillBuffer()
-{
+    std::lock_guard<std::mutex> lock{mutex};
+    if (auto pQuadBuffer = wpQuadBuffer.lock()) return pQuadBuffer;
+
+    auto pQuadBuffer = genBuffer();
     glBindBuffer(GL_ARRAY_BUFFER, *pQuadBuffer);
     std::array<glm::vec2, 4> vs{
         glm::vec2{-1.0, -1.0},
@@ -169,16 +240,22 @@ void DoubleFramebuffer::fillBuffer()
     };
     glBufferData(GL_ARRAY_BUFFER, vs.size() * sizeof(vs[0]), vs.data(), GL_STATIC_DRAW);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    wpQuadBuffer = pQuadBuffer;
+    return pQuadBuffer;
+}
+
+int DoubleFramebuffer::currentIndex()
+{
+    return currentIndex_;
 }
 
-std::array<GLuint, 2> DoubleFramebuffer::textures;
-std::array<GLuint, 2> DoubleFramebuffer::framebuffers;
-bool DoubleFramebuffer::noPreviousFrame{true};
-std::shared_ptr<const GLuint> DoubleFramebuffer::pQuadRenderProgram;
-std::shared_ptr<const GLuint> DoubleFramebuffer::pQuadBuffer;
-glm::ivec2 DoubleFramebuffer::screenSize;
-int DoubleFramebuffer::currentIndex_{0};
-std::shared_ptr<DoubleFramebuffer> DoubleFramebuffer::pInstance;
-Error DoubleFramebuffer::creationError;
+RenderTarget const& DoubleFramebuffer::lastFrame() const
+{
+    return targets[(currentIndex_ + 1) % 2];
+}
 
-float DoubleFramebuffer::m_blurStandardDeviationOnBlitAndSwap{0.0f};
+int DoubleFramebuffer::previousIndex()
+{
+    return (currentIndex_+1)%2;
+}
@@ -1,41 +1,76 @@
 #pragma once
 
 #include "Error.h"
+#include "RenderTargetPool.h"
+#include "ShaderSources.h"
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <array>
 #include <memory>
+#include <optional>
 #include <utility>
 
+struct PendingProgram;
 
 struct DoubleFramebuffer
 {
-    static std::pair<std::shared_ptr<DoubleFramebuffer>, Error> get(int width, int height);
+    // feedbackFeatures select the quad program variant drawing the previous frame into the current one
+    static std::pair<std::shared_ptr<DoubleFramebuffer>, Error> make(int width, int height, ShaderFeatures feedbackFeatures = kShaderFade);
+    static std::pair<std::shared_ptr<DoubleFramebuffer>, Error> make(int width, int height, std::shared_ptr<const GLuint> pFeedbackProgram);
+    ~DoubleFramebuffer();
 
     void renderPreviousFrame();
-    void renderPreviousFrame(float blurStandardDeviation, float fadeFactor);
 
     void blitAndSwap();
 
     void bindFramebuffer();
 
+    // Renders the trails at size instead of screenSize from the next applyRenderSize() on, which
+    // takes targets of the new size from the RenderTargetPool and scales what was drawn so far into them.
+    void requestRenderSize(glm::ivec2 const& size);
+    Error applyRenderSize();
+    glm::ivec2 renderSize() const;
+
+    // Batched variants: useQuadProgram() once, then drawPreviousFrame()/drawToScreen() for every
+    // DoubleFramebuffer drawing with the same quad program, then unuseQuadProgram(). Passes with
+    // InvalidId as program draw nothing.
+    void useQuadProgram(GLuint program);
+    // blurStandardDeviation and fadeFactor only apply to programs built with the matching features
+    void drawPreviousFrame(GLuint program, float blurStandardDeviation, float fadeFactor);
+    void drawToScreen(GLuint program);
+    void unuseQuadProgram(GLuint program);
+
     void setBlurStandardDeviationOnBlitAndSwap(float standardDeviation);
     float blurStandardDeviationOnBlitAndSwap();
 
-    static std::pair<std::shared_ptr<const GLuint>, Error> makeQuadRenderProgram();
+    // quad program variant drawToScreen() needs for the current blur, built on first use
+    std::pair<std::shared_ptr<const GLuint>, Error> presentProgram();
+    static ShaderFeatures presentFeatures(float blurStandardDeviation);
+
+    static std::pair<std::shared_ptr<const GLuint>, Error> makeQuadRenderProgram(ShaderFeatures features);
+    // the quad program without waiting for the compiler, see startCachedProgram()
+    static std::pair<std::shared_ptr<PendingProgram>, Error> startQuadRenderProgram(ShaderFeatures features);
+    // name of the quad program variants in getSharedProgram(), see shaderVariantKey()
+    static char const* const kSharedProgramKey;
+    static std::shared_ptr<const GLuint> getQuadBuffer();
     int currentIndex();
+    // target holding the frame most recently finished by drawToScreen()
+    RenderTarget const& lastFrame() const;
     int previousIndex();
-    static void fillBuffer();
-
-    static std::array<GLuint, 2> textures; 
-    static std::array<GLuint, 2> framebuffers;
-    static bool noPreviousFrame;
-    static std::shared_ptr<const GLuint> pQuadRenderProgram;
-    static std::shared_ptr<const GLuint> pQuadBuffer;
-    static glm::ivec2 screenSize;
-    static int currentIndex_;
-    static std::shared_ptr<DoubleFramebuffer> pInstance;
-    static Error creationError;
-
-    static float m_blurStandardDeviationOnBlitAndSwap;
+
+    std::array<RenderTarget, 2> targets;
+    bool noPreviousFrame{true};
+    std::shared_ptr<const GLuint> pFeedbackProgram;
+    // present program variants without and with kShaderBlur, kept so that toggling the blur needs no relink
+    std::array<std::shared_ptr<const GLuint>, 2> presentPrograms;
+    std::shared_ptr<const GLuint> pQuadBuffer;
+    glm::ivec2 screenSize{};
+    std::optional<glm::ivec2> pendingRenderSize;
+    // framebuffer drawToScreen() presents to, none for offscreen contexts without a default framebuffer
+    std::optional<GLuint> outputFramebuffer{0u};
+    // x, y, width, height drawToScreen() covers in outputFramebuffer, none for the full screenSize
+    std::optional<glm::ivec4> outputViewport;
+    int currentIndex_{0};
+
+    float m_blurStandardDeviationOnBlitAndSwap{0.0f};
 };
@@ -0,0 +1,180 @@
+#include "FlowField.h"
+#include "Pgm.h"
+#include <algorithm>
+#include <cmath>
+#include <new>
+
+namespace {
+
+std::size_t const kCacheLineBytes{64};
+int const kCurlNoiseOctaves{3};
+
+float const kTwoPi{6.28318530718f};
+
+std::uint32_t hashCorner(int x, int y, std::uint32_t seed)
+{
+    std::uint32_t h = seed ^ (static_cast<std::uint32_t>(x) * 0x8da6b343u) ^ (static_cast<std::uint32_t>(y) * 0xd8163841u);
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    return h;
+}
+
+float gradientNoise(glm::vec2 const& p, std::uint32_t seed)
+{
+    glm::vec2 cell = glm::floor(p);
+    glm::vec2 f = p - cell;
+    glm::vec2 u = f * f * (glm::vec2{3.0f, 3.0f} - 2.0f * f);
+    auto corner = [&](int dx, int dy)
+    {
+        float angle = hashCorner(static_cast<int>(cell.x) + dx, static_cast<int>(cell.y) + dy, seed) * (kTwoPi / 4294967296.0f);
+        glm::vec2 offset = f - glm::vec2{static_cast<float>(dx), static_cast<float>(dy)};
+        return std::cos(angle) * offset.x + std::sin(angle) * offset.y;
+    };
+    float bottom = glm::mix(corner(0, 0), corner(1, 0), u.x);
+    float top = glm::mix(corner(0, 1), corner(1, 1), u.x);
+    return glm::mix(bottom, top, u.y);
+}
+
+float fractalNoise(glm::vec2 const& p, std::uint32_t seed)
+{
+    float sum{0.0f};
+    float amplitude{1.0f};
+    float frequency{1.0f};
+    for (int octave = 0; octave < kCurlNoiseOctaves; octave++)
+    {
+        sum += amplitude * gradientNoise(p * frequency, seed + static_cast<std::uint32_t>(octave));
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+    return sum;
+}
+
+} // namespace
+
+void FlowField::AlignedDelete::operator()(glm::vec2* p) const
+{
+    ::operator delete(p, std::align_val_t{kCacheLineBytes});
+}
+
+std::pair<std::shared_ptr<FlowField>, Error> FlowField::make(glm::ivec2 const& cells)
+{
+    if (cells.x <= 0 || cells.y <= 0) return std::make_pair(nullptr, makeError("invalid flow field size", cells.x, "x", cells.y));
+    std::shared_ptr<FlowField> pField{new (std::nothrow) FlowField()};
+    if (!pField) return std::make_pair(nullptr, makeError("could not instantiate FlowField"));
+
+    std::size_t const cellsPerLine = kCacheLineBytes / sizeof(glm::vec2);
+    pField->m_cells = cells;
+    pField->m_rowStride = (static_cast<std::size_t>(cells.x) + cellsPerLine - 1) / cellsPerLine * cellsPerLine;
+    std::size_t const count = pField->m_rowStride * cells.y;
+    auto pDirections = static_cast<glm::vec2*>(::operator new(count * sizeof(glm::vec2), std::align_val_t{kCacheLineBytes}, std::nothrow));
+    if (!pDirections) return std::make_pair(nullptr, makeError("could not allocate flow field of", cells.x, "x", cells.y, "cells"));
+    std::fill(pDirections, pDirections + count, glm::vec2{0.0f, 0.0f});
+    pField->m_pDirections.reset(pDirections);
+    return std::make_pair(pField, nil);
+}
+
+std::pair<std::shared_ptr<FlowField>, Error> FlowField::makeCurlNoise(glm::ivec2 const& cells, float featureSize, std::uint32_t seed)
+{
+    if (featureSize <= 0.0f) return std::make_pair(nullptr, makeError("invalid flow field feature size", featureSize));
+    auto [pField, err] = make(cells);
+    if (err != nil) return std::make_pair(nullptr, err);
+
+    float const epsilon{1e-3f};
+    for (int y = 0; y < cells.y; y++)
+    {
+        for (int x = 0; x < cells.x; x++)
+        {
+            glm::vec2 p = (glm::vec2{static_cast<float>(x), static_cast<float>(y)} + 0.5f) / glm::vec2{cells} / featureSize;
+            float dPsiDx = fractalNoise(p + glm::vec2{epsilon, 0.0f}, seed) - fractalNoise(p - glm::vec2{epsilon, 0.0f}, seed);
+            float dPsiDy = fractalNoise(p + glm::vec2{0.0f, epsilon}, seed) - fractalNoise(p - glm::vec2{0.0f, epsilon}, seed);
+            glm::vec2 curl{dPsiDy, -dPsiDx};
+            float length = std::sqrt(curl.x * curl.x + curl.y * curl.y);
+            pField->at(x, y) = length > 0.0f ? curl / length : glm::vec2{1.0f, 0.0f};
+        }
+    }
+    return std::make_pair(pField, nil);
+}
+
+std::pair<std::shared_ptr<FlowField>, Error> FlowField::load(std::string const& pgmPath)
+{
+    auto [image, err] = readPgm(pgmPath);
+    if (err != nil) return std::make_pair(nullptr, makeError("could not load flow field:", err.value()));
+    std::shared_ptr<FlowField> pField;
+    std::tie(pField, err) = make(image.size);
+    if (err != nil) return std::make_pair(nullptr, err);
+    for (int y = 0; y < image.size.y; y++)
+    {
+        for (int x = 0; x < image.size.x; x++)
+        {
+            // image rows go top down, field rows bottom up
+            pField->set(glm::ivec2{x, y}, image.at(x, image.size.y - 1 - y) * kTwoPi);
+        }
+    }
+    return std::make_pair(pField, nil);
+}
+
+void FlowField::sample(glm::vec2 const* positions, std::size_t count, glm::vec2 const& lower, glm::vec2 const& upper, glm::vec2* directions) const
+{
+    glm::vec2 const toCells = glm::vec2{m_cells} / (upper - lower);
+    glm::vec2 const maxCell = glm::vec2{m_cells - 1};
+    for (std::size_t i = 0; i < count; i++)
+    {
+        // cell centers sit at half integers
+        glm::vec2 g = (positions[i] - lower) * toCells - 0.5f;
+        g.x = std::clamp(g.x, 0.0f, maxCell.x);
+        g.y = std::clamp(g.y, 0.0f, maxCell.y);
+        int x0 = static_cast<int>(g.x);
+        int y0 = static_cast<int>(g.y);
+        int x1 = std::min(x0 + 1, m_cells.x - 1);
+        int y1 = std::min(y0 + 1, m_cells.y - 1);
+        glm::vec2 t = g - glm::vec2{static_cast<float>(x0), static_cast<float>(y0)};
+        glm::vec2 bottom = glm::mix(at(x0, y0), at(x1, y0), t.x);
+        glm::vec2 top = glm::mix(at(x0, y1), at(x1, y1), t.x);
+        directions[i] = glm::mix(bottom, top, t.y);
+    }
+}
+
+void FlowField::steer(glm::vec2 const& center, float radius, glm::vec2 const& direction, float strength)
+{
+    float length = std::sqrt(direction.x * direction.x + direction.y * direction.y);
+    if (radius <= 0.0f || length <= 0.0f) return;
+    glm::vec2 target = direction / length;
+    strength = std::clamp(strength, 0.0f, 1.0f);
+
+    glm::vec2 const cellSize = glm::vec2{1.0f, 1.0f} / glm::vec2{m_cells};
+    int x0 = std::max(0, static_cast<int>(std::floor((center.x - radius) / cellSize.x)));
+    int x1 = std::min(m_cells.x - 1, static_cast<int>(std::ceil((center.x + radius) / cellSize.x)));
+    int y0 = std::max(0, static_cast<int>(std::floor((center.y - radius) / cellSize.y)));
+    int y1 = std::min(m_cells.y - 1, static_cast<int>(std::ceil((center.y + radius) / cellSize.y)));
+    for (int y = y0; y <= y1; y++)
+    {
+        for (int x = x0; x <= x1; x++)
+        {
+            glm::vec2 offset = (glm::vec2{static_cast<float>(x), static_cast<float>(y)} + 0.5f) * cellSize - center;
+            float distance = std::sqrt(offset.x * offset.x + offset.y * offset.y);
+            if (distance >= radius) continue;
+            // mixing the vectors alone would shorten a unit cell turned part way, and a shorter cell
+            // steers the traces less; the length goes from the cell's to 1 instead, so that empty
+            // cells still fade in
+            glm::vec2& cell = at(x, y);
+            float weight = strength * (1.0f - distance / radius);
+            float cellLength = std::sqrt(cell.x * cell.x + cell.y * cell.y);
+            glm::vec2 mixed = glm::mix(cell, target, weight);
+            float mixedLength = std::sqrt(mixed.x * mixed.x + mixed.y * mixed.y);
+            glm::vec2 mixedDirection = mixedLength > 0.0f ? mixed / mixedLength : target;
+            cell = mixedDirection * glm::mix(cellLength, 1.0f, weight);
+        }
+    }
+}
+
+void FlowField::set(glm::ivec2 const& cell, float angle)
+{
+    if (cell.x < 0 || cell.y < 0 || cell.x >= m_cells.x || cell.y >= m_cells.y) return;
+    at(cell.x, cell.y) = glm::vec2{std::cos(angle), std::sin(angle)};
+}
+
+glm::ivec2 FlowField::cells() const
+{
+    return m_cells;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Error.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+// Grid of directions spread over the window that traces steer along, see Scenario::Options::pFlowField.
+// Cells hold unit vectors rather than angles so that interpolating between cells pointing across
+// the +-pi seam does not turn the traces around. Field coordinates run from (0, 0) at the bottom left
+// to (1, 1) at the top right of the window. Rows are padded to cache lines and the grid is
+// cache-line aligned.
+// Sampling may run on several threads at once, but not at the same time as the modifying methods.
+struct FlowField
+{
+    static std::pair<std::shared_ptr<FlowField>, Error> make(glm::ivec2 const& cells);
+    // Divergence-free field of swirls about featureSize (in field units) across, from the curl of
+    // fractal gradient noise.
+    static std::pair<std::shared_ptr<FlowField>, Error> makeCurlNoise(glm::ivec2 const& cells, float featureSize, std::uint32_t seed);
+    // PGM image of angles, black and white being 0 (towards the right) and 2 pi counterclockwise.
+    static std::pair<std::shared_ptr<FlowField>, Error> load(std::string const& pgmPath);
+
+    // Bilinearly interpolated directions at count positions in monometric coordinates, with the window
+    // spanning lower to upper. Interpolated vectors are shorter where the cells disagree.
+    void sample(glm::vec2 const* positions, std::size_t count, glm::vec2 const& lower, glm::vec2 const& upper, glm::vec2* directions) const;
+
+    // Turns the cells within radius of center (both in field units) towards direction, by strength
+    // at the center fading to nothing at radius, e.g. following the cursor. Unit cells stay unit vectors.
+    void steer(glm::vec2 const& center, float radius, glm::vec2 const& direction, float strength);
+    void set(glm::ivec2 const& cell, float angle);
+
+    glm::ivec2 cells() const;
+
+private:
+    struct AlignedDelete
+    {
+        void operator()(glm::vec2* p) const;
+    };
+
+    glm::vec2& at(int x, int y) { return m_pDirections.get()[static_cast<std::size_t>(y) * m_rowStride + x]; }
+    glm::vec2 const& at(int x, int y) const { return m_pDirections.get()[static_cast<std::size_t>(y) * m_rowStride + x]; }
+
+    glm::ivec2 m_cells{};
+    std::size_t m_rowStride{0};
+    std::unique_ptr<glm::vec2[], AlignedDelete> m_pDirections;
+};
@@ -0,0 +1,52 @@
+#include "FrameArena.h"
+#include <algorithm>
+#include <cstdint>
+
+std::size_t const FrameArena::kDefaultFirstChunkSize{64 * 1024};
+
+FrameArena::FrameArena(std::size_t firstChunkSize)
+    : m_firstChunkSize{std::max<std::size_t>(firstChunkSize, 64)}
+{}
+
+void FrameArena::reset()
+{
+    m_currentChunk = 0;
+    m_offset = 0;
+}
+
+std::size_t FrameArena::capacity() const
+{
+    std::size_t capacity{0};
+    for (auto const& chunk : m_chunks) capacity += chunk.size;
+    return capacity;
+}
+
+void* FrameArena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    for (; m_currentChunk < m_chunks.size(); m_currentChunk++, m_offset = 0)
+    {
+        Chunk& chunk = m_chunks[m_currentChunk];
+        auto address = reinterpret_cast<std::uintptr_t>(chunk.pData.get()) + m_offset;
+        std::size_t padding = (alignment - address % alignment) % alignment;
+        if (m_offset + padding + bytes > chunk.size) continue;
+        m_offset += padding + bytes;
+        return chunk.pData.get() + m_offset - bytes;
+    }
+
+    // chunks double so that a growing peak needs few of them; operator new[] aligns to max_align_t
+    std::size_t size = m_chunks.empty() ? m_firstChunkSize : 2 * m_chunks.back().size;
+    size = std::max(size, bytes + alignment);
+    m_chunks.push_back(Chunk{std::make_unique<std::byte[]>(size), size});
+    m_currentChunk = m_chunks.size() - 1;
+    m_offset = 0;
+    return do_allocate(bytes, alignment);
+}
+
+void FrameArena::do_deallocate(void*, std::size_t, std::size_t)
+{
+}
+
+bool FrameArena::do_is_equal(std::pmr::memory_resource const& other) const noexcept
+{
+    return this == &other;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Bump allocator for memory that lives for one frame at most. reset() makes all of it available again
+// but keeps the chunks, so once the arena has seen a frame's peak it stops allocating altogether.
+// Deallocation does nothing. Not thread-safe.
+struct FrameArena : std::pmr::memory_resource
+{
+    explicit FrameArena(std::size_t firstChunkSize = kDefaultFirstChunkSize);
+
+    FrameArena(FrameArena const&) = delete;
+    FrameArena& operator=(FrameArena const&) = delete;
+
+    void reset();
+    std::size_t capacity() const;
+
+    static std::size_t const kDefaultFirstChunkSize;
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override;
+
+    struct Chunk
+    {
+        std::unique_ptr<std::byte[]> pData;
+        std::size_t size{0};
+    };
+
+    std::vector<Chunk> m_chunks;
+    std::size_t m_firstChunkSize{0};
+    std::size_t m_currentChunk{0};
+    std::size_t m_offset{0};
+};
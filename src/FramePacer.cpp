@@ -0,0 +1,171 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+
+float const FramePacer::kMinMarginFraction{0.1f};
+std::chrono::nanoseconds const FramePacer::kMinMargin{std::chrono::milliseconds{1}};
+float const FramePacer::kPeriodSmoothing{0.05f};
+float const FramePacer::kPhaseCorrection{0.25f};
+float const FramePacer::kBlockingSwapFraction{0.02f};
+std::size_t const FramePacer::kVsyncDecisionFrames{30};
+std::chrono::nanoseconds const FramePacer::kMinSpin{std::chrono::microseconds{200}};
+std::chrono::nanoseconds const FramePacer::kMaxSpin{std::chrono::milliseconds{4}};
+
+namespace {
+
+std::chrono::nanoseconds scaled(std::chrono::nanoseconds duration, double factor)
+{
+    return std::chrono::nanoseconds{static_cast<std::int64_t>(std::llround(duration.count() * factor))};
+}
+
+} // namespace
+
+FramePacer::FramePacer(std::chrono::nanoseconds nominalRefreshPeriod)
+    : m_nominalRefreshPeriod{nominalRefreshPeriod}
+    , m_refreshPeriod{nominalRefreshPeriod}
+    , m_spin{kMaxSpin}
+{}
+
+void FramePacer::beginFrame()
+{
+    auto now = Clock::now();
+    if (m_pacing && m_lastPresent)
+    {
+        std::chrono::nanoseconds const work = workEstimate();
+        std::chrono::nanoseconds const margin = std::max(kMinMargin, scaled(m_refreshPeriod, kMinMarginFraction));
+        Clock::time_point const start = nextPresent(now, work) - work - margin;
+        if (start > now) waitUntil(start);
+    }
+    m_frameStart = Clock::now();
+}
+
+void FramePacer::beforePresent()
+{
+    auto now = Clock::now();
+    m_lastWork = now - m_frameStart;
+    m_workTimes[m_workCount % m_workTimes.size()] = m_lastWork;
+    m_workCount++;
+    // swaps that do not wait for the display would show frames as fast as they come, and tear
+    if (m_pacing && !m_vsync && m_lastPresent) waitUntil(nextPresent(now, std::chrono::nanoseconds{0}));
+    m_swapStart = Clock::now();
+}
+
+void FramePacer::afterPresent()
+{
+    auto now = Clock::now();
+    std::chrono::nanoseconds const swapTime = now - m_swapStart;
+
+    // a swap that returns at once did not wait for the vertical blank
+    bool const blocked = swapTime > scaled(m_refreshPeriod, kBlockingSwapFraction);
+    m_vsyncEvidence = blocked != m_vsync ? m_vsyncEvidence + 1 : 0;
+    if (m_pacing && m_vsyncEvidence >= kVsyncDecisionFrames)
+    {
+        m_vsync = !m_vsync;
+        m_vsyncEvidence = 0;
+        if (!m_vsync) m_refreshPeriod = m_nominalRefreshPeriod;
+    }
+
+    if (m_lastSwapReturn)
+    {
+        double const interval = static_cast<double>((now - m_lastSwapReturn.value()).count());
+        m_intervalSum += interval;
+        m_intervalSquareSum += interval * interval;
+        m_intervalCount++;
+        m_statistics.maxInterval = std::max(m_statistics.maxInterval, std::chrono::nanoseconds{static_cast<std::int64_t>(interval)});
+
+        // swaps waiting for the display return a whole number of refreshes apart
+        double const period = static_cast<double>(m_refreshPeriod.count());
+        double const refreshes = std::round(interval / period);
+        if (m_vsync && refreshes >= 1.0 && std::abs(interval - refreshes * period) < 0.25 * period)
+        {
+            m_refreshPeriod = scaled(m_refreshPeriod, 1.0 + kPeriodSmoothing * (interval / refreshes / period - 1.0));
+        }
+    }
+    m_lastSwapReturn = now;
+
+    if (m_lastPresent)
+    {
+        auto refreshes = std::max<std::int64_t>(1, static_cast<std::int64_t>(std::llround(
+                static_cast<double>((now - m_lastPresent.value()).count()) / m_refreshPeriod.count())));
+        m_statistics.missedRefreshes += static_cast<std::size_t>(refreshes - 1);
+        Clock::time_point const predicted = m_lastPresent.value() + refreshes * m_refreshPeriod;
+        // the swap returns right after the vertical blank, but not exactly; follow its phase slowly
+        m_lastPresent = m_vsync ? predicted + scaled(now - predicted, kPhaseCorrection) : now;
+    }
+    else
+    {
+        m_lastPresent = now;
+    }
+
+    std::chrono::nanoseconds const latency = m_lastPresent.value() - m_frameStart;
+    m_statistics.frames++;
+    m_latencySum += static_cast<double>(latency.count());
+    m_statistics.maxLatency = std::max(m_statistics.maxLatency, latency);
+    m_workSum += static_cast<double>(m_lastWork.count());
+    m_statistics.maxWork = std::max(m_statistics.maxWork, m_lastWork);
+}
+
+std::optional<FramePacer::Clock::time_point> FramePacer::predictedPresent() const
+{
+    if (!m_lastPresent) return std::nullopt;
+    return nextPresent(Clock::now(), std::chrono::nanoseconds{0});
+}
+
+FramePacer::Statistics FramePacer::takeStatistics()
+{
+    Statistics statistics = m_statistics;
+    statistics.refreshPeriod = m_refreshPeriod;
+    statistics.vsync = m_vsync;
+    if (m_intervalCount > 0)
+    {
+        double const mean = m_intervalSum / m_intervalCount;
+        double const variance = std::max(0.0, m_intervalSquareSum / m_intervalCount - mean * mean);
+        statistics.meanInterval = std::chrono::nanoseconds{static_cast<std::int64_t>(mean)};
+        statistics.intervalJitter = std::chrono::nanoseconds{static_cast<std::int64_t>(std::sqrt(variance))};
+    }
+    if (statistics.frames > 0)
+    {
+        statistics.meanLatency = std::chrono::nanoseconds{static_cast<std::int64_t>(m_latencySum / statistics.frames)};
+        statistics.meanWork = std::chrono::nanoseconds{static_cast<std::int64_t>(m_workSum / statistics.frames)};
+    }
+
+    m_statistics = Statistics{};
+    m_intervalSum = 0.0;
+    m_intervalSquareSum = 0.0;
+    m_intervalCount = 0;
+    m_latencySum = 0.0;
+    m_workSum = 0.0;
+    return statistics;
+}
+
+void FramePacer::waitUntil(Clock::time_point deadline)
+{
+    auto now = Clock::now();
+    if (deadline - now > m_spin)
+    {
+        Clock::time_point const wake = deadline - m_spin;
+        std::this_thread::sleep_until(wake);
+        // spin for the worst recent overshoot and a half, forgetting old ones slowly
+        std::chrono::nanoseconds const overshoot = Clock::now() - wake;
+        m_spin = std::clamp(std::max(scaled(overshoot, 1.5), m_spin - m_spin / 64), kMinSpin, kMaxSpin);
+    }
+    while (Clock::now() < deadline) std::this_thread::yield();
+}
+
+FramePacer::Clock::time_point FramePacer::nextPresent(Clock::time_point now, std::chrono::nanoseconds lead) const
+{
+    Clock::time_point const lastPresent = m_lastPresent.value();
+    std::chrono::nanoseconds const ahead = now + lead - lastPresent;
+    std::int64_t refreshes = std::max<std::int64_t>(1, (ahead.count() + m_refreshPeriod.count() - 1) / m_refreshPeriod.count());
+    return lastPresent + refreshes * m_refreshPeriod;
+}
+
+std::chrono::nanoseconds FramePacer::workEstimate() const
+{
+    std::size_t const count = std::min(m_workCount, m_workTimes.size());
+    if (count == 0) return std::chrono::nanoseconds{0};
+    return *std::max_element(m_workTimes.begin(), m_workTimes.begin() + count);
+}
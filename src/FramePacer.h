@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+
+// Paces a window's frame loop to the display. It learns the refresh period and phase from the
+// times swaps return, predicts the next present and starts each frame as late as the recent worst
+// frame time plus a margin allow, so that input is fresh and the CPU idles instead of blocking in
+// the swap. When swaps turn out not to wait for the vertical blank (vsync off or ignored by the
+// driver) it holds every swap until the next predicted refresh itself.
+// Waits sleep until shortly before the deadline and spin the rest, the spin covering the sleep
+// overshoot measured so far.
+struct FramePacer
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Statistics
+    {
+        std::size_t frames{0};
+        // swaps that came one or more refresh periods later than predicted
+        std::size_t missedRefreshes{0};
+        std::chrono::nanoseconds refreshPeriod{};
+        bool vsync{true};
+        // between consecutive presents
+        std::chrono::nanoseconds meanInterval{};
+        std::chrono::nanoseconds intervalJitter{};
+        std::chrono::nanoseconds maxInterval{};
+        // from beginFrame(), where input is sampled, to the predicted present
+        std::chrono::nanoseconds meanLatency{};
+        std::chrono::nanoseconds maxLatency{};
+        // from beginFrame() to beforePresent()
+        std::chrono::nanoseconds meanWork{};
+        std::chrono::nanoseconds maxWork{};
+    };
+
+    explicit FramePacer(std::chrono::nanoseconds nominalRefreshPeriod);
+
+    // waits until the latest start that still makes the next present
+    void beginFrame();
+    // right before the swap, waits for the predicted present when swaps do not
+    void beforePresent();
+    // right after the swap returned
+    void afterPresent();
+
+    std::optional<Clock::time_point> predictedPresent() const;
+    std::chrono::nanoseconds refreshPeriod() const { return m_refreshPeriod; }
+    bool vsync() const { return m_vsync; }
+    // statistics of the frames since the last call
+    Statistics takeStatistics();
+
+    // without pacing the pacer never waits and only measures, e.g. for windows presenting with swap interval 0
+    void setPacing(bool pacing) { m_pacing = pacing; }
+
+    // sleeps and then spins until deadline
+    void waitUntil(Clock::time_point deadline);
+
+    static float const kMinMarginFraction;
+    static std::chrono::nanoseconds const kMinMargin;
+    static float const kPeriodSmoothing;
+    static float const kPhaseCorrection;
+    static float const kBlockingSwapFraction;
+    static std::size_t const kVsyncDecisionFrames;
+    static std::chrono::nanoseconds const kMinSpin;
+    static std::chrono::nanoseconds const kMaxSpin;
+
+private:
+    // the first present at least lead after now
+    Clock::time_point nextPresent(Clock::time_point now, std::chrono::nanoseconds lead) const;
+    std::chrono::nanoseconds workEstimate() const;
+
+    bool m_pacing{true};
+    std::chrono::nanoseconds m_nominalRefreshPeriod{};
+    std::chrono::nanoseconds m_refreshPeriod{};
+    bool m_vsync{true};
+    // swaps in a row contradicting m_vsync, blocking or not
+    std::size_t m_vsyncEvidence{0};
+    // phase of the refresh, a time a present happened
+    std::optional<Clock::time_point> m_lastPresent;
+    std::optional<Clock::time_point> m_lastSwapReturn;
+    Clock::time_point m_frameStart{};
+    Clock::time_point m_swapStart{};
+    std::chrono::nanoseconds m_spin{};
+
+    // ring of the latest frame times, m_workCount of them written so far
+    std::array<std::chrono::nanoseconds, 32> m_workTimes{};
+    std::size_t m_workCount{0};
+
+    Statistics m_statistics;
+    std::chrono::nanoseconds m_lastWork{};
+    double m_intervalSum{0.0};
+    double m_intervalSquareSum{0.0};
+    std::size_t m_intervalCount{0};
+    double m_latencySum{0.0};
+    double m_workSum{0.0};
+};
@@ -0,0 +1,205 @@
+#include "FrameReadback.h"
+#include "FrameSink.h"
+
+std::size_t const FrameReadback::kDefaultDepth{3};
+
+namespace {
+
+GLuint64 const kFenceTimeoutNs{1'000'000'000};
+
+} // namespace
+
+std::pair<std::shared_ptr<FrameReadback>, Error> FrameReadback::make(glm::ivec2 const& size, std::shared_ptr<FrameSink> pSink, std::size_t depth)
+{
+    if (!pSink || size.x <= 0 || size.y <= 0 || depth == 0)
+    {
+        return std::make_pair(nullptr, makeError("invalid FrameReadback parameters"));
+    }
+    std::shared_ptr<FrameReadback> pReadback{new (std::nothrow) FrameReadback()};
+    if (!pReadback) return std::make_pair(nullptr, makeError("could not instantiate FrameReadback"));
+
+    pReadback->m_size = size;
+    pReadback->m_frameBytes = static_cast<std::size_t>(size.x) * size.y * 4;
+    pReadback->m_pSink = pSink;
+    pReadback->m_slots.resize(depth);
+
+    GLbitfield const flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    for (auto& slot : pReadback->m_slots)
+    {
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glBufferStorage(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(pReadback->m_frameBytes), nullptr, flags | GL_CLIENT_STORAGE_BIT);
+        slot.pPixels = static_cast<std::uint8_t const*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(pReadback->m_frameBytes), flags));
+        if (!slot.pPixels)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            return std::make_pair(nullptr, makeError("could not map readback buffer of", pReadback->m_frameBytes, "bytes"));
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    pReadback->m_encoder = std::thread{&FrameReadback::encoderLoop, pReadback.get()};
+    return std::make_pair(pReadback, nil);
+}
+
+FrameReadback::~FrameReadback()
+{
+    if (m_encoder.joinable())
+    {
+        if (!m_finished) finish();
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_stopping = true;
+        }
+        m_slotQueued.notify_all();
+        m_encoder.join();
+    }
+
+    for (auto& slot : m_slots)
+    {
+        if (slot.fence) glDeleteSync(slot.fence);
+        if (slot.buffer == 0u) continue;
+        if (slot.pPixels)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glDeleteBuffers(1, &slot.buffer);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+Error FrameReadback::capture(GLuint framebuffer)
+{
+    if (m_finished) return makeError("cannot capture after finish");
+    auto err = encoderError();
+    if (err != nil) return err;
+
+    // when the ring is full of reads still in flight, the oldest one is the slot we need
+    bool const slotReading = !m_readingSlots.empty() && m_readingSlots.front() == m_nextSlot;
+    err = collectReads(slotReading);
+    if (err != nil) return err;
+
+    Slot& slot = m_slots[m_nextSlot];
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_slotFreed.wait(lock, [this, &slot]() { return slot.state == SlotState::Free || m_encoderError != nil; });
+        if (m_encoderError != nil) return m_encoderError;
+    }
+
+    // puts back only what the read changes, a GlStateGuard would query all of its state every frame
+    GLint readFramebuffer{0};
+    GLint pixelPackBuffer{0};
+    GLint packAlignment{4};
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+    glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &pixelPackBuffer);
+    glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, m_size.x, m_size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, static_cast<GLuint>(pixelPackBuffer));
+    glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<GLuint>(readFramebuffer));
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (!slot.fence) return makeError("could not create readback fence");
+    slot.frameIndex = m_capturedFrames++;
+    slot.captureTime = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        slot.state = SlotState::Reading;
+    }
+    m_readingSlots.push_back(m_nextSlot);
+    m_nextSlot = (m_nextSlot + 1) % m_slots.size();
+    return nil;
+}
+
+Error FrameReadback::collectReads(bool waitForOldest)
+{
+    bool wait = waitForOldest;
+    while (!m_readingSlots.empty())
+    {
+        Slot& slot = m_slots[m_readingSlots.front()];
+        GLenum result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? kFenceTimeoutNs : 0);
+        if (result == GL_TIMEOUT_EXPIRED)
+        {
+            if (wait) continue;
+            break;
+        }
+        if (result == GL_WAIT_FAILED) return makeError("waiting for a readback fence failed");
+        wait = false;
+
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            slot.state = SlotState::Encoding;
+            m_encodeQueue.push_back(m_readingSlots.front());
+        }
+        m_slotQueued.notify_one();
+        m_readingSlots.pop_front();
+    }
+    return nil;
+}
+
+Error FrameReadback::finish()
+{
+    if (m_finished) return nil;
+    m_finished = true;
+    while (!m_readingSlots.empty())
+    {
+        auto err = collectReads(true);
+        if (err != nil) return err;
+    }
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_slotFreed.wait(lock, [this]()
+        {
+            if (m_encoderError != nil) return true;
+            for (auto const& slot : m_slots) if (slot.state != SlotState::Free) return false;
+            return true;
+        });
+        if (m_encoderError != nil) return m_encoderError;
+    }
+    return m_pSink->finish();
+}
+
+std::size_t FrameReadback::capturedFrames() const
+{
+    return m_capturedFrames;
+}
+
+glm::ivec2 FrameReadback::size() const
+{
+    return m_size;
+}
+
+Error FrameReadback::encoderError()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_encoderError;
+}
+
+void FrameReadback::encoderLoop()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    while (true)
+    {
+        m_slotQueued.wait(lock, [this]() { return m_stopping || !m_encodeQueue.empty(); });
+        if (m_encodeQueue.empty()) return;
+        Slot& slot = m_slots[m_encodeQueue.front()];
+        m_encodeQueue.pop_front();
+
+        // after a failed write the remaining frames are only released
+        bool failed = m_encoderError != nil;
+        lock.unlock();
+        auto err = failed ? nil : m_pSink->write(slot.pPixels, m_size, slot.frameIndex, slot.captureTime);
+        lock.lock();
+
+        if (err != nil && m_encoderError == nil) m_encoderError = err;
+        slot.state = SlotState::Free;
+        m_slotFreed.notify_all();
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Error.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct FrameSink;
+
+// Reads finished frames back through a ring of persistently mapped pixel pack buffers.
+// capture() only queues glReadPixels and a fence; once the fence has signalled the mapped pixels go
+// straight to the FrameSink on an encoder thread, so neither the read nor the encoding stalls the
+// frame unless the whole ring is still in flight.
+// All methods except the encoder thread's work must be called on the thread owning the GL context.
+struct FrameReadback
+{
+    static std::pair<std::shared_ptr<FrameReadback>, Error> make(glm::ivec2 const& size, std::shared_ptr<FrameSink> pSink, std::size_t depth = kDefaultDepth);
+    ~FrameReadback();
+
+    // Queues a read of the first color attachment of framebuffer, which must be size large.
+    Error capture(GLuint framebuffer);
+    // Waits for every captured frame to be written and finishes the sink.
+    Error finish();
+
+    std::size_t capturedFrames() const;
+    glm::ivec2 size() const;
+
+    static std::size_t const kDefaultDepth;
+
+private:
+    enum class SlotState { Free, Reading, Encoding };
+    struct Slot
+    {
+        GLuint buffer{0u};
+        std::uint8_t const* pPixels{nullptr};
+        GLsync fence{nullptr};
+        SlotState state{SlotState::Free};
+        std::size_t frameIndex{0};
+        std::chrono::steady_clock::time_point captureTime;
+    };
+
+    // hands the reads that completed, in capture order, to the encoder; waits for the oldest if asked
+    Error collectReads(bool waitForOldest);
+    void encoderLoop();
+    Error encoderError();
+
+    glm::ivec2 m_size{};
+    std::size_t m_frameBytes{0};
+    std::shared_ptr<FrameSink> m_pSink;
+    std::vector<Slot> m_slots;
+    std::deque<std::size_t> m_readingSlots;
+    std::size_t m_nextSlot{0};
+    std::size_t m_capturedFrames{0};
+    bool m_finished{false};
+
+    std::mutex m_mutex;
+    std::condition_variable m_slotQueued;
+    std::condition_variable m_slotFreed;
+    std::deque<std::size_t> m_encodeQueue;
+    bool m_stopping{false};
+    Error m_encoderError;
+    std::thread m_encoder;
+};
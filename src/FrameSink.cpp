@@ -0,0 +1,185 @@
+#include "FrameSink.h"
+#include "PngEncoder.h"
+#include "ThreadPool.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace {
+
+// accepts exactly one %d conversion with optional flags and width, and %% escapes
+bool isFrameIndexPattern(std::string const& pattern)
+{
+    int conversions{0};
+    for (std::size_t i = 0; i < pattern.size(); i++)
+    {
+        if (pattern[i] != '%') continue;
+        if (++i < pattern.size() && pattern[i] == '%') continue;
+        while (i < pattern.size() && (pattern[i] == '0' || pattern[i] == '-' || std::isdigit(static_cast<unsigned char>(pattern[i])))) i++;
+        if (i >= pattern.size() || pattern[i] != 'd') return false;
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+Error setBinaryMode(std::FILE* pFile)
+{
+#ifdef _WIN32
+    if (_setmode(_fileno(pFile), _O_BINARY) == -1) return makeError("could not switch stream to binary mode");
+#else
+    (void)pFile;
+#endif
+    return nil;
+}
+
+Error writeAll(std::FILE* pFile, void const* data, std::size_t size)
+{
+    if (std::fwrite(data, 1, size, pFile) != size)
+    {
+        return makeError("could not write frame:", std::strerror(errno));
+    }
+    return nil;
+}
+
+} // namespace
+
+std::pair<std::shared_ptr<PngSequenceSink>, Error> PngSequenceSink::make(std::string const& pathPattern)
+{
+    if (!isFrameIndexPattern(pathPattern))
+    {
+        return std::make_pair(nullptr, makeError("png path pattern needs exactly one %d for the frame index:", pathPattern));
+    }
+    std::shared_ptr<PngSequenceSink> pSink{new (std::nothrow) PngSequenceSink()};
+    if (!pSink) return std::make_pair(nullptr, makeError("could not instantiate PngSequenceSink"));
+    pSink->m_pathPattern = pathPattern;
+    return std::make_pair(pSink, nil);
+}
+
+Error PngSequenceSink::write(std::uint8_t const* pixels, glm::ivec2 const& size, std::size_t frameIndex, std::chrono::steady_clock::time_point)
+{
+    auto png = encodePng(pixels, size);
+
+    std::vector<char> path(m_pathPattern.size() + 32);
+    std::snprintf(path.data(), path.size(), m_pathPattern.c_str(), static_cast<int>(frameIndex));
+    std::ofstream file{path.data(), std::ios::binary | std::ios::trunc};
+    file.write(reinterpret_cast<char const*>(png.data()), static_cast<std::streamsize>(png.size()));
+    if (!file)
+    {
+        return makeError("could not write", path.data());
+    }
+    return nil;
+}
+
+std::pair<std::shared_ptr<Y4mSink>, Error> Y4mSink::make(std::FILE* pFile, int framesPerSecond)
+{
+    if (!pFile || framesPerSecond <= 0) return std::make_pair(nullptr, makeError("invalid y4m stream parameters"));
+    auto err = setBinaryMode(pFile);
+    if (err != nil) return std::make_pair(nullptr, err);
+    std::shared_ptr<Y4mSink> pSink{new (std::nothrow) Y4mSink()};
+    if (!pSink) return std::make_pair(nullptr, makeError("could not instantiate Y4mSink"));
+    pSink->m_pFile = pFile;
+    pSink->m_framesPerSecond = framesPerSecond;
+    return std::make_pair(pSink, nil);
+}
+
+Error Y4mSink::write(std::uint8_t const* pixels, glm::ivec2 const& size, std::size_t, std::chrono::steady_clock::time_point)
+{
+    if (!m_headerWritten)
+    {
+        if (std::fprintf(m_pFile, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444 XCOLORRANGE=LIMITED\n", size.x, size.y, m_framesPerSecond) < 0)
+        {
+            return makeError("could not write y4m header");
+        }
+        m_headerWritten = true;
+    }
+
+    std::size_t const planeSize = static_cast<std::size_t>(size.x) * size.y;
+    m_planes.resize(planeSize * 3);
+    std::uint8_t* pY = m_planes.data();
+    std::uint8_t* pU = pY + planeSize;
+    std::uint8_t* pV = pU + planeSize;
+    // BT.709 coefficients scaled to the 16..235 / 16..240 ranges, in 16.16 fixed point
+    ThreadPool::instance().parallelFor(static_cast<std::size_t>(size.y), 64, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t y = begin; y < end; y++)
+        {
+            std::uint8_t const* source = pixels + (size.y - 1 - y) * static_cast<std::size_t>(size.x) * 4;
+            std::size_t const row = y * size.x;
+            for (int x = 0; x < size.x; x++)
+            {
+                int r = source[x * 4 + 0];
+                int g = source[x * 4 + 1];
+                int b = source[x * 4 + 2];
+                pY[row + x] = static_cast<std::uint8_t>((( 11966 * r + 40254 * g +  4064 * b + 32768) >> 16) + 16);
+                pU[row + x] = static_cast<std::uint8_t>(((- 6596 * r - 22189 * g + 28785 * b + 32768) >> 16) + 128);
+                pV[row + x] = static_cast<std::uint8_t>((( 28785 * r - 26145 * g -  2640 * b + 32768) >> 16) + 128);
+            }
+        }
+    });
+
+    static char const kFrameHeader[] = "FRAME\n";
+    auto err = writeAll(m_pFile, kFrameHeader, sizeof(kFrameHeader) - 1);
+    if (err != nil) return err;
+    return writeAll(m_pFile, m_planes.data(), m_planes.size());
+}
+
+Error Y4mSink::finish()
+{
+    if (std::fflush(m_pFile) != 0) return makeError("could not flush y4m stream:", std::strerror(errno));
+    return nil;
+}
+
+std::pair<std::shared_ptr<RawRgbaSink>, Error> RawRgbaSink::make(std::FILE* pFile)
+{
+    if (!pFile) return std::make_pair(nullptr, makeError("invalid rgba stream"));
+    auto err = setBinaryMode(pFile);
+    if (err != nil) return std::make_pair(nullptr, err);
+    std::shared_ptr<RawRgbaSink> pSink{new (std::nothrow) RawRgbaSink()};
+    if (!pSink) return std::make_pair(nullptr, makeError("could not instantiate RawRgbaSink"));
+    pSink->m_pFile = pFile;
+    return std::make_pair(pSink, nil);
+}
+
+Error RawRgbaSink::write(std::uint8_t const* pixels, glm::ivec2 const& size, std::size_t, std::chrono::steady_clock::time_point)
+{
+    std::size_t const rowBytes = static_cast<std::size_t>(size.x) * 4;
+    for (int y = size.y - 1; y >= 0; y--)
+    {
+        auto err = writeAll(m_pFile, pixels + y * rowBytes, rowBytes);
+        if (err != nil) return err;
+    }
+    return nil;
+}
+
+Error RawRgbaSink::finish()
+{
+    if (std::fflush(m_pFile) != 0) return makeError("could not flush rgba stream:", std::strerror(errno));
+    return nil;
+}
+
+std::pair<std::shared_ptr<FrameSink>, Error> makeFrameSink(std::string const& spec, int framesPerSecond)
+{
+    std::string const pngPrefix{"png:"};
+    if (spec.compare(0, pngPrefix.size(), pngPrefix) == 0)
+    {
+        auto [pSink, err] = PngSequenceSink::make(spec.substr(pngPrefix.size()));
+        return std::make_pair(std::shared_ptr<FrameSink>{pSink}, err);
+    }
+    if (spec == "y4m")
+    {
+        auto [pSink, err] = Y4mSink::make(stdout, framesPerSecond);
+        return std::make_pair(std::shared_ptr<FrameSink>{pSink}, err);
+    }
+    if (spec == "rgba")
+    {
+        auto [pSink, err] = RawRgbaSink::make(stdout);
+        return std::make_pair(std::shared_ptr<FrameSink>{pSink}, err);
+    }
+    return std::make_pair(nullptr, makeError("unknown export format:", spec, "(expected png:<pattern>, y4m or rgba)"));
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Error.h"
+#include <glm/glm.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Destination of exported frames. write() is called in frame order from the FrameReadback encoder
+// thread with tightly packed RGBA rows, bottom row first as glReadPixels returns them, and the time
+// the frame was captured.
+struct FrameSink
+{
+    virtual ~FrameSink() = default;
+    virtual Error write(std::uint8_t const* pixels, glm::ivec2 const& size, std::size_t frameIndex, std::chrono::steady_clock::time_point captureTime) = 0;
+    virtual Error finish() { return nil; }
+};
+
+// One PNG file per frame, pathPattern is a printf pattern taking the frame index, e.g. "frame%05d.png".
+struct PngSequenceSink : FrameSink
+{
+    static std::pair<std::shared_ptr<PngSequenceSink>, Error> make(std::string const& pathPattern);
+    Error write(std::uint8_t const* pixels, glm::ivec2 const& size, std::size_t frameIndex, std::chrono::steady_clock::time_point captureTime) override;
+
+    std::string m_pathPattern;
+};
+
+// YUV4MPEG2 stream, 4:4:4 BT.709 limited range so thin colored lines keep their chroma.
+struct Y4mSink : FrameSink
+{
+    static std::pair<std::shared_ptr<Y4mSink>, Error> make(std::FILE* pFile, int framesPerSecond);
+    Error write(std::uint8_t const* pixels, glm::ivec2 const& size, std::size_t frameIndex, std::chrono::steady_clock::time_point captureTime) override;
+    Error finish() override;
+
+    std::FILE* m_pFile{nullptr};
+    int m_framesPerSecond{60};
+    bool m_headerWritten{false};
+    std::vector<std::uint8_t> m_planes;
+};
+
+// Headerless RGBA frames, top row first.
+struct RawRgbaSink : FrameSink
+{
+    static std::pair<std::shared_ptr<RawRgbaSink>, Error> make(std::FILE* pFile);
+    Error write(std::uint8_t const* pixels, glm::ivec2 const& size, std::size_t frameIndex, std::chrono::steady_clock::time_point captureTime) override;
+    Error finish() override;
+
+    std::FILE* m_pFile{nullptr};
+};
+
+// "png:<pathPattern>", "y4m" or "rgba", the streams going to stdout.
+std::pair<std::shared_ptr<FrameSink>, Error> makeFrameSink(std::string const& spec, int framesPerSecond);
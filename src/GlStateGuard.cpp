@@ -0,0 +1,57 @@
+#include "GlStateGuard.h"
+
+GlStateGuard::GlStateGuard()
+{
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport.data());
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &arrayBuffer);
+    glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &pixelPackBuffer);
+    glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &pixelUnpackBuffer);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vertexArray);
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture0);
+    glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor.data());
+    glGetFloatv(GL_LINE_WIDTH, &lineWidth);
+    glGetFloatv(GL_POINT_SIZE, &pointSize);
+    glGetIntegerv(GL_BLEND_SRC_RGB, &blendFunction[0]);
+    glGetIntegerv(GL_BLEND_DST_RGB, &blendFunction[1]);
+    glGetIntegerv(GL_BLEND_SRC_ALPHA, &blendFunction[2]);
+    glGetIntegerv(GL_BLEND_DST_ALPHA, &blendFunction[3]);
+    for (std::size_t i = 0; i < kCapabilities.size(); i++)
+    {
+        capabilities[i] = glIsEnabled(kCapabilities[i]);
+        if (capabilities[i]) glDisable(kCapabilities[i]);
+    }
+    if (vertexArray != 0) glBindVertexArray(0);
+}
+
+GlStateGuard::~GlStateGuard()
+{
+    for (std::size_t i = 0; i < kCapabilities.size(); i++)
+    {
+        if (capabilities[i]) glEnable(kCapabilities[i]);
+    }
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    glBlendFuncSeparate(static_cast<GLenum>(blendFunction[0]), static_cast<GLenum>(blendFunction[1]),
+                        static_cast<GLenum>(blendFunction[2]), static_cast<GLenum>(blendFunction[3]));
+    glPointSize(pointSize);
+    glLineWidth(lineWidth);
+    glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(texture0));
+    glActiveTexture(static_cast<GLenum>(activeTexture));
+    glBindVertexArray(static_cast<GLuint>(vertexArray));
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, static_cast<GLuint>(pixelPackBuffer));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, static_cast<GLuint>(pixelUnpackBuffer));
+    glBindBuffer(GL_ARRAY_BUFFER, static_cast<GLuint>(arrayBuffer));
+    glUseProgram(static_cast<GLuint>(program));
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<GLuint>(readFramebuffer));
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<GLuint>(drawFramebuffer));
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <array>
+
+// Saves the GL state the renderers and pixel transfers touch, resets what would disturb them (depth,
+// stencil and scissor tests, blending, line smoothing, face culling, sRGB conversion, a bound vertex
+// array object) and restores all of it on destruction. Lets the library draw into a host's scene
+// without the host re-applying its state.
+struct GlStateGuard
+{
+    GlStateGuard();
+    ~GlStateGuard();
+
+    GlStateGuard(GlStateGuard const&) = delete;
+    GlStateGuard& operator=(GlStateGuard const&) = delete;
+
+private:
+    static constexpr std::array<GLenum, 7> kCapabilities{
+        GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_FRAMEBUFFER_SRGB, GL_LINE_SMOOTH, GL_SCISSOR_TEST, GL_STENCIL_TEST};
+
+    GLint drawFramebuffer{0};
+    GLint readFramebuffer{0};
+    std::array<GLint, 4> viewport{};
+    GLint program{0};
+    GLint arrayBuffer{0};
+    GLint pixelPackBuffer{0};
+    GLint pixelUnpackBuffer{0};
+    GLint vertexArray{0};
+    GLint activeTexture{GL_TEXTURE0};
+    GLint texture0{0};
+    GLint packAlignment{4};
+    GLint unpackAlignment{4};
+    std::array<GLfloat, 4> clearColor{};
+    GLfloat lineWidth{1.0f};
+    GLfloat pointSize{1.0f};
+    // source and destination factors for rgb, then for alpha
+    std::array<GLint, 4> blendFunction{GL_ONE, GL_ZERO, GL_ONE, GL_ZERO};
+    std::array<GLboolean, kCapabilities.size()> capabilities{};
+};
@@ -0,0 +1,74 @@
+#include "GpuTimer.h"
+#include <cstdint>
+
+std::pair<std::shared_ptr<GpuTimer>, Error> GpuTimer::make()
+{
+    std::shared_ptr<GpuTimer> pTimer{new (std::nothrow) GpuTimer()};
+    if (!pTimer) return std::make_pair(nullptr, makeError("could not instantiate GpuTimer"));
+    for (auto& frame : pTimer->m_frames)
+    {
+        glGenQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+        if (frame.queries[0] == 0u) return std::make_pair(nullptr, makeError("could not create timestamp queries"));
+    }
+    return std::make_pair(pTimer, nil);
+}
+
+GpuTimer::~GpuTimer()
+{
+    for (auto& frame : m_frames)
+    {
+        if (frame.queries[0] != 0u) glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+    }
+}
+
+void GpuTimer::beginInterval()
+{
+    Frame& frame = m_frames[m_writeIndex];
+    if (frame.intervalCount >= kMaxIntervals) return;
+    glQueryCounter(frame.queries[2 * frame.intervalCount], GL_TIMESTAMP);
+}
+
+void GpuTimer::endInterval()
+{
+    Frame& frame = m_frames[m_writeIndex];
+    if (frame.intervalCount >= kMaxIntervals) return;
+    glQueryCounter(frame.queries[2 * frame.intervalCount + 1], GL_TIMESTAMP);
+    frame.intervalCount++;
+}
+
+void GpuTimer::endFrame()
+{
+    if (m_frames[m_writeIndex].intervalCount == 0) return;
+    m_writeIndex = (m_writeIndex + 1) % kFramesInFlight;
+    // a GPU this far behind gets its oldest unread frame overwritten, that measurement is lost but nothing waits
+    if (m_framesInFlight + 1 == kFramesInFlight) m_readIndex = (m_readIndex + 1) % kFramesInFlight;
+    else m_framesInFlight++;
+    m_frames[m_writeIndex].intervalCount = 0;
+}
+
+std::optional<std::chrono::nanoseconds> GpuTimer::poll()
+{
+    std::optional<std::chrono::nanoseconds> result;
+    while (m_framesInFlight > 0)
+    {
+        Frame& frame = m_frames[m_readIndex];
+        // queries complete in order, the last one being available implies the others are
+        GLuint available{GL_FALSE};
+        glGetQueryObjectuiv(frame.queries[2 * frame.intervalCount - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+
+        GLuint64 total{0};
+        for (std::size_t i = 0; i < frame.intervalCount; i++)
+        {
+            GLuint64 begin{0};
+            GLuint64 end{0};
+            glGetQueryObjectui64v(frame.queries[2 * i], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(frame.queries[2 * i + 1], GL_QUERY_RESULT, &end);
+            if (end > begin) total += end - begin;
+        }
+        result = std::chrono::nanoseconds{static_cast<std::int64_t>(total)};
+        m_readIndex = (m_readIndex + 1) % kFramesInFlight;
+        m_framesInFlight--;
+    }
+    return result;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Error.h"
+#include <GL/glew.h>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <utility>
+
+// GPU time spent on a frame's work, measured with timestamp queries around up to kMaxIntervals
+// intervals per frame and read back a few frames later, so polling never waits for the GPU.
+// Needs the GL context the timer was made in.
+struct GpuTimer
+{
+    static std::pair<std::shared_ptr<GpuTimer>, Error> make();
+    ~GpuTimer();
+
+    void beginInterval();
+    void endInterval();
+    void endFrame();
+    // sum of the intervals of the newest frame whose queries completed since the last call
+    std::optional<std::chrono::nanoseconds> poll();
+
+    static constexpr std::size_t kFramesInFlight{4};
+    static constexpr std::size_t kMaxIntervals{4};
+
+private:
+    struct Frame
+    {
+        std::array<GLuint, 2 * kMaxIntervals> queries{};
+        std::size_t intervalCount{0};
+    };
+
+    std::array<Frame, kFramesInFlight> m_frames;
+    std::size_t m_writeIndex{0};
+    std::size_t m_readIndex{0};
+    std::size_t m_framesInFlight{0};
+};
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Generation-checked slot table handing out integer handles for shared objects.
+// A handle encodes the slot index in its low kIndexBits and the slot generation above them,
+// so a stale handle is rejected by comparing one atomic word, without hashing.
+// Lookups are lock-free; insertion and removal take a mutex only to manage the free list,
+// and removal waits for in-flight lookups of the same slot to finish before dropping the object.
+template<typename T>
+struct HandleTable
+{
+    using Handle = std::size_t;
+
+    static constexpr unsigned kIndexBits{20};
+    static constexpr std::size_t kPageSize{256};
+    static constexpr std::size_t kMaxSlots{std::size_t{1} << kIndexBits};
+    static constexpr std::size_t kMaxPages{kMaxSlots / kPageSize};
+
+private:
+    struct Slot
+    {
+        std::atomic<std::uint64_t> state{0};
+        std::shared_ptr<T> pValue;
+    };
+
+public:
+    struct Ref
+    {
+        Ref() = default;
+        Ref(Ref const&) = delete;
+        Ref& operator=(Ref const&) = delete;
+        Ref(Ref&& rhs) noexcept : pSlot{rhs.pSlot} { rhs.pSlot = nullptr; }
+        Ref& operator=(Ref&& rhs) noexcept
+        {
+            if (this != &rhs)
+            {
+                reset();
+                pSlot = rhs.pSlot;
+                rhs.pSlot = nullptr;
+            }
+            return *this;
+        }
+        ~Ref() { reset(); }
+
+        explicit operator bool() const { return pSlot != nullptr; }
+        T* operator->() const { return pSlot->pValue.get(); }
+        T& operator*() const { return *pSlot->pValue; }
+        T* get() const { return pSlot ? pSlot->pValue.get() : nullptr; }
+
+        void reset()
+        {
+            if (!pSlot) return;
+            pSlot->state.fetch_sub(1, std::memory_order_release);
+            pSlot = nullptr;
+        }
+
+    private:
+        friend struct HandleTable;
+        Slot* pSlot{nullptr};
+    };
+
+    HandleTable() = default;
+    HandleTable(HandleTable const&) = delete;
+    HandleTable& operator=(HandleTable const&) = delete;
+
+    ~HandleTable()
+    {
+        for (auto& page : pages) delete[] page.load(std::memory_order_relaxed);
+    }
+
+    // returns 0 when the table is full
+    Handle insert(std::shared_ptr<T> pValue)
+    {
+        if (!pValue) return 0;
+        std::uint32_t index;
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            if (!freeIndices.empty())
+            {
+                index = freeIndices.back();
+                freeIndices.pop_back();
+            }
+            else
+            {
+                if (slotCount == kMaxSlots) return 0;
+                index = static_cast<std::uint32_t>(slotCount++);
+                auto& page = pages[index / kPageSize];
+                if (!page.load(std::memory_order_relaxed)) page.store(new Slot[kPageSize], std::memory_order_release);
+            }
+        }
+        Slot& slot = *slotAt(index);
+        std::uint64_t generation = generationOf(slot.state.load(std::memory_order_relaxed));
+        if (generation == 0) generation = 1;
+        slot.pValue = std::move(pValue);
+        slot.state.store((generation << kGenerationShift) | kAlive, std::memory_order_release);
+        return makeHandle(index, generation);
+    }
+
+    // lock-free; the returned Ref keeps the object alive and blocks its removal until it is reset
+    Ref acquire(Handle handle) const
+    {
+        Ref ref;
+        std::uint64_t generation{};
+        Slot* pSlot = slotFor(handle, generation);
+        if (!pSlot) return ref;
+        std::uint64_t state = pSlot->state.load(std::memory_order_acquire);
+        do
+        {
+            if (generationOf(state) != generation || !(state & kAlive)) return ref;
+        } while (!pSlot->state.compare_exchange_weak(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed));
+        ref.pSlot = pSlot;
+        return ref;
+    }
+
+    // returns false for stale or unknown handles
+    bool remove(Handle handle)
+    {
+        std::uint64_t generation{};
+        Slot* pSlot = slotFor(handle, generation);
+        if (!pSlot) return false;
+        std::uint64_t state = pSlot->state.load(std::memory_order_acquire);
+        do
+        {
+            if (generationOf(state) != generation || !(state & kAlive)) return false;
+        } while (!pSlot->state.compare_exchange_weak(state, state & ~kAlive, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+        while ((pSlot->state.load(std::memory_order_acquire) & kRefMask) != 0) std::this_thread::yield();
+
+        std::shared_ptr<T> pValue = std::move(pSlot->pValue);
+        std::uint64_t nextGeneration = (generation + 1) & kGenerationMask;
+        pSlot->state.store(nextGeneration << kGenerationShift, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            freeIndices.push_back(static_cast<std::uint32_t>(handle & kIndexMask));
+        }
+        return true;
+    }
+
+private:
+    // state layout: generation (32 bits) | alive (1 bit) | in-flight lookups (31 bits)
+    static constexpr unsigned kGenerationShift{32};
+    static constexpr std::uint64_t kAlive{std::uint64_t{1} << 31};
+    static constexpr std::uint64_t kRefMask{kAlive - 1};
+    static constexpr std::uint64_t kIndexMask{kMaxSlots - 1};
+    static constexpr std::uint64_t kGenerationMask{(sizeof(Handle) * 8 - kIndexBits >= 32)
+                                                   ? std::uint64_t{0xffffffffu}
+                                                   : (std::uint64_t{1} << (sizeof(Handle) * 8 - kIndexBits)) - 1};
+
+    static std::uint64_t generationOf(std::uint64_t state) { return state >> kGenerationShift; }
+
+    static Handle makeHandle(std::uint32_t index, std::uint64_t generation)
+    {
+        return static_cast<Handle>((generation << kIndexBits) | index);
+    }
+
+    Slot* slotAt(std::size_t index) const
+    {
+        Slot* pPage = pages[index / kPageSize].load(std::memory_order_acquire);
+        if (!pPage) return nullptr;
+        return pPage + (index % kPageSize);
+    }
+
+    Slot* slotFor(Handle handle, std::uint64_t& generation) const
+    {
+        generation = static_cast<std::uint64_t>(handle) >> kIndexBits;
+        if (generation == 0) return nullptr;
+        return slotAt(handle & kIndexMask);
+    }
+
+    std::array<std::atomic<Slot*>, kMaxPages> pages{};
+    std::size_t slotCount{0};
+    std::vector<std::uint32_t> freeIndices;
+    std::mutex mutex;
+};
@@ -0,0 +1,41 @@
+#include "MaintenanceScheduler.h"
+
+#include <algorithm>
+#include <utility>
+
+float const MaintenanceScheduler::kSliceTimeDecay{0.9f};
+std::size_t const MaintenanceScheduler::kReservedTasks{8};
+
+MaintenanceScheduler::MaintenanceScheduler()
+{
+    m_tasks.reserve(kReservedTasks);
+}
+
+void MaintenanceScheduler::post(Task task)
+{
+    m_tasks.push_back(QueuedTask{std::move(task), std::chrono::nanoseconds{0}});
+}
+
+void MaintenanceScheduler::runUntil(Clock::time_point deadline)
+{
+    m_lastSliceCount = 0;
+    while (!m_tasks.empty())
+    {
+        QueuedTask& queued = m_tasks.front();
+        auto decayed = std::chrono::nanoseconds{static_cast<std::chrono::nanoseconds::rep>(queued.sliceTime.count() * kSliceTimeDecay)};
+        auto startTime = Clock::now();
+        if (startTime + queued.sliceTime >= deadline)
+        {
+            // a slice longer than any frame leaves would wait forever otherwise
+            queued.sliceTime = decayed;
+            break;
+        }
+
+        bool more = queued.task();
+        m_lastSliceCount++;
+
+        auto sliceTime = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - startTime);
+        queued.sliceTime = std::max(sliceTime, decayed);
+        if (!more) m_tasks.erase(m_tasks.begin());
+    }
+}
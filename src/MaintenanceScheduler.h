@@ -0,0 +1,43 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+// Runs a scenario's deferrable work in the time its frames leave over, so that bursts such as
+// refilling the population spread over several frames instead of spiking one. A task is an explicit
+// continuation: every call does one slice of the work, keeping its progress with whoever posted
+// it, and returns whether there is more. Slices do not start when the time left is below what the
+// task's recent slices took, and nothing runs once the frame is out of time.
+struct MaintenanceScheduler
+{
+    using Clock = std::chrono::steady_clock;
+    // one slice of work, true while some is left
+    using Task = std::function<bool()>;
+
+    MaintenanceScheduler();
+
+    // queues task behind the others
+    void post(Task task);
+    // runs slices of the queued tasks, the oldest first, until they are done or deadline is near
+    void runUntil(Clock::time_point deadline);
+
+    std::size_t pendingTasks() const { return m_tasks.size(); }
+    // slices run by the last runUntil()
+    std::size_t lastSliceCount() const { return m_lastSliceCount; }
+
+    static float const kSliceTimeDecay;
+    static std::size_t const kReservedTasks;
+
+private:
+    struct QueuedTask
+    {
+        Task task;
+        // the longest recent slice, decaying
+        std::chrono::nanoseconds sliceTime{0};
+    };
+
+    std::vector<QueuedTask> m_tasks;
+    std::size_t m_lastSliceCount{0};
+};
@@ -0,0 +1,233 @@
+#include "ObstacleMask.h"
+#include "RandomSource.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+int const ObstacleMask::kTileSize{8};
+int const ObstacleMask::kPyramidLevels{3};
+
+namespace {
+
+// tries of sampleAllowed() before giving up on a mask whose allowed pixels are few and far between
+int const kSampleAttempts{256};
+
+// Squared distance from each of the n samples of f to the nearest zero in f, into d, along one row or
+// column (Felzenszwalb and Huttenlocher). Non-zero samples of f must be kFar.
+double const kFar{1e20};
+
+void distanceTransform(std::vector<double>& f, std::size_t n, std::vector<double>& d, std::vector<int>& v, std::vector<double>& z)
+{
+    int k = 0;
+    v[0] = 0;
+    z[0] = -kFar;
+    z[1] = kFar;
+    for (int q = 1; q < static_cast<int>(n); q++)
+    {
+        double s = ((f[q] + double(q) * q) - (f[v[k]] + double(v[k]) * v[k])) / (2.0 * q - 2.0 * v[k]);
+        while (s <= z[k])
+        {
+            k--;
+            s = ((f[q] + double(q) * q) - (f[v[k]] + double(v[k]) * v[k])) / (2.0 * q - 2.0 * v[k]);
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = kFar;
+    }
+    k = 0;
+    for (int q = 0; q < static_cast<int>(n); q++)
+    {
+        while (z[k + 1] < q) k++;
+        d[q] = double(q - v[k]) * (q - v[k]) + f[v[k]];
+    }
+}
+
+// distance from every pixel to the nearest pixel where isFeature is set, kFar if there is none
+std::vector<float> distanceToFeatures(std::vector<bool> const& isFeature, glm::ivec2 const& size)
+{
+    std::size_t const longest = static_cast<std::size_t>(std::max(size.x, size.y));
+    std::vector<double> f(longest), d(longest), z(longest + 1);
+    std::vector<int> v(longest);
+    std::vector<double> squared(isFeature.size());
+    for (std::size_t i = 0; i < isFeature.size(); i++) squared[i] = isFeature[i] ? 0.0 : kFar;
+
+    for (int x = 0; x < size.x; x++)
+    {
+        for (int y = 0; y < size.y; y++) f[y] = squared[static_cast<std::size_t>(y) * size.x + x];
+        distanceTransform(f, size.y, d, v, z);
+        for (int y = 0; y < size.y; y++) squared[static_cast<std::size_t>(y) * size.x + x] = d[y];
+    }
+    for (int y = 0; y < size.y; y++)
+    {
+        std::size_t row = static_cast<std::size_t>(y) * size.x;
+        std::copy(squared.begin() + row, squared.begin() + row + size.x, f.begin());
+        distanceTransform(f, size.x, d, v, z);
+        std::copy(d.begin(), d.begin() + size.x, squared.begin() + row);
+    }
+
+    std::vector<float> distances(squared.size());
+    for (std::size_t i = 0; i < squared.size(); i++)
+    {
+        distances[i] = squared[i] >= kFar ? std::numeric_limits<float>::max() : static_cast<float>(std::sqrt(squared[i]));
+    }
+    return distances;
+}
+
+} // namespace
+
+std::pair<std::shared_ptr<ObstacleMask>, Error> ObstacleMask::load(std::string const& pgmPath, bool invert)
+{
+    auto [image, err] = readPgm(pgmPath);
+    if (err != nil) return std::make_pair(nullptr, makeError("could not load obstacle mask:", err.value()));
+    return make(image, invert);
+}
+
+std::pair<std::shared_ptr<ObstacleMask>, Error> ObstacleMask::make(GrayImage const& image, bool invert)
+{
+    if (image.size.x <= 0 || image.size.y <= 0 || image.values.size() != static_cast<std::size_t>(image.size.x) * image.size.y)
+    {
+        return std::make_pair(nullptr, makeError("invalid obstacle mask image"));
+    }
+    std::shared_ptr<ObstacleMask> pMask{new (std::nothrow) ObstacleMask()};
+    if (!pMask) return std::make_pair(nullptr, makeError("could not instantiate ObstacleMask"));
+    pMask->m_size = image.size;
+
+    // image rows go top down, the mask's bottom up
+    std::size_t const count = image.values.size();
+    std::vector<bool> allowed(count);
+    std::vector<bool> obstacle(count);
+    for (int y = 0; y < image.size.y; y++)
+    {
+        for (int x = 0; x < image.size.x; x++)
+        {
+            bool light = image.at(x, image.size.y - 1 - y) >= 0.5f;
+            std::size_t i = static_cast<std::size_t>(y) * image.size.x + x;
+            allowed[i] = light != invert;
+            obstacle[i] = !allowed[i];
+        }
+    }
+
+    // half a pixel off either way so that the zero crossing lies between an allowed and an obstacle pixel
+    auto toObstacle = distanceToFeatures(obstacle, image.size);
+    auto toAllowed = distanceToFeatures(allowed, image.size);
+    pMask->m_distances.resize(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        pMask->m_distances[i] = allowed[i] ? toObstacle[i] - 0.5f : 0.5f - toAllowed[i];
+    }
+
+    // A tile spans one pixel more than its side, as bilinear samples in it also read the next pixels.
+    // Coarser tiles are the union of four finer ones.
+    for (int level = 0; level < kPyramidLevels; level++)
+    {
+        int const side = kTileSize << level;
+        Level current;
+        current.shift = 0;
+        while ((1 << current.shift) < side) current.shift++;
+        current.tiles = glm::ivec2{(image.size.x + side - 1) / side, (image.size.y + side - 1) / side};
+        current.values.assign(static_cast<std::size_t>(current.tiles.x) * current.tiles.y,
+                              Tile{std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()});
+        for (int ty = 0; ty < current.tiles.y; ty++)
+        {
+            for (int tx = 0; tx < current.tiles.x; tx++)
+            {
+                Tile& tile = current.values[static_cast<std::size_t>(ty) * current.tiles.x + tx];
+                if (level == 0)
+                {
+                    for (int y = ty * side; y <= std::min((ty + 1) * side, image.size.y - 1); y++)
+                    {
+                        for (int x = tx * side; x <= std::min((tx + 1) * side, image.size.x - 1); x++)
+                        {
+                            tile.min = std::min(tile.min, pMask->distanceAt(x, y));
+                            tile.max = std::max(tile.max, pMask->distanceAt(x, y));
+                        }
+                    }
+                    continue;
+                }
+                Level const& finer = pMask->m_levels.back();
+                for (int y = 2 * ty; y <= std::min(2 * ty + 1, finer.tiles.y - 1); y++)
+                {
+                    for (int x = 2 * tx; x <= std::min(2 * tx + 1, finer.tiles.x - 1); x++)
+                    {
+                        Tile const& child = finer.values[static_cast<std::size_t>(y) * finer.tiles.x + x];
+                        tile.min = std::min(tile.min, child.min);
+                        tile.max = std::max(tile.max, child.max);
+                    }
+                }
+            }
+        }
+        pMask->m_levels.push_back(std::move(current));
+    }
+
+    Level const& finest = pMask->m_levels.front();
+    for (std::size_t i = 0; i < finest.values.size(); i++)
+    {
+        if (finest.values[i].max > 0.0f) pMask->m_allowedTiles.push_back(static_cast<std::uint32_t>(i));
+    }
+    return std::make_pair(pMask, nil);
+}
+
+glm::vec2 ObstacleMask::toPixels(glm::vec2 const& uv) const
+{
+    // pixel centers sit at half integers
+    glm::vec2 g = uv * glm::vec2{m_size} - glm::vec2{0.5f, 0.5f};
+    return glm::vec2{std::clamp(g.x, 0.0f, static_cast<float>(m_size.x - 1)), std::clamp(g.y, 0.0f, static_cast<float>(m_size.y - 1))};
+}
+
+bool ObstacleMask::allowed(glm::vec2 const& uv) const
+{
+    glm::vec2 g = toPixels(uv);
+    int x = static_cast<int>(g.x);
+    int y = static_cast<int>(g.y);
+    for (int level = kPyramidLevels - 1; level >= 0; level--)
+    {
+        Level const& tiles = m_levels[level];
+        Tile const& tile = tiles.values[static_cast<std::size_t>(y >> tiles.shift) * tiles.tiles.x + (x >> tiles.shift)];
+        if (tile.min > 0.0f) return true;
+        if (tile.max <= 0.0f) return false;
+    }
+    return signedDistance(uv) > 0.0f;
+}
+
+float ObstacleMask::signedDistance(glm::vec2 const& uv) const
+{
+    glm::vec2 g = toPixels(uv);
+    int x0 = static_cast<int>(g.x);
+    int y0 = static_cast<int>(g.y);
+    int x1 = std::min(x0 + 1, m_size.x - 1);
+    int y1 = std::min(y0 + 1, m_size.y - 1);
+    float tx = g.x - x0;
+    float ty = g.y - y0;
+    float bottom = distanceAt(x0, y0) + tx * (distanceAt(x1, y0) - distanceAt(x0, y0));
+    float top = distanceAt(x0, y1) + tx * (distanceAt(x1, y1) - distanceAt(x0, y1));
+    return bottom + ty * (top - bottom);
+}
+
+glm::vec2 ObstacleMask::gradient(glm::vec2 const& uv) const
+{
+    glm::vec2 pixel = glm::vec2{1.0f, 1.0f} / glm::vec2{m_size};
+    float dx = signedDistance(uv + glm::vec2{pixel.x, 0.0f}) - signedDistance(uv - glm::vec2{pixel.x, 0.0f});
+    float dy = signedDistance(uv + glm::vec2{0.0f, pixel.y}) - signedDistance(uv - glm::vec2{0.0f, pixel.y});
+    return glm::vec2{dx / (2.0f * pixel.x), dy / (2.0f * pixel.y)};
+}
+
+bool ObstacleMask::sampleAllowed(glm::vec2& uv, RandomSource& random) const
+{
+    if (m_allowedTiles.empty()) return false;
+    Level const& finest = m_levels.front();
+    glm::vec2 const tileSize = glm::vec2{static_cast<float>(kTileSize), static_cast<float>(kTileSize)} / glm::vec2{m_size};
+    std::uniform_int_distribution<std::size_t> pickTile{0, m_allowedTiles.size() - 1};
+    // a new tile for every try keeps the samples uniform over the allowed area
+    for (int attempt = 0; attempt < kSampleAttempts; attempt++)
+    {
+        std::uint32_t tile = m_allowedTiles[pickTile(random.generator)];
+        glm::vec2 corner{static_cast<float>(tile % finest.tiles.x), static_cast<float>(tile / finest.tiles.x)};
+        glm::vec2 candidate = (corner + glm::vec2{random.uniform(0.0f, 1.0f), random.uniform(0.0f, 1.0f)}) * tileSize;
+        if (candidate.x >= 1.0f || candidate.y >= 1.0f || !allowed(candidate)) continue;
+        uv = candidate;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Error.h"
+#include "Pgm.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct RandomSource;
+
+// Region of the window traces may live in, from a grayscale image stretched over the window, see
+// Scenario::Options::pObstacleMask. The image is turned once into a signed distance field, in pixels
+// of the image and positive inside the allowed region, plus a pyramid of the field's minimum and
+// maximum over square tiles. allowed() looks at the tiles from coarse to fine and only samples the
+// field for positions whose finest tile straddles an edge.
+// Positions are in mask units, from (0, 0) at the bottom left of the window to (1, 1) at the top
+// right; those outside count as on the nearest edge.
+struct ObstacleMask
+{
+    // light pixels (at least half gray) are allowed and dark ones obstacles, the reverse with invert
+    static std::pair<std::shared_ptr<ObstacleMask>, Error> load(std::string const& pgmPath, bool invert);
+    static std::pair<std::shared_ptr<ObstacleMask>, Error> make(GrayImage const& image, bool invert);
+
+    bool allowed(glm::vec2 const& uv) const;
+    // bilinearly interpolated, in image pixels
+    float signedDistance(glm::vec2 const& uv) const;
+    // of the signed distance in mask units, pointing into the allowed region
+    glm::vec2 gradient(glm::vec2 const& uv) const;
+    // uniformly random allowed position, false when nothing is allowed
+    bool sampleAllowed(glm::vec2& uv, RandomSource& random) const;
+
+    glm::ivec2 size() const { return m_size; }
+
+    // side of the finest tiles in pixels, a power of two; each level above doubles it
+    static int const kTileSize;
+    static int const kPyramidLevels;
+
+private:
+    struct Tile
+    {
+        float min;
+        float max;
+    };
+
+    struct Level
+    {
+        // log2 of the tile side
+        int shift;
+        glm::ivec2 tiles;
+        std::vector<Tile> values;
+    };
+
+    float distanceAt(int x, int y) const { return m_distances[static_cast<std::size_t>(y) * m_size.x + x]; }
+    glm::vec2 toPixels(glm::vec2 const& uv) const;
+
+    glm::ivec2 m_size{};
+    // rows bottom up
+    std::vector<float> m_distances;
+    // finest level first
+    std::vector<Level> m_levels;
+    // finest tiles holding any allowed pixel, for sampleAllowed()
+    std::vector<std::uint32_t> m_allowedTiles;
+};
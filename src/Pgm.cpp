@@ -0,0 +1,89 @@
+#include "Pgm.h"
+#include <cctype>
+#include <fstream>
+
+namespace {
+
+// next header token, skipping whitespace and comments
+bool readToken(std::istream& stream, std::string& token)
+{
+    token.clear();
+    int c = stream.get();
+    while (c != EOF && (std::isspace(c) || c == '#'))
+    {
+        if (c == '#') while (c != EOF && c != '\n') c = stream.get();
+        c = stream.get();
+    }
+    while (c != EOF && !std::isspace(c))
+    {
+        token.push_back(static_cast<char>(c));
+        c = stream.get();
+    }
+    return !token.empty();
+}
+
+bool readNumber(std::istream& stream, int& value)
+{
+    std::string token;
+    if (!readToken(stream, token)) return false;
+    try
+    {
+        value = std::stoi(token);
+    }
+    catch (std::exception const&)
+    {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::pair<GrayImage, Error> readPgm(std::string const& path)
+{
+    std::ifstream stream{path, std::ios::binary};
+    if (!stream.is_open()) return std::make_pair(GrayImage{}, makeError("could not open file:", path));
+
+    std::string magic;
+    readToken(stream, magic);
+    if (magic != "P5" && magic != "P2") return std::make_pair(GrayImage{}, makeError(path, "is not a PGM file"));
+    bool const binary = magic == "P5";
+
+    GrayImage image;
+    int maxValue{0};
+    if (!readNumber(stream, image.size.x) || !readNumber(stream, image.size.y) || !readNumber(stream, maxValue)
+        || image.size.x <= 0 || image.size.y <= 0 || maxValue <= 0 || maxValue > 65535)
+    {
+        return std::make_pair(GrayImage{}, makeError("invalid PGM header in", path));
+    }
+
+    std::size_t const count = static_cast<std::size_t>(image.size.x) * image.size.y;
+    image.values.resize(count);
+    float const scale = 1.0f / maxValue;
+    if (binary)
+    {
+        std::size_t const sampleBytes = maxValue < 256 ? 1 : 2;
+        std::vector<unsigned char> bytes(count * sampleBytes);
+        stream.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        if (static_cast<std::size_t>(stream.gcount()) != bytes.size())
+        {
+            return std::make_pair(GrayImage{}, makeError("truncated PGM file", path));
+        }
+        for (std::size_t i = 0; i < count; i++)
+        {
+            // 16 bit samples are big endian
+            int value = sampleBytes == 1 ? bytes[i] : (bytes[2 * i] << 8) | bytes[2 * i + 1];
+            image.values[i] = value * scale;
+        }
+    }
+    else
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            int value{0};
+            if (!readNumber(stream, value)) return std::make_pair(GrayImage{}, makeError("truncated PGM file", path));
+            image.values[i] = value * scale;
+        }
+    }
+    return std::make_pair(image, nil);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Error.h"
+#include <glm/glm.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Grayscale image with values normalized to [0, 1], rows top first.
+struct GrayImage
+{
+    glm::ivec2 size{};
+    std::vector<float> values;
+
+    float at(int x, int y) const { return values[static_cast<std::size_t>(y) * size.x + x]; }
+};
+
+// Reads a binary (P5) or plain (P2) PGM file, 8 or 16 bits deep.
+std::pair<GrayImage, Error> readPgm(std::string const& path);
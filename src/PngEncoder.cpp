@@ -0,0 +1,384 @@
+#include "PngEncoder.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+std::size_t const kMinMatch{3};
+std::size_t const kMaxMatch{258};
+std::size_t const kWindowSize{32768};
+std::size_t const kMaxChainLength{8};
+unsigned const kHashBits{15};
+std::size_t const kStripeBytes{256 * 1024};
+std::uint32_t const kAdlerBase{65521};
+
+struct HuffmanCode
+{
+    std::uint16_t bits;
+    std::uint8_t length;
+};
+
+// Fixed Huffman codes of RFC 1951 3.2.6, bit-reversed so they can be written LSB first.
+struct FixedCodes
+{
+    std::array<HuffmanCode, 288> literals;
+    std::array<HuffmanCode, 30> distances;
+    std::array<std::uint16_t, kMaxMatch + 1> lengthSymbols;
+    std::array<std::uint8_t, 512> distanceSymbols;
+
+    static constexpr std::array<std::uint16_t, 29> lengthBase{
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static constexpr std::array<std::uint8_t, 29> lengthExtraBits{
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static constexpr std::array<std::uint16_t, 30> distanceBase{
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+        4097, 6145, 8193, 12289, 16385, 24577};
+    static constexpr std::array<std::uint8_t, 30> distanceExtraBits{
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    FixedCodes()
+    {
+        auto reversed = [](std::uint32_t code, unsigned length)
+        {
+            std::uint32_t result{0};
+            for (unsigned i = 0; i < length; i++) result |= ((code >> i) & 1u) << (length - 1 - i);
+            return static_cast<std::uint16_t>(result);
+        };
+        for (std::uint32_t symbol = 0; symbol < literals.size(); symbol++)
+        {
+            if (symbol < 144) literals[symbol] = {reversed(0x30 + symbol, 8), 8};
+            else if (symbol < 256) literals[symbol] = {reversed(0x190 + symbol - 144, 9), 9};
+            else if (symbol < 280) literals[symbol] = {reversed(symbol - 256, 7), 7};
+            else literals[symbol] = {reversed(0xc0 + symbol - 280, 8), 8};
+        }
+        for (std::uint32_t symbol = 0; symbol < distances.size(); symbol++)
+        {
+            distances[symbol] = {reversed(symbol, 5), 5};
+        }
+        for (std::size_t code = 0; code < lengthBase.size(); code++)
+        {
+            std::size_t end = code + 1 < lengthBase.size() ? lengthBase[code + 1] : kMaxMatch + 1;
+            for (std::size_t length = lengthBase[code]; length < end; length++)
+            {
+                lengthSymbols[length] = static_cast<std::uint16_t>(257 + code);
+            }
+        }
+        // the lookup of zlib: distances up to 256 directly, larger ones in steps of 128
+        for (std::size_t code = 0; code < distanceBase.size(); code++)
+        {
+            std::size_t end = distanceBase[code] + (std::size_t{1} << distanceExtraBits[code]);
+            for (std::size_t distance = distanceBase[code]; distance < end; distance++)
+            {
+                std::size_t index = distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7);
+                distanceSymbols[index] = static_cast<std::uint8_t>(code);
+            }
+        }
+    }
+
+    std::size_t distanceSymbol(std::size_t distance) const
+    {
+        return distanceSymbols[distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7)];
+    }
+};
+
+FixedCodes const& fixedCodes()
+{
+    static FixedCodes const codes;
+    return codes;
+}
+
+struct BitWriter
+{
+    std::vector<std::uint8_t>& out;
+    std::uint64_t bits{0};
+    unsigned count{0};
+
+    void put(std::uint32_t value, unsigned length)
+    {
+        bits |= static_cast<std::uint64_t>(value) << count;
+        count += length;
+        while (count >= 8)
+        {
+            out.push_back(static_cast<std::uint8_t>(bits));
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    void alignToByte()
+    {
+        if (count > 0) put(0, 8 - count);
+    }
+};
+
+std::uint32_t hash3(std::uint8_t const* p)
+{
+    std::uint32_t v = (std::uint32_t{p[0]} << 16) | (std::uint32_t{p[1]} << 8) | p[2];
+    return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+// One fixed-Huffman block followed by an empty stored block, so the output ends on a byte boundary
+// and can be followed by the next stripe or the final block.
+void deflateStripe(std::uint8_t const* data, std::size_t size, std::vector<std::uint8_t>& out)
+{
+    auto const& codes = fixedCodes();
+    BitWriter writer{out};
+    writer.put(1u << 1, 3);
+
+    std::vector<std::int32_t> head(std::size_t{1} << kHashBits, -1);
+    std::vector<std::int32_t> previous(kWindowSize, -1);
+    auto insert = [&](std::size_t position)
+    {
+        std::uint32_t h = hash3(data + position);
+        std::int32_t candidate = head[h];
+        head[h] = static_cast<std::int32_t>(position);
+        previous[position & (kWindowSize - 1)] = candidate;
+        return candidate;
+    };
+
+    std::size_t position{0};
+    while (position < size)
+    {
+        std::size_t bestLength{0};
+        std::size_t bestDistance{0};
+        if (position + kMinMatch <= size)
+        {
+            std::size_t const maxLength = std::min(kMaxMatch, size - position);
+            std::int32_t candidate = insert(position);
+            for (std::size_t chain = 0; candidate >= 0 && position - candidate <= kWindowSize && chain < kMaxChainLength; chain++)
+            {
+                std::uint8_t const* pCandidate = data + candidate;
+                std::uint8_t const* pCurrent = data + position;
+                std::size_t length{0};
+                while (length < maxLength && pCandidate[length] == pCurrent[length]) length++;
+                if (length > bestLength)
+                {
+                    bestLength = length;
+                    bestDistance = position - candidate;
+                    if (length == maxLength) break;
+                }
+                candidate = previous[candidate & (kWindowSize - 1)];
+            }
+        }
+
+        if (bestLength < kMinMatch)
+        {
+            auto const& code = codes.literals[data[position]];
+            writer.put(code.bits, code.length);
+            position++;
+            continue;
+        }
+
+        std::size_t lengthSymbol = codes.lengthSymbols[bestLength];
+        auto const& lengthCode = codes.literals[lengthSymbol];
+        writer.put(lengthCode.bits, lengthCode.length);
+        writer.put(static_cast<std::uint32_t>(bestLength - FixedCodes::lengthBase[lengthSymbol - 257]), FixedCodes::lengthExtraBits[lengthSymbol - 257]);
+        std::size_t distanceSymbol = codes.distanceSymbol(bestDistance);
+        auto const& distanceCode = codes.distances[distanceSymbol];
+        writer.put(distanceCode.bits, distanceCode.length);
+        writer.put(static_cast<std::uint32_t>(bestDistance - FixedCodes::distanceBase[distanceSymbol]), FixedCodes::distanceExtraBits[distanceSymbol]);
+
+        for (std::size_t i = 1; i < bestLength && position + i + kMinMatch <= size; i++) insert(position + i);
+        position += bestLength;
+    }
+
+    auto const& endOfBlock = codes.literals[256];
+    writer.put(endOfBlock.bits, endOfBlock.length);
+    writer.put(0, 3);
+    writer.alignToByte();
+    out.insert(out.end(), {0x00, 0x00, 0xff, 0xff});
+}
+
+std::uint32_t adler32(std::uint8_t const* data, std::size_t size)
+{
+    std::uint32_t a{1};
+    std::uint32_t b{0};
+    while (size > 0)
+    {
+        // largest run that cannot overflow b before the modulo
+        std::size_t run = std::min<std::size_t>(size, 5552);
+        for (std::size_t i = 0; i < run; i++)
+        {
+            a += data[i];
+            b += a;
+        }
+        a %= kAdlerBase;
+        b %= kAdlerBase;
+        data += run;
+        size -= run;
+    }
+    return (b << 16) | a;
+}
+
+std::uint32_t adler32Combine(std::uint32_t adler1, std::uint32_t adler2, std::size_t size2)
+{
+    std::uint32_t remainder = static_cast<std::uint32_t>(size2 % kAdlerBase);
+    std::uint32_t sum1 = adler1 & 0xffff;
+    std::uint32_t sum2 = static_cast<std::uint32_t>((static_cast<std::uint64_t>(remainder) * sum1) % kAdlerBase);
+    sum1 += (adler2 & 0xffff) + kAdlerBase - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + kAdlerBase - remainder;
+    if (sum1 >= kAdlerBase) sum1 -= kAdlerBase;
+    if (sum1 >= kAdlerBase) sum1 -= kAdlerBase;
+    if (sum2 >= (kAdlerBase << 1)) sum2 -= (kAdlerBase << 1);
+    if (sum2 >= kAdlerBase) sum2 -= kAdlerBase;
+    return (sum2 << 16) | sum1;
+}
+
+std::uint32_t crc32(std::uint8_t const* data, std::size_t size, std::uint32_t crc = 0)
+{
+    static auto const table = []()
+    {
+        std::array<std::uint32_t, 256> table{};
+        for (std::uint32_t n = 0; n < table.size(); n++)
+        {
+            std::uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        return table;
+    }();
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+void put32(std::vector<std::uint8_t>& out, std::uint32_t value)
+{
+    out.insert(out.end(), {static_cast<std::uint8_t>(value >> 24), static_cast<std::uint8_t>(value >> 16),
+                           static_cast<std::uint8_t>(value >> 8), static_cast<std::uint8_t>(value)});
+}
+
+void putChunk(std::vector<std::uint8_t>& out, char const* type, std::uint8_t const* data, std::size_t size)
+{
+    put32(out, static_cast<std::uint32_t>(size));
+    std::size_t const typeOffset = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    put32(out, crc32(out.data() + typeOffset, size + 4));
+}
+
+std::uint8_t paeth(int left, int up, int upLeft)
+{
+    int estimate = left + up - upLeft;
+    int distanceLeft = std::abs(estimate - left);
+    int distanceUp = std::abs(estimate - up);
+    int distanceUpLeft = std::abs(estimate - upLeft);
+    if (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft) return static_cast<std::uint8_t>(left);
+    if (distanceUp <= distanceUpLeft) return static_cast<std::uint8_t>(up);
+    return static_cast<std::uint8_t>(upLeft);
+}
+
+// PNG rows are top to bottom, the source rows bottom to top
+void rgbRow(std::uint8_t const* pixels, glm::ivec2 const& size, int y, std::uint8_t* row)
+{
+    std::uint8_t const* source = pixels + static_cast<std::size_t>(size.y - 1 - y) * size.x * 4;
+    for (int x = 0; x < size.x; x++)
+    {
+        row[x * 3 + 0] = source[x * 4 + 0];
+        row[x * 3 + 1] = source[x * 4 + 1];
+        row[x * 3 + 2] = source[x * 4 + 2];
+    }
+}
+
+// Filters rows [begin, end) with whichever of None/Sub/Up/Paeth has the smallest sum of absolute
+// residuals, the usual heuristic.
+void filterRows(std::uint8_t const* pixels, glm::ivec2 const& size, int begin, int end, std::vector<std::uint8_t>& out)
+{
+    std::size_t const rowBytes = static_cast<std::size_t>(size.x) * 3;
+    std::vector<std::uint8_t> previousRow(rowBytes, 0);
+    std::vector<std::uint8_t> row(rowBytes);
+    std::array<std::vector<std::uint8_t>, 4> candidates;
+    for (auto& candidate : candidates) candidate.resize(rowBytes);
+    if (begin > 0) rgbRow(pixels, size, begin - 1, previousRow.data());
+
+    out.clear();
+    out.reserve((rowBytes + 1) * (end - begin));
+    for (int y = begin; y < end; y++)
+    {
+        rgbRow(pixels, size, y, row.data());
+        std::array<std::size_t, 4> costs{};
+        for (std::size_t i = 0; i < rowBytes; i++)
+        {
+            int left = i >= 3 ? row[i - 3] : 0;
+            int up = previousRow[i];
+            int upLeft = i >= 3 ? previousRow[i - 3] : 0;
+            std::uint8_t residuals[4] = {
+                row[i],
+                static_cast<std::uint8_t>(row[i] - left),
+                static_cast<std::uint8_t>(row[i] - up),
+                static_cast<std::uint8_t>(row[i] - paeth(left, up, upLeft))};
+            for (std::size_t filter = 0; filter < 4; filter++)
+            {
+                candidates[filter][i] = residuals[filter];
+                costs[filter] += static_cast<std::size_t>(std::abs(static_cast<std::int8_t>(residuals[filter])));
+            }
+        }
+        std::size_t best = std::min_element(costs.begin(), costs.end()) - costs.begin();
+        // the filter type bytes of None, Sub, Up and Paeth
+        static std::uint8_t const kFilterTypes[4] = {0, 1, 2, 4};
+        out.push_back(kFilterTypes[best]);
+        out.insert(out.end(), candidates[best].begin(), candidates[best].end());
+        std::swap(previousRow, row);
+    }
+}
+
+} // namespace
+
+std::vector<std::uint8_t> encodePng(std::uint8_t const* pixels, glm::ivec2 const& size)
+{
+    std::size_t const filteredRowBytes = static_cast<std::size_t>(size.x) * 3 + 1;
+    int const rowsPerStripe = static_cast<int>(std::max<std::size_t>(1, kStripeBytes / filteredRowBytes));
+    std::size_t const stripeCount = (size.y + rowsPerStripe - 1) / rowsPerStripe;
+
+    struct Stripe
+    {
+        std::vector<std::uint8_t> deflated;
+        std::uint32_t adler{1};
+        std::size_t filteredSize{0};
+    };
+    std::vector<Stripe> stripes(stripeCount);
+    ThreadPool::instance().parallelFor(stripeCount, 1, [&](std::size_t begin, std::size_t end)
+    {
+        std::vector<std::uint8_t> filtered;
+        for (std::size_t i = begin; i < end; i++)
+        {
+            int firstRow = static_cast<int>(i) * rowsPerStripe;
+            int lastRow = std::min(size.y, firstRow + rowsPerStripe);
+            filterRows(pixels, size, firstRow, lastRow, filtered);
+            stripes[i].adler = adler32(filtered.data(), filtered.size());
+            stripes[i].filteredSize = filtered.size();
+            deflateStripe(filtered.data(), filtered.size(), stripes[i].deflated);
+        }
+    });
+
+    std::vector<std::uint8_t> zlib{0x78, 0x01};
+    std::uint32_t adler{1};
+    for (auto const& stripe : stripes)
+    {
+        zlib.insert(zlib.end(), stripe.deflated.begin(), stripe.deflated.end());
+        adler = adler32Combine(adler, stripe.adler, stripe.filteredSize);
+    }
+    // empty final fixed-Huffman block
+    zlib.insert(zlib.end(), {0x03, 0x00});
+    put32(zlib, adler);
+
+    std::vector<std::uint8_t> png{0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    std::vector<std::uint8_t> header;
+    put32(header, static_cast<std::uint32_t>(size.x));
+    put32(header, static_cast<std::uint32_t>(size.y));
+    // 8 bit RGB, deflate, adaptive filtering, no interlacing
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+    png.reserve(zlib.size() + 64);
+    putChunk(png, "IHDR", header.data(), header.size());
+    std::size_t const kMaxChunkSize{std::size_t{1} << 30};
+    for (std::size_t offset = 0; offset < zlib.size(); offset += kMaxChunkSize)
+    {
+        putChunk(png, "IDAT", zlib.data() + offset, std::min(kMaxChunkSize, zlib.size() - offset));
+    }
+    putChunk(png, "IEND", nullptr, 0);
+    return png;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Encodes tightly packed RGBA rows, bottom row first as glReadPixels returns them, as an RGB PNG.
+// The image is deflated in independent stripes of rows on the library thread pool, each stripe ending
+// on a byte boundary so the compressed stripes can simply be concatenated into one zlib stream.
+std::vector<std::uint8_t> encodePng(std::uint8_t const* pixels, glm::ivec2 const& size);
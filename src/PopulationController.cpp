@@ -0,0 +1,84 @@
+#include "PopulationController.h"
+
+#include <algorithm>
+#include <cmath>
+
+PopulationController::PopulationController()
+    : PopulationController{0.5f, 0, std::chrono::nanoseconds{0}}
+{}
+
+PopulationController::PopulationController(float initialSplitProbability, std::size_t maxTraces, std::chrono::nanoseconds frameBudget)
+    : m_splitProbability{std::clamp(initialSplitProbability, 0.0f, 1.0f)}
+    , m_maxTraces{maxTraces}
+    , m_softCap{maxTraces - maxTraces / 5}
+    , m_frameBudget{frameBudget}
+    , m_targetSegments{m_softCap}
+{}
+
+void PopulationController::measure(std::size_t segmentCount, std::chrono::nanoseconds stepTime, std::chrono::nanoseconds drawTime)
+{
+    if (segmentCount < kMinSegmentsForMeasurement) return;
+    double nanosecondsPerSegment = static_cast<double>((stepTime + drawTime).count()) / segmentCount;
+    m_nanosecondsPerSegment = m_nanosecondsPerSegment == 0.0
+            ? nanosecondsPerSegment
+            : m_nanosecondsPerSegment + kCostSmoothing * (nanosecondsPerSegment - m_nanosecondsPerSegment);
+
+    if (m_frameBudget.count() <= 0 || m_nanosecondsPerSegment <= 0.0) return;
+    double affordable = static_cast<double>(m_frameBudget.count()) / m_nanosecondsPerSegment;
+    std::size_t candidate = static_cast<std::size_t>(std::min(affordable, static_cast<double>(m_softCap)));
+    candidate = std::max(candidate, std::min(kMinTargetSegments, m_softCap));
+    double relativeChange = std::abs(static_cast<double>(candidate) - m_targetSegments) / std::max<std::size_t>(m_targetSegments, 1);
+    if (relativeChange > kTargetHysteresis || candidate == m_softCap)
+    {
+        m_targetSegments = candidate;
+    }
+}
+
+void PopulationController::update(std::size_t population)
+{
+    m_spawnCount = 0;
+    if (m_targetSegments == 0) return;
+
+    float error = (static_cast<float>(m_targetSegments) - population) / m_targetSegments;
+    if (std::abs(error) <= kDeadBand)
+    {
+        m_error = 0.0f;
+        return;
+    }
+    m_error = error;
+
+    m_splitProbability = std::clamp(m_splitProbability + kSplitProbabilityIntegralGain * error, 0.0f, 1.0f);
+    if (error > 0.5f)
+    {
+        m_spawnCount = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(kSpawnGain * error * m_targetSegments)));
+    }
+}
+
+float PopulationController::splitProbability() const
+{
+    return std::clamp(m_splitProbability + kSplitProbabilityProportionalGain * m_error, 0.0f, 1.0f);
+}
+
+std::size_t PopulationController::spawnCount() const
+{
+    return m_spawnCount;
+}
+
+std::size_t PopulationController::targetSegments() const
+{
+    return m_targetSegments;
+}
+
+std::size_t PopulationController::hardCap() const
+{
+    return m_maxTraces;
+}
+
+float const PopulationController::kDeadBand{0.1f};
+float const PopulationController::kTargetHysteresis{0.1f};
+float const PopulationController::kSplitProbabilityIntegralGain{0.004f};
+float const PopulationController::kSplitProbabilityProportionalGain{0.25f};
+float const PopulationController::kSpawnGain{0.1f};
+float const PopulationController::kCostSmoothing{0.05f};
+std::size_t const PopulationController::kMinSegmentsForMeasurement{16};
+std::size_t const PopulationController::kMinTargetSegments{20};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+// Steers a scenario's population towards a segment budget instead of killing traces in bulk.
+// The budget is the number of segments that fit in the scenario's share of the frame, derived
+// from the measured step and draw cost per segment. It stays below maxTraces.
+// The split probability follows a PI controller on the relative error (the integral part lets it
+// settle wherever births balance deaths), and traces are spawned while the population is far
+// below the budget. Errors inside the dead band leave both untouched.
+struct PopulationController
+{
+    PopulationController();
+    PopulationController(float initialSplitProbability, std::size_t maxTraces, std::chrono::nanoseconds frameBudget);
+
+    void measure(std::size_t segmentCount, std::chrono::nanoseconds stepTime, std::chrono::nanoseconds drawTime);
+    void update(std::size_t population);
+
+    float splitProbability() const;
+    std::size_t spawnCount() const;
+    std::size_t targetSegments() const;
+    std::size_t hardCap() const;
+
+    static float const kDeadBand;
+    static float const kTargetHysteresis;
+    static float const kSplitProbabilityIntegralGain;
+    static float const kSplitProbabilityProportionalGain;
+    static float const kSpawnGain;
+    static float const kCostSmoothing;
+    static std::size_t const kMinSegmentsForMeasurement;
+    static std::size_t const kMinTargetSegments;
+
+private:
+    float m_splitProbability{0.5f};
+    float m_error{0.0f};
+    std::size_t m_maxTraces{0};
+    std::size_t m_softCap{0};
+    std::chrono::nanoseconds m_frameBudget{};
+    double m_nanosecondsPerSegment{0.0};
+    std::size_t m_targetSegments{0};
+    std::size_t m_spawnCount{0};
+};
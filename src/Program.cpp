@@ -1,40 +1,115 @@
 #include "Program.h"
 #include "Utils.h"
+#include <mutex>
+#include <unordered_map>
 
-Error linkProgram(GLuint id);
 std::pair<std::string, Error> getProgramLinkLog(GLuint id);
+std::shared_ptr<const GLuint> makeSharedProgram(GLuint id);
 
-std::pair<std::shared_ptr<const GLuint>, Error> makeProgram(std::shared_ptr<const GLuint> pVert, std::shared_ptr<const GLuint> pFrag)
+namespace {
+
+std::mutex sharedProgramsMutex;
+std::unordered_map<std::string, std::weak_ptr<const GLuint>> sharedPrograms;
+
+} // namespace
+
+std::shared_ptr<const GLuint> makeSharedProgram(GLuint id)
+{
+    auto lDeleter = [](GLuint* pId)
+    {
+        if (!pId) return;
+        glDeleteProgram(*pId);
+    };
+    std::shared_ptr<const GLuint> pProgram;
+    pProgram.reset(new (std::nothrow)GLuint(id), lDeleter);
+    return pProgram;
+}
+
+std::pair<std::shared_ptr<const GLuint>, Error> makeProgram(std::shared_ptr<const GLuint> pVert, std::shared_ptr<const GLuint> pFrag, bool binaryRetrievable)
+{
+    auto [pProgram, err] = startProgram(pVert, pFrag, binaryRetrievable);
+    if (err != nil) return std::make_pair(nullptr, err);
+    err = linkStatus(*pProgram);
+    if (err != nil) return std::make_pair(nullptr, err);
+    return std::make_pair(pProgram, nil);
+}
+
+std::pair<std::shared_ptr<const GLuint>, Error> startProgram(std::shared_ptr<const GLuint> pVert, std::shared_ptr<const GLuint> pFrag, bool binaryRetrievable)
 {
     GLuint id = glCreateProgram();
     if (id == InvalidId)
     {
         return std::make_pair(nullptr, makeError("could not glCreateProgram()"));
     }
+    auto pProgram = makeSharedProgram(id);
+    if (!pProgram)
+    {
+        glDeleteProgram(id);
+        return std::make_pair(nullptr, makeError("could not instantiate program (new gave nullptr)"));
+    }
     for (auto const pShaderId : {pVert, pFrag}) glAttachShader(id, *pShaderId);
-    auto err = linkProgram(id);
-    if (err == nil)
+    if (binaryRetrievable) glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(id);
+    return std::make_pair(pProgram, nil);
+}
+
+std::pair<std::shared_ptr<const GLuint>, Error> makeProgramFromBinary(GLenum binaryFormat, void const* pBinary, GLsizei size)
+{
+    GLuint id = glCreateProgram();
+    if (id == InvalidId)
+    {
+        return std::make_pair(nullptr, makeError("could not glCreateProgram()"));
+    }
+    glProgramBinary(id, binaryFormat, pBinary, size);
+    GLint ok{GL_FALSE};
+    glGetProgramiv(id, GL_LINK_STATUS, &ok);
+    if (ok != GL_TRUE)
+    {
+        glDeleteProgram(id);
+        return std::make_pair(nullptr, makeError("program binary of format", binaryFormat, "was rejected by the driver"));
+    }
+    auto pProgram = makeSharedProgram(id);
+    if (!pProgram)
     {
-        std::shared_ptr<const GLuint> pProgram;
-        auto lDeleter = [](GLuint* pId)
-        {
-            if (!pId) return;
-            glDeleteProgram(*pId);
-        };
-        pProgram.reset(new (std::nothrow)GLuint(id), lDeleter);
-        if (!pProgram)
-        {
-            return std::make_pair(nullptr, makeError("could not instantiate program (new gave nullptr)"));
-        }
-        return std::make_pair(pProgram, nil);
+        glDeleteProgram(id);
+        return std::make_pair(nullptr, makeError("could not instantiate program (new gave nullptr)"));
     }
-    return std::make_pair(nullptr, err);
+    return std::make_pair(pProgram, nil);
 }
 
-Error linkProgram(GLuint id)
+std::pair<std::shared_ptr<const GLuint>, Error> getSharedProgram(std::string const& key, std::function<std::pair<std::shared_ptr<const GLuint>, Error>()> const& make)
 {
-    if (id == InvalidId) return makeError("linkProgram() invalid ID passed in");
-    glLinkProgram(id);
+    std::lock_guard<std::mutex> lock{sharedProgramsMutex};
+
+    if (auto pProgram = sharedPrograms[key].lock()) return std::make_pair(pProgram, nil);
+
+    auto [pProgram, err] = make();
+    if (err != nil)
+    {
+        return std::make_pair(nullptr, makeError("could not build shared program", key, ":", err.value()));
+    }
+    sharedPrograms[key] = pProgram;
+    return std::make_pair(pProgram, nil);
+}
+
+std::shared_ptr<const GLuint> findSharedProgram(std::string const& key)
+{
+    std::lock_guard<std::mutex> lock{sharedProgramsMutex};
+    auto itProgram = sharedPrograms.find(key);
+    return itProgram == sharedPrograms.end() ? nullptr : itProgram->second.lock();
+}
+
+std::shared_ptr<const GLuint> shareProgram(std::string const& key, std::shared_ptr<const GLuint> pProgram)
+{
+    std::lock_guard<std::mutex> lock{sharedProgramsMutex};
+    if (auto pShared = sharedPrograms[key].lock()) return pShared;
+    sharedPrograms[key] = pProgram;
+    return pProgram;
+}
+
+Error linkStatus(GLuint id)
+{
+    if (id == InvalidId) return makeError("linkStatus() invalid ID passed in");
     GLint ok{-1};
     glGetProgramiv(id, GL_LINK_STATUS, &ok);
     if (ok == -1) return makeError("could not retrieve program link status");
@@ -2,7 +2,22 @@
 
 #include "Error.h"
 #include <GL/glew.h>
+#include <functional>
 #include <memory>
+#include <string>
 #include <utility>
 
-std::pair<std::shared_ptr<const GLuint>, Error> makeProgram(std::shared_ptr<const GLuint> pVert, std::shared_ptr<const GLuint> pFrag);
+// binaryRetrievable hints the driver that glGetProgramBinary will be called on the program
+std::pair<std::shared_ptr<const GLuint>, Error> makeProgram(std::shared_ptr<const GLuint> pVert, std::shared_ptr<const GLuint> pFrag, bool binaryRetrievable = false);
+// Attaches the shaders and submits the link without waiting for the result, which linkStatus() reports.
+std::pair<std::shared_ptr<const GLuint>, Error> startProgram(std::shared_ptr<const GLuint> pVert, std::shared_ptr<const GLuint> pFrag, bool binaryRetrievable = false);
+Error linkStatus(GLuint id);
+// Program from glGetProgramBinary output, fails when the driver no longer accepts the binary.
+std::pair<std::shared_ptr<const GLuint>, Error> makeProgramFromBinary(GLenum binaryFormat, void const* pBinary, GLsizei size);
+
+// Returns the program registered under key while anybody still holds it, otherwise builds it with make.
+std::pair<std::shared_ptr<const GLuint>, Error> getSharedProgram(std::string const& key, std::function<std::pair<std::shared_ptr<const GLuint>, Error>()> const& make);
+// The program registered under key if anybody still holds it, nullptr otherwise.
+std::shared_ptr<const GLuint> findSharedProgram(std::string const& key);
+// Registers pProgram under key, unless another one was registered meanwhile, which is returned instead.
+std::shared_ptr<const GLuint> shareProgram(std::string const& key, std::shared_ptr<const GLuint> pProgram);
@@ -0,0 +1,223 @@
+#include "ProgramCache.h"
+#include "Program.h"
+#include "Shader.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+char const kMagic[8] = {'T', 'R', 'C', 'P', 'R', 'O', 'G', '\0'};
+std::uint32_t const kVersion{1};
+
+struct CacheFileHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t binaryFormat;
+    std::uint64_t key;
+    std::uint64_t binarySize;
+    std::uint64_t binaryChecksum;
+};
+
+std::uint64_t fnv1a(void const* pData, std::size_t size, std::uint64_t hash = 0xcbf29ce484222325ull)
+{
+    auto pBytes = static_cast<unsigned char const*>(pData);
+    for (std::size_t i = 0; i < size; i++)
+    {
+        hash ^= pBytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::uint64_t hashString(std::string const& string, std::uint64_t hash)
+{
+    // the terminating zero keeps ("ab", "c") and ("a", "bc") apart
+    return fnv1a(string.c_str(), string.size() + 1, hash);
+}
+
+std::string glString(GLenum name)
+{
+    auto pString = reinterpret_cast<char const*>(glGetString(name));
+    return pString ? pString : "";
+}
+
+std::string insertDefines(std::string const& source, std::string const& defines)
+{
+    if (defines.empty()) return source;
+    std::size_t version = source.find("#version");
+    std::size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+    if (lineEnd == std::string::npos) return defines + "\n" + source;
+    return source.substr(0, lineEnd + 1) + defines + "\n" + source.substr(lineEnd + 1);
+}
+
+std::pair<std::shared_ptr<const GLuint>, Error> loadCachedProgram(std::string const& path, std::uint64_t key)
+{
+    std::unique_ptr<std::FILE, int(*)(std::FILE*)> pFile{std::fopen(path.c_str(), "rb"), std::fclose};
+    if (!pFile) return std::make_pair(nullptr, makeError("no cached program at", path));
+
+    CacheFileHeader header;
+    if (std::fread(&header, sizeof(header), 1, pFile.get()) != 1
+        || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0
+        || header.version != kVersion
+        || header.key != key
+        || header.binarySize == 0
+        || header.binarySize > static_cast<std::uint64_t>(INT32_MAX))
+    {
+        return std::make_pair(nullptr, makeError("invalid cached program header in", path));
+    }
+    std::vector<unsigned char> binary(header.binarySize);
+    if (std::fread(binary.data(), 1, binary.size(), pFile.get()) != binary.size()
+        || fnv1a(binary.data(), binary.size()) != header.binaryChecksum)
+    {
+        return std::make_pair(nullptr, makeError("truncated or corrupted cached program", path));
+    }
+    return makeProgramFromBinary(static_cast<GLenum>(header.binaryFormat), binary.data(), static_cast<GLsizei>(binary.size()));
+}
+
+void storeProgram(GLuint program, std::string const& directory, std::string const& path, std::uint64_t key)
+{
+    GLint binarySize{0};
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+    if (binarySize <= 0) return;
+    std::vector<unsigned char> binary(static_cast<std::size_t>(binarySize));
+    GLenum binaryFormat{0};
+    GLsizei length{0};
+    glGetProgramBinary(program, binarySize, &length, &binaryFormat, binary.data());
+    if (length <= 0) return;
+    binary.resize(static_cast<std::size_t>(length));
+
+    CacheFileHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.binaryFormat = binaryFormat;
+    header.key = key;
+    header.binarySize = binary.size();
+    header.binaryChecksum = fnv1a(binary.data(), binary.size());
+
+    // written under a unique name and renamed, so concurrent processes never see a partial file
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    std::string temporaryPath = path + "." + std::to_string(std::random_device{}()) + ".tmp";
+    std::unique_ptr<std::FILE, int(*)(std::FILE*)> pFile{std::fopen(temporaryPath.c_str(), "wb"), std::fclose};
+    if (!pFile) return;
+    bool written = std::fwrite(&header, sizeof(header), 1, pFile.get()) == 1
+            && std::fwrite(binary.data(), 1, binary.size(), pFile.get()) == binary.size();
+    written = std::fclose(pFile.release()) == 0 && written;
+    if (!written || std::rename(temporaryPath.c_str(), path.c_str()) != 0) std::remove(temporaryPath.c_str());
+}
+
+} // namespace
+
+std::string programCacheDirectory()
+{
+    if (char const* pDirectory = std::getenv("TRACES_PROGRAM_CACHE_DIR")) return pDirectory;
+#ifdef _WIN32
+    if (char const* pLocalAppData = std::getenv("LOCALAPPDATA")) return std::string{pLocalAppData} + "\\traces\\programs";
+#else
+    char const* pCacheHome = std::getenv("XDG_CACHE_HOME");
+    if (pCacheHome && *pCacheHome) return std::string{pCacheHome} + "/traces/programs";
+    if (char const* pHome = std::getenv("HOME")) return std::string{pHome} + "/.cache/traces/programs";
+#endif
+    return "";
+}
+
+std::pair<std::shared_ptr<PendingProgram>, Error> startCachedProgram(std::string const& vertexSource, std::string const& fragmentSource, std::string const& defines)
+{
+    std::string const vertex = insertDefines(vertexSource, defines);
+    std::string const fragment = insertDefines(fragmentSource, defines);
+
+    std::shared_ptr<PendingProgram> pPending{new (std::nothrow) PendingProgram()};
+    if (!pPending) return std::make_pair(nullptr, makeError("could not instantiate PendingProgram"));
+
+    GLint binaryFormatCount{0};
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormatCount);
+    pPending->directory = binaryFormatCount > 0 ? programCacheDirectory() : std::string{};
+    if (!pPending->directory.empty())
+    {
+        std::uint64_t key{0xcbf29ce484222325ull};
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION}) key = hashString(glString(name), key);
+        for (auto const& source : {vertex, fragment}) key = hashString(source, key);
+
+        char fileName[32];
+        std::snprintf(fileName, sizeof(fileName), "%016llx.bin", static_cast<unsigned long long>(key));
+        pPending->key = key;
+        pPending->path = (std::filesystem::path{pPending->directory} / fileName).string();
+
+        auto [pProgram, err] = loadCachedProgram(pPending->path, key);
+        if (err == nil)
+        {
+            pPending->pProgram = pProgram;
+            pPending->done = true;
+            return std::make_pair(pPending, nil);
+        }
+    }
+
+    pPending->parallel = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+    // lets the driver pick how many compiler threads to use
+    if (GLEW_KHR_parallel_shader_compile) glMaxShaderCompilerThreadsKHR(0xffffffffu);
+    else if (GLEW_ARB_parallel_shader_compile) glMaxShaderCompilerThreadsARB(0xffffffffu);
+
+    Error err;
+    std::tie(pPending->pVert, err) = startShader(vertex, GL_VERTEX_SHADER);
+    if (err == nil) std::tie(pPending->pFrag, err) = startShader(fragment, GL_FRAGMENT_SHADER);
+    if (err == nil) std::tie(pPending->pProgram, err) = startProgram(pPending->pVert, pPending->pFrag, !pPending->directory.empty());
+    if (err != nil) return std::make_pair(nullptr, err);
+    return std::make_pair(pPending, nil);
+}
+
+std::pair<std::shared_ptr<const GLuint>, Error> PendingProgram::poll()
+{
+    if (!done && parallel)
+    {
+        GLint completed{GL_FALSE};
+        glGetProgramiv(*pProgram, GL_COMPLETION_STATUS_KHR, &completed);
+        if (!completed) return std::make_pair(nullptr, nil);
+    }
+    return finish();
+}
+
+std::pair<std::shared_ptr<const GLuint>, Error> PendingProgram::finish()
+{
+    if (done) return std::make_pair(error == nil ? pProgram : nullptr, error);
+    done = true;
+
+    error = linkStatus(*pProgram);
+    if (error != nil)
+    {
+        // a compile error explains a failed link better than the link log
+        for (auto const& pShader : {pVert, pFrag})
+        {
+            auto compileError = compileStatus(*pShader);
+            if (compileError != nil)
+            {
+                error = compileError;
+                break;
+            }
+        }
+    }
+    pVert.reset();
+    pFrag.reset();
+    if (error != nil)
+    {
+        pProgram.reset();
+        return std::make_pair(nullptr, error);
+    }
+
+    if (!directory.empty()) storeProgram(*pProgram, directory, path, key);
+    return std::make_pair(pProgram, nil);
+}
+
+std::pair<std::shared_ptr<const GLuint>, Error> makeCachedProgram(std::string const& vertexSource, std::string const& fragmentSource, std::string const& defines)
+{
+    auto [pPending, err] = startCachedProgram(vertexSource, fragmentSource, defines);
+    if (err != nil) return std::make_pair(nullptr, err);
+    return pPending->finish();
+}
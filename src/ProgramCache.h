@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Error.h"
+#include <GL/glew.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+// Builds a program from vertex and fragment shader source, with defines inserted after the
+// #version line of both. The linked binary is stored in programCacheDirectory() under a hash of the
+// sources, the defines and the GL vendor, renderer and version, so that later processes on the same
+// driver load it with glProgramBinary instead of compiling. A missing, corrupted or rejected binary
+// falls back to compiling from source and is replaced. Needs the GL context.
+std::pair<std::shared_ptr<const GLuint>, Error> makeCachedProgram(std::string const& vertexSource, std::string const& fragmentSource, std::string const& defines = {});
+
+// A program from startCachedProgram() that the driver may still be compiling and linking.
+struct PendingProgram
+{
+    // nullptr without error while the driver is still busy, the linked program afterwards
+    std::pair<std::shared_ptr<const GLuint>, Error> poll();
+    // waits for the driver
+    std::pair<std::shared_ptr<const GLuint>, Error> finish();
+
+    std::shared_ptr<const GLuint> pProgram;
+    std::shared_ptr<const GLuint> pVert;
+    std::shared_ptr<const GLuint> pFrag;
+    bool parallel{false};
+    bool done{false};
+    Error error;
+    std::string directory;
+    std::string path;
+    std::uint64_t key{0};
+};
+
+// makeCachedProgram() without waiting for the compiler: with GL_KHR_parallel_shader_compile (or
+// the ARB variant) the driver compiles and links on its own threads while the caller goes on.
+// Binaries from the cache are ready at once.
+std::pair<std::shared_ptr<PendingProgram>, Error> startCachedProgram(std::string const& vertexSource, std::string const& fragmentSource, std::string const& defines = {});
+
+// $TRACES_PROGRAM_CACHE_DIR, else a "traces" directory in the user's cache directory. Empty when
+// caching is disabled by setting TRACES_PROGRAM_CACHE_DIR to an empty string or no directory is known.
+std::string programCacheDirectory();
@@ -0,0 +1,81 @@
+#include "QualityGovernor.h"
+
+#include <algorithm>
+
+namespace {
+
+double smooth(double average, double sample, float smoothing)
+{
+    return average + smoothing * (sample - average);
+}
+
+} // namespace
+
+QualityGovernor::QualityGovernor()
+    : QualityGovernor{std::chrono::nanoseconds{0}}
+{}
+
+QualityGovernor::QualityGovernor(std::chrono::nanoseconds frameBudget)
+    : m_frameBudget{frameBudget}
+{}
+
+bool QualityGovernor::update(std::chrono::nanoseconds cpuTime, std::optional<std::chrono::nanoseconds> gpuTime)
+{
+    m_cpuNanoseconds = smooth(m_cpuNanoseconds, static_cast<double>(cpuTime.count()), kTimeSmoothing);
+    if (gpuTime)
+    {
+        m_gpuNanoseconds = m_gpuNanoseconds
+                ? smooth(m_gpuNanoseconds.value(), static_cast<double>(gpuTime->count()), kTimeSmoothing)
+                : static_cast<double>(gpuTime->count());
+    }
+
+    m_framesSinceChange++;
+    if (m_frameBudget.count() <= 0 || m_framesSinceChange < kSettleFrames) return false;
+
+    double const budget = static_cast<double>(m_frameBudget.count());
+    double const load = m_gpuNanoseconds.value_or(m_cpuNanoseconds) / budget;
+    double const peakLoad = std::max(m_cpuNanoseconds, m_gpuNanoseconds.value_or(0.0)) / budget;
+
+    std::size_t level = m_level;
+    if (load > kDowngradeLoad && m_level + 1 < kLevels.size())
+    {
+        level = m_level + 1;
+    }
+    else if (peakLoad < kUpgradeLoad && m_level > 0)
+    {
+        if (++m_framesWithHeadroom >= kUpgradeFrames) level = m_level - 1;
+    }
+    else
+    {
+        m_framesWithHeadroom = 0;
+    }
+    if (level == m_level) return false;
+
+    m_level = level;
+    m_framesSinceChange = 0;
+    m_framesWithHeadroom = 0;
+    return true;
+}
+
+QualityGovernor::Level const& QualityGovernor::level() const
+{
+    return kLevels[m_level];
+}
+
+std::size_t QualityGovernor::levelIndex() const
+{
+    return m_level;
+}
+
+std::array<QualityGovernor::Level, 5> const QualityGovernor::kLevels{{
+    {1.0f,  true,  1.0f},
+    {0.85f, true,  1.0f},
+    {0.7f,  true,  0.85f},
+    {0.7f,  false, 0.85f},
+    {0.5f,  false, 0.7f},
+}};
+float const QualityGovernor::kDowngradeLoad{0.9f};
+float const QualityGovernor::kUpgradeLoad{0.6f};
+float const QualityGovernor::kTimeSmoothing{0.1f};
+std::size_t const QualityGovernor::kSettleFrames{30};
+std::size_t const QualityGovernor::kUpgradeFrames{120};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+
+// Steps a scenario's rendering quality down while its frames are over budget and back up once
+// there is headroom again. Each level scales the feedback buffer resolution and the trace line
+// width and turns the output blur on or off. The blur has no smaller kernel sizes to step through:
+// the present shader samples a fixed ring of taps at half a standard deviation, so a narrower blur
+// costs the same fill as the full one and only turning it off saves any.
+// Downgrades follow the GPU time when it is measured (resolution, blur and line width are fill
+// cost, a CPU bound frame does not get faster by dropping them), the CPU time otherwise; upgrades
+// need both to be well below the budget. Every change is followed by a settle period so that the
+// smoothed times reflect the new level before the next decision.
+struct QualityGovernor
+{
+    struct Level
+    {
+        float resolutionScale;
+        bool blur;
+        float lineWidthScale;
+    };
+
+    QualityGovernor();
+    explicit QualityGovernor(std::chrono::nanoseconds frameBudget);
+
+    // Feeds one frame; gpuTime is the measurement that arrived with it, if any. Returns true when the level changed.
+    bool update(std::chrono::nanoseconds cpuTime, std::optional<std::chrono::nanoseconds> gpuTime);
+
+    Level const& level() const;
+    std::size_t levelIndex() const;
+
+    static std::array<Level, 5> const kLevels;
+    static float const kDowngradeLoad;
+    static float const kUpgradeLoad;
+    static float const kTimeSmoothing;
+    static std::size_t const kSettleFrames;
+    static std::size_t const kUpgradeFrames;
+
+private:
+    std::chrono::nanoseconds m_frameBudget{};
+    std::size_t m_level{0};
+    double m_cpuNanoseconds{0.0};
+    std::optional<double> m_gpuNanoseconds;
+    std::size_t m_framesSinceChange{0};
+    std::size_t m_framesWithHeadroom{0};
+};
@@ -0,0 +1,59 @@
+#include "RandomSource.h"
+
+#include <array>
+
+namespace {
+
+std::size_t const kSplitSeeds{8};
+
+} // namespace
+
+RandomSource::RandomSource()
+    : generator{std::random_device{}()}
+{}
+
+RandomSource::RandomSource(std::seed_seq& seeds)
+    : generator{seeds}
+{}
+
+float RandomSource::uniform(float left, float right)
+{
+    std::uniform_real_distribution<float> dis{left, right};
+    return dis(generator);
+}
+
+glm::vec2 RandomSource::uniformInBox(BoundingBox const& bb)
+{
+    std::uniform_real_distribution<float> unifX{bb.topLeft.x, bb.bottomRight.x};
+    std::uniform_real_distribution<float> unifY{bb.bottomRight.y, bb.topLeft.y};
+    return glm::vec2{unifX(generator), unifY(generator)};
+}
+
+double RandomSource::normal()
+{
+    return normalDistribution(generator);
+}
+
+RandomSource RandomSource::split()
+{
+    std::array<std::uint32_t, kSplitSeeds> seeds;
+    for (auto& seed : seeds) seed = static_cast<std::uint32_t>(generator());
+    std::seed_seq seedSequence(seeds.begin(), seeds.end());
+    return RandomSource{seedSequence};
+}
+
+std::ostream& operator<<(std::ostream& str, RandomSource const& random)
+{
+    return str << random.generator << ' ' << random.normalDistribution << ' ' << random.geometricDistribution;
+}
+
+std::istream& operator>>(std::istream& str, RandomSource& random)
+{
+    return str >> random.generator >> random.normalDistribution >> random.geometricDistribution;
+}
+
+RandomSource& threadRandomSource()
+{
+    thread_local RandomSource random;
+    return random;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "BoundingBox.h"
+#include <glm/glm.hpp>
+#include <iostream>
+#include <random>
+
+// A generator and the distributions drawing from it, whose whole state operator<< writes and
+// operator>> reads back, see Snapshot.h. Not thread-safe: a scenario keeps one per range of
+// traces that may step on another thread, see Scenario::m_stepRandom.
+struct RandomSource
+{
+    // seeded from std::random_device
+    RandomSource();
+    explicit RandomSource(std::seed_seq& seeds);
+
+    float uniform(float left, float right);
+    glm::vec2 uniformInBox(BoundingBox const& bb);
+    // around 1, the speed of a new trace and its lifetime in seconds
+    double normal();
+    // another source, seeded from this one
+    RandomSource split();
+
+    std::mt19937 generator;
+    std::normal_distribution<> normalDistribution{1.0, 0.5};
+    std::geometric_distribution<> geometricDistribution;
+};
+
+std::ostream& operator<<(std::ostream& str, RandomSource const& random);
+std::istream& operator>>(std::istream& str, RandomSource& random);
+
+// for whatever draws outside a scenario, one per thread
+RandomSource& threadRandomSource();
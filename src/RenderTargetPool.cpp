@@ -0,0 +1,75 @@
+#include "RenderTargetPool.h"
+#include "Utils.h"
+
+namespace {
+void deleteTarget(RenderTarget const& target)
+{
+    glDeleteFramebuffers(1, &target.framebuffer);
+    glDeleteTextures(1, &target.texture);
+}
+}
+
+std::pair<RenderTarget, Error> RenderTargetPool::acquire(glm::ivec2 const& size)
+{
+    std::unique_lock<std::mutex> lock{mutex};
+    for (auto itTarget = idleTargets.begin(); itTarget != idleTargets.end(); itTarget++)
+    {
+        if (itTarget->size == size)
+        {
+            RenderTarget target = *itTarget;
+            idleTargets.erase(itTarget);
+            return std::make_pair(target, nil);
+        }
+    }
+
+    lock.unlock();
+
+    RenderTarget target;
+    target.size = size;
+    glGenFramebuffers(1, &target.framebuffer);
+    glGenTextures(1, &target.texture);
+
+    glBindTexture(GL_TEXTURE_2D, target.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.framebuffer);
+    glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target.texture, 0);
+    auto status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        deleteTarget(target);
+        return std::make_pair(RenderTarget{}, makeError("could not setup framebuffer of size", size.x, "x", size.y, ", status:", status));
+    }
+    return std::make_pair(target, nil);
+}
+
+void RenderTargetPool::release(RenderTarget const& target)
+{
+    if (target.framebuffer == InvalidId && target.texture == InvalidId) return;
+    std::lock_guard<std::mutex> lock{mutex};
+    if (idleTargets.size() >= kMaxIdleTargets)
+    {
+        deleteTarget(idleTargets.front());
+        idleTargets.erase(idleTargets.begin());
+    }
+    idleTargets.push_back(target);
+}
+
+void RenderTargetPool::clear()
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    for (auto const& target : idleTargets) deleteTarget(target);
+    idleTargets.clear();
+}
+
+std::size_t const RenderTargetPool::kMaxIdleTargets{8};
+std::mutex RenderTargetPool::mutex;
+std::vector<RenderTarget> RenderTargetPool::idleTargets;
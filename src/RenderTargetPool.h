@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Error.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+struct RenderTarget
+{
+    GLuint texture{0u};
+    GLuint framebuffer{0u};
+    glm::ivec2 size{};
+};
+
+// Keeps released texture/framebuffer pairs around so a scenario created after another one
+// was released can reuse its targets instead of allocating new ones.
+struct RenderTargetPool
+{
+    static std::pair<RenderTarget, Error> acquire(glm::ivec2 const& size);
+    static void release(RenderTarget const& target);
+    static void clear();
+
+    static std::size_t const kMaxIdleTargets;
+    static std::mutex mutex;
+    static std::vector<RenderTarget> idleTargets;
+};
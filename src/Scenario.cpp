@@ -2,45 +2,178 @@
 #include "BoundingBox.h"
 #include "BulkRenderer.h"
 #include "DoubleFramebuffer.h"
+#include "FlowField.h"
+#include "FrameReadback.h"
+#include "GpuTimer.h"
+#include "ObstacleMask.h"
+#include "Program.h"
+#include "ProgramCache.h"
 #include "Trace.h"
+#include "SegmentRecording.h"
+#include "Snapshot.h"
+#include "StepPolicies.h"
+#include "ThreadPool.h"
 #include "TraceFactory.h"
 #include "Utils.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <iterator>
 
+namespace {
 
-std::pair<std::shared_ptr<Scenario>, Error> Scenario::make(std::size_t initialTraceCount, const glm::ivec2 &windowSize)
+// traces steered by the flow field and attraction at once
+std::size_t const kSteeringBatch{256};
+// keeps the pull of nearby tips finite, in monometric units
+float const kAttractionSoftening{0.02f};
+// upper bound on the cells of the interaction grid per live trace
+float const kCellsPerTrace{4.0f};
+// traces one slice of a deferred refill spawns
+std::size_t const kSpawnSlice{64};
+// traces one slice of a deferred cut down to the cap removes
+std::size_t const kCullSlice{256};
+// traces beyond this multiple of the cap are removed at once instead of when there is time; it
+// bounds what a frame with no time to spare steps to a quarter more traces than the cap allows
+float const kMaxCapOvershoot{1.25f};
+
+// the population above which traces are removed at once
+std::size_t overshootLimit(std::size_t hardCap)
 {
-    return make(initialTraceCount, windowSize, nullptr);
+    return static_cast<std::size_t>(std::ceil(kMaxCapOvershoot * hardCap));
 }
 
-std::pair<std::shared_ptr<Scenario>, Error> Scenario::make(std::size_t initialTraceCount, const glm::ivec2 &windowSize, std::shared_ptr<Options> pOptions)
+// fraction of the way from p0 to p1 at which the segment properly crosses q0 q1, -1 if it does not;
+// segments only touching at an end, like those of a trace's two halves after a split, do not cross
+float crossingFraction(glm::vec2 const& p0, glm::vec2 const& p1, glm::vec2 const& q0, glm::vec2 const& q1)
 {
-    auto pScenario = std::make_shared<Scenario>();
-    if (!pScenario) return std::make_pair(nullptr, makeError("could not instantiate Scenario"));
-    if (pOptions != nullptr)
+    glm::vec2 r = p1 - p0;
+    glm::vec2 s = q1 - q0;
+    float denominator = r.x * s.y - r.y * s.x;
+    if (denominator == 0.0f) return -1.0f;
+    glm::vec2 d = q0 - p0;
+    // compared before dividing and without branches, as most candidates miss at random
+    float sign = denominator < 0.0f ? -1.0f : 1.0f;
+    denominator *= sign;
+    float tNumerator = sign * (d.x * s.y - d.y * s.x);
+    float uNumerator = sign * (d.x * r.y - d.y * r.x);
+    bool crosses = (tNumerator > 0.0f) & (tNumerator < denominator) & (uNumerator > 0.0f) & (uNumerator < denominator);
+    return crosses ? tNumerator / denominator : -1.0f;
+}
+
+// frames rendered below the readback's size are scaled up to it so that the output keeps its resolution
+Error captureFrame(FrameReadback& readback, RenderTarget const& frame)
+{
+    if (frame.size == readback.size()) return readback.capture(frame.framebuffer);
+
+    auto [scaled, err] = RenderTargetPool::acquire(readback.size());
+    if (err != nil) return err;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, frame.framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, scaled.framebuffer);
+    glBlitFramebuffer(0, 0, frame.size.x, frame.size.y, 0, 0, scaled.size.x, scaled.size.y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    err = readback.capture(scaled.framebuffer);
+    RenderTargetPool::release(scaled);
+    return err;
+}
+
+void makeTraces(TraceFactory& traceFactory, std::size_t count, glm::vec3 const& color, std::chrono::steady_clock::time_point creationTime,
+                std::vector<std::shared_ptr<Trace>>& vpTraces)
+{
+    vpTraces.reserve(vpTraces.size() + count);
+    for (std::size_t i = 0; i < count; i++)
     {
-        pScenario->m_options = *pOptions;
+        auto [pTrace, err] = traceFactory.make(BoundingBox{glm::vec2{-1.0, 1.0}, glm::vec2{1.0, -1.0}}, color, creationTime);
+        if (err != nil)
+        {
+            std::cout << "could not make trace: " << err.value() << std::endl;
+            continue;
+        }
+        vpTraces.push_back(pTrace);
     }
-    float windowHeightOverWidth = static_cast<float>(windowSize.y) / windowSize.x;
-    Error err;
-    std::tie(pScenario->m_pTraceFactory, err) = TraceFactory::getInstance(windowHeightOverWidth);
-    if (err != nil)
+}
+
+// calls fn with the lifetime policy the options select
+template <typename Fn>
+void withLifetimePolicy(Scenario::Options const& options, Fn&& fn)
+{
+    if (options.lifetime == Scenario::Lifetime::Immortal) fn(ImmortalLifetime{});
+    else fn(MortalLifetime{});
+}
+
+// calls fn with the obstacle policy the options select
+template <typename Fn>
+void withObstaclePolicy(Scenario::Options const& options, Fn&& fn)
+{
+    if (!options.pObstacleMask) fn(NoObstacles{});
+    else if (options.obstacleResponse == Scenario::ObstacleResponse::Deflect) fn(DeflectObstacles{});
+    else fn(KillObstacles{});
+}
+
+// calls fn with the boundary, lifetime and obstacle policies the options select
+template <typename Fn>
+void withStepPolicies(Scenario::Options const& options, Fn&& fn)
+{
+    withObstaclePolicy(options, [&options, &fn](auto obstacles)
     {
-        return std::make_pair(nullptr, makeError("could not build Scenario:", err.value()));
-    }
-    pScenario->m_pBulkRenderer = pScenario->m_pTraceFactory->getBulkRenderer();
-    pScenario->m_windowHeightOverWidth = windowHeightOverWidth;
-    pScenario->m_windowBoundariesMonometric = WindowBoundaries{windowHeightOverWidth};
+        withLifetimePolicy(options, [&options, &fn, obstacles](auto lifetime)
+        {
+            switch (options.boundary)
+            {
+            case Scenario::Boundary::Wrap: fn(WrapBoundary{}, lifetime, obstacles); break;
+            case Scenario::Boundary::Reflect: fn(ReflectBoundary{}, lifetime, obstacles); break;
+            case Scenario::Boundary::Kill: fn(KillBoundary{}, lifetime, obstacles); break;
+            }
+        });
+    });
+}
+
+// whether the rectangle from lower to upper lies wholly outside box
+bool outside(BoundingBox const& box, glm::vec2 const& lower, glm::vec2 const& upper)
+{
+    return upper.x < box.topLeft.x || lower.x > box.bottomRight.x || upper.y < box.bottomRight.y || lower.y > box.topLeft.y;
+}
 
+} // namespace
 
-    std::tie(pScenario->m_pDoubleFramebuffer, err) = DoubleFramebuffer::get(windowSize.x, windowSize.y);
-    if (err != nil)
+std::size_t const Scenario::kTracesPerStepChunk{2048};
+
+// what an asynchronous make() is still waiting for
+struct ScenarioSetup
+{
+    // a program variant, shared under key once linked
+    struct Program
     {
-        return std::make_pair(nullptr, makeError("could not make scenario:", err.value()));
-    }
-    pScenario->m_pDoubleFramebuffer->setBlurStandardDeviationOnBlitAndSwap(pOptions->traceBlurStandardDeviation);
+        std::string key;
+        std::shared_ptr<PendingProgram> pPending;
+        std::shared_ptr<const GLuint> pProgram;
+    };
 
-    pScenario->genTraces(initialTraceCount);
+    glm::ivec2 windowSize{};
+    std::size_t initialTraceCount{0};
+    Program traceProgram;
+    Program feedbackProgram;
+    Program presentProgram;
+    std::future<std::vector<std::shared_ptr<Trace>>> traces;
+    Error error;
+};
+
+std::pair<std::shared_ptr<Scenario>, Error> Scenario::make(std::size_t initialTraceCount, const glm::ivec2 &windowSize)
+{
+    return make(initialTraceCount, windowSize, nullptr);
+}
 
+std::pair<std::shared_ptr<Scenario>, Error> Scenario::make(std::size_t initialTraceCount, const glm::ivec2 &windowSize, std::shared_ptr<Options> pOptions)
+{
+    auto [pScenario, err] = make(initialTraceCount, windowSize, pOptions ? *pOptions : Options{});
+    if (err != nil) return std::make_pair(nullptr, err);
+    // unlike the other overloads, this one has always turned the blur of the options on
+    if (pScenario->m_pDoubleFramebuffer)
+    {
+        pScenario->m_pDoubleFramebuffer->setBlurStandardDeviationOnBlitAndSwap(pScenario->m_options.traceBlurStandardDeviation);
+        pScenario->m_fullQualityBlur = pScenario->m_options.traceBlurStandardDeviation;
+    }
     return std::make_pair(pScenario, nil);
 }
 
@@ -50,42 +183,201 @@ std::pair<std::shared_ptr<Scenario>, Error> Scenario::make(std::size_t initialTr
     if (!pScenario) return std::make_pair(nullptr, makeError("could not instantiate Scenario"));
 
     pScenario->m_options = options;
+    auto err = pScenario->setupRenderers(windowSize, nullptr, nullptr);
+    if (err != nil) return std::make_pair(nullptr, err);
+
+    pScenario->genTraces(initialTraceCount);
+
+    return std::make_pair(pScenario, nil);
+}
+
+std::pair<std::shared_ptr<Scenario>, Error> Scenario::makeAsync(std::size_t initialTraceCount, glm::ivec2 const& windowSize, Options options)
+{
+    auto pScenario = std::make_shared<Scenario>();
+    if (!pScenario) return std::make_pair(nullptr, makeError("could not instantiate Scenario"));
+    pScenario->m_options = options;
+
+    auto pSetup = std::make_shared<ScenarioSetup>();
+    pSetup->windowSize = windowSize;
+    pSetup->initialTraceCount = initialTraceCount;
+
+    auto startProgram = [](ScenarioSetup::Program& program, std::string const& key, auto&& start)
+    {
+        program.key = key;
+        // programs other scenarios already hold need no compiling
+        program.pProgram = findSharedProgram(key);
+        if (program.pProgram) return Error{nil};
+        Error err;
+        std::tie(program.pPending, err) = start();
+        return err;
+    };
+    ShaderFeatures traceFeatures = pScenario->traceShaderFeatures();
+    ShaderFeatures feedbackFeatures = pScenario->feedbackShaderFeatures();
+    // setupRenderers() leaves the blur off
+    ShaderFeatures presentFeatures = DoubleFramebuffer::presentFeatures(0.0f);
+    Error err = startProgram(pSetup->traceProgram, shaderVariantKey(TraceFactory::kSharedProgramKey, traceFeatures),
+                             [traceFeatures] { return TraceFactory::startProgram(traceFeatures); });
+    if (err == nil)
+    {
+        err = startProgram(pSetup->feedbackProgram, shaderVariantKey(DoubleFramebuffer::kSharedProgramKey, feedbackFeatures),
+                           [feedbackFeatures] { return DoubleFramebuffer::startQuadRenderProgram(feedbackFeatures); });
+    }
+    if (err == nil)
+    {
+        err = startProgram(pSetup->presentProgram, shaderVariantKey(DoubleFramebuffer::kSharedProgramKey, presentFeatures),
+                           [presentFeatures] { return DoubleFramebuffer::startQuadRenderProgram(presentFeatures); });
+    }
+    if (err != nil)
+    {
+        return std::make_pair(nullptr, makeError("could not build Scenario:", err.value()));
+    }
+    pScenario->m_pSetup = pSetup;
+    return std::make_pair(pScenario, nil);
+}
+
+Error Scenario::setupRenderers(glm::ivec2 const& windowSize, std::shared_ptr<const GLuint> pTraceProgram, std::shared_ptr<const GLuint> pFeedbackProgram)
+{
     float windowHeightOverWidth = static_cast<float>(windowSize.y) / windowSize.x;
     Error err;
-    std::tie(pScenario->m_pTraceFactory, err) = TraceFactory::getInstance(windowHeightOverWidth);
+    std::tie(m_pTraceFactory, err) = pTraceProgram
+            ? TraceFactory::make(windowHeightOverWidth, pTraceProgram)
+            : TraceFactory::make(windowHeightOverWidth, traceShaderFeatures());
     if (err != nil)
     {
-        return std::make_pair(nullptr, makeError("could not build Scenario:", err.value()));
+        return makeError("could not build Scenario:", err.value());
     }
-    pScenario->m_pBulkRenderer = pScenario->m_pTraceFactory->getBulkRenderer();
-    pScenario->m_windowHeightOverWidth = windowHeightOverWidth;
-    pScenario->m_windowBoundariesMonometric = WindowBoundaries{windowHeightOverWidth};
+    m_pTraceFactory->setTraceMemory(&m_traceMemory);
+    m_pTraceFactory->setRandomSource(&m_random);
+    m_pTraceFactory->setSpawnMask(m_options.pObstacleMask);
+    m_pBulkRenderer = m_pTraceFactory->getBulkRenderer();
+    m_windowHeightOverWidth = windowHeightOverWidth;
+    m_windowBoundariesMonometric = WindowBoundaries{windowHeightOverWidth};
+    // the window height spans 2 monometric units
+    m_minSegmentLengthMonometric = m_options.minSegmentPixels * 2.0f / windowSize.y;
+    m_avoidanceRadiusMonometric = m_options.avoidancePixels * 2.0f / windowSize.y;
 
 
-    std::tie(pScenario->m_pDoubleFramebuffer, err) = DoubleFramebuffer::get(windowSize.x, windowSize.y);
-    if (err != nil)
+    if (m_options.ownFramebuffers)
     {
-        return std::make_pair(nullptr, makeError("could not make scenario:", err.value()));
+        std::tie(m_pDoubleFramebuffer, err) = pFeedbackProgram
+                ? DoubleFramebuffer::make(windowSize.x, windowSize.y, pFeedbackProgram)
+                : DoubleFramebuffer::make(windowSize.x, windowSize.y, feedbackShaderFeatures());
+        if (err != nil)
+        {
+            return makeError("could not make scenario:", err.value());
+        }
+        if (m_options.offscreen) m_pDoubleFramebuffer->outputFramebuffer = std::nullopt;
     }
 
-    pScenario->genTraces(initialTraceCount);
+    m_populationController = PopulationController{
+            m_options.splitProbability,
+            m_options.maxTraces,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(m_options.stepPeriod * m_options.frameBudgetFraction)};
+    // room for every trace of the largest population finishStep() lets live splitting at once, so
+    // that a population peak late in a run does not have to grow the trace list and vertex buffers
+    std::size_t const maxPopulation = 2 * overshootLimit(m_options.maxTraces);
+    m_vpTraces.reserve(maxPopulation);
+    if (m_pBulkRenderer)
+    {
+        m_pBulkRenderer->setLineWidth(m_options.lineWidth);
+        m_pBulkRenderer->setLineAntialiasing(m_options.lineAntialiasing);
+        m_pBulkRenderer->reserve(maxPopulation, maxPopulation);
+    }
+    setAdaptiveQuality(m_options.adaptiveQuality);
+    return nil;
+}
 
-    return std::make_pair(pScenario, nil);
+ShaderFeatures Scenario::traceShaderFeatures() const
+{
+    return m_options.colorMode == ColorMode::VerticalGradient ? kShaderColorGradient : 0;
 }
 
-void Scenario::genTraces(int count)
+ShaderFeatures Scenario::feedbackShaderFeatures() const
 {
-    auto now = std::chrono::steady_clock::now();
-    for (int i = 0; i < count; i++)
+    return m_options.fadeMode == FadeMode::ToBlack ? kShaderFadeToBlack : kShaderFade;
+}
+
+std::pair<bool, Error> Scenario::advanceSetup()
+{
+    if (!m_pSetup) return std::make_pair(true, nil);
+    ScenarioSetup& setup = *m_pSetup;
+    if (setup.error != nil) return std::make_pair(false, setup.error);
+
+    auto pollProgram = [](ScenarioSetup::Program& program)
     {
-        auto [pTrace, err] = m_pTraceFactory->make(BoundingBox{glm::vec2{-1.0, 1.0}, glm::vec2{1.0, -1.0}}, m_options.color, now);
-        if (err != nil)
+        if (program.pProgram) return Error{nil};
+        auto [pLinked, err] = program.pPending->poll();
+        if (err != nil) return err;
+        if (!pLinked) return Error{nil};
+        program.pProgram = shareProgram(program.key, pLinked);
+        program.pPending.reset();
+        return Error{nil};
+    };
+    Error err = pollProgram(setup.traceProgram);
+    if (err == nil) err = pollProgram(setup.feedbackProgram);
+    if (err == nil) err = pollProgram(setup.presentProgram);
+    if (err == nil && setup.traceProgram.pProgram && setup.feedbackProgram.pProgram && setup.presentProgram.pProgram && !m_pDoubleFramebuffer)
+    {
+        err = setupRenderers(setup.windowSize, setup.traceProgram.pProgram, setup.feedbackProgram.pProgram);
+        if (err == nil)
         {
-            std::cout << "could not make trace: " << err.value() << std::endl;
-            continue;
+            m_pDoubleFramebuffer->presentPrograms[0] = setup.presentProgram.pProgram;
+            setup.traces = std::async(std::launch::async, [pTraceFactory = m_pTraceFactory, count = setup.initialTraceCount,
+                                                           color = m_options.color, creationTime = m_simulationTime]
+            {
+                std::vector<std::shared_ptr<Trace>> vpTraces;
+                makeTraces(*pTraceFactory, count, color, creationTime, vpTraces);
+                return vpTraces;
+            });
         }
-        m_vpTraces.push_back(pTrace);
     }
+    if (err != nil)
+    {
+        setup.error = err;
+        std::cerr << "could not set up scenario: " << err.value() << std::endl;
+        return std::make_pair(false, err);
+    }
+
+    if (!setup.traces.valid() || setup.traces.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+    {
+        return std::make_pair(false, nil);
+    }
+    // into the room setupRenderers() reserved
+    auto vpTraces = setup.traces.get();
+    m_vpTraces.assign(std::make_move_iterator(vpTraces.begin()), std::make_move_iterator(vpTraces.end()));
+    m_pSetup.reset();
+    return std::make_pair(true, nil);
+}
+
+bool Scenario::ready() const
+{
+    return !m_pSetup;
+}
+
+std::pair<std::shared_ptr<Scenario>, Error> Scenario::load(std::string const& snapshotPath, glm::ivec2 const& windowSize, Options options)
+{
+    auto [pScenario, err] = make(0, windowSize, options);
+    if (err != nil)
+    {
+        return std::make_pair(nullptr, makeError("could not load scenario:", err.value()));
+    }
+    err = loadSnapshot(*pScenario, snapshotPath);
+    if (err != nil)
+    {
+        return std::make_pair(nullptr, makeError("could not load scenario:", err.value()));
+    }
+    return std::make_pair(pScenario, nil);
+}
+
+Error Scenario::save(std::string const& snapshotPath, bool includeFeedbackTexture) const
+{
+    if (m_pSetup) return makeError("could not save scenario: it is not set up yet");
+    return saveSnapshot(*this, snapshotPath, includeFeedbackTexture);
+}
+
+void Scenario::genTraces(int count)
+{
+    makeTraces(*m_pTraceFactory, count, m_options.color, m_simulationTime, m_vpTraces);
 }
 
 Scenario::WindowBoundaries::WindowBoundaries()
@@ -106,69 +398,723 @@ Scenario::WindowBoundaries &Scenario::WindowBoundaries::operator=(const WindowBo
 
 void Scenario::step()
 {
-    std::vector<std::shared_ptr<Trace>> newTraces;
+    auto startTime = std::chrono::steady_clock::now();
+    addStepRandom();
+    stepTraces(0, m_vpTraces.size());
+    m_stepTracesTime = std::chrono::steady_clock::now() - startTime;
+    finishStep();
+}
 
-    auto itTrace = m_vpTraces.begin();
-    while (itTrace != m_vpTraces.end())
+void Scenario::addStepRandom()
+{
+    std::size_t const chunks = (m_vpTraces.size() + kTracesPerStepChunk - 1) / kTracesPerStepChunk;
+    while (m_stepRandom.size() < chunks) m_stepRandom.push_back(m_random.split());
+}
+
+void Scenario::stepTraces(std::size_t begin, std::size_t end)
+{
+    glm::vec2 const lower{m_windowBoundariesMonometric.topLeft.x, m_windowBoundariesMonometric.bottomRight.y};
+    glm::vec2 const upper{m_windowBoundariesMonometric.bottomRight.x, m_windowBoundariesMonometric.topLeft.y};
+    // each chunk of kTracesPerStepChunk traces draws from its own source, whichever thread steps it
+    for (std::size_t chunkBegin = begin; chunkBegin < end;)
     {
-        auto pTrace = *itTrace;
-        bool traceOutOfBoundary = !BoundingBox{m_windowBoundariesMonometric.topLeft, m_windowBoundariesMonometric.bottomRight}.contains(pTrace->position_);
-        if (traceOutOfBoundary ||
-                (m_vpTraces.size() > (m_options.maxTraces - (m_options.maxTraces / 5))))
+        std::size_t const chunk = chunkBegin / kTracesPerStepChunk;
+        std::size_t const chunkEnd = std::min(end, (chunk + 1) * kTracesPerStepChunk);
+        stepChunk(chunkBegin, chunkEnd, m_stepRandom[chunk], lower, upper);
+        chunkBegin = chunkEnd;
+    }
+}
+
+void Scenario::stepChunk(std::size_t begin, std::size_t end, RandomSource& random, glm::vec2 const& lower, glm::vec2 const& upper)
+{
+    withStepPolicies(m_options, [this, begin, end, &random, &lower, &upper](auto boundary, auto lifetime, auto obstacles)
+    {
+        using BoundaryPolicy = decltype(boundary);
+        using LifetimePolicy = decltype(lifetime);
+        using ObstaclePolicy = decltype(obstacles);
+        ObstacleMask const* pObstacleMask = m_options.pObstacleMask.get();
+        auto const now = m_simulationTime;
+        auto const stepPeriod = m_options.stepPeriod;
+        FlowField const* pFlowField = m_options.pFlowField.get();
+        bool const attract = m_options.attraction != 0.0f && m_attractionTree.pointCount() > 0;
+        if (!pFlowField && !attract)
         {
-            //std::cout << "KILL (" << (traceOutOfBoundary ? "B": "L") << ") " << *pTrace << std::endl;
-            pTrace->kill();
-            itTrace = m_vpTraces.erase(itTrace);
-            continue;
+            for (std::size_t i = begin; i < end; i++)
+            {
+                Trace& trace = *m_vpTraces[i];
+                BoundaryPolicy::apply(trace, lower, upper);
+                ObstaclePolicy::apply(trace, pObstacleMask, lower, upper);
+                if (LifetimePolicy::dead(trace, now)) continue;
+                trace.step(stepPeriod, random);
+            }
+            return;
         }
-        if (pTrace->isDead())
+
+        // steering a batch at a time keeps the field lookups in tight loops
+        std::array<glm::vec2, kSteeringBatch> positions;
+        std::array<glm::vec2, kSteeringBatch> steering;
+        float const flowWeight = m_options.flowWeight;
+        float const attraction = m_options.attraction;
+        float const openingAngle = m_options.attractionOpeningAngle;
+        for (std::size_t batchBegin = begin; batchBegin < end; batchBegin += kSteeringBatch)
         {
-            //std::cout << "DEAD " << *pTrace << std::endl;
-            if (uniformInInterval(0.0, 1.0) > 0.4)
+            std::size_t const count = std::min(kSteeringBatch, end - batchBegin);
+            for (std::size_t i = 0; i < count; i++)
             {
-                auto [pTrace1, pTrace2] = pTrace->split();
-                newTraces.push_back(pTrace1);
-                newTraces.push_back(pTrace2);
+                Trace& trace = *m_vpTraces[batchBegin + i];
+                BoundaryPolicy::apply(trace, lower, upper);
+                ObstaclePolicy::apply(trace, pObstacleMask, lower, upper);
+                positions[i] = trace.position_;
+            }
+            if (pFlowField)
+            {
+                pFlowField->sample(positions.data(), count, lower, upper, steering.data());
+                for (std::size_t i = 0; i < count; i++) steering[i] *= flowWeight;
+            }
+            else
+            {
+                std::fill(steering.begin(), steering.begin() + count, glm::vec2{0.0f, 0.0f});
+            }
+            if (attract)
+            {
+                for (std::size_t i = 0; i < count; i++)
+                {
+                    steering[i] += attraction * m_attractionTree.field(positions[i], openingAngle, kAttractionSoftening);
+                }
+            }
+            for (std::size_t i = 0; i < count; i++)
+            {
+                Trace& trace = *m_vpTraces[batchBegin + i];
+                if (LifetimePolicy::dead(trace, now)) continue;
+                trace.step(stepPeriod, steering[i], 1.0f, random);
             }
-            itTrace = m_vpTraces.erase(itTrace);
-            continue;
         }
-        pTrace->step(m_options.stepPeriod);
-        itTrace++;
+    });
+}
+
+void Scenario::finishStep()
+{
+    if (m_pSetup) return;
+    if (m_pSegmentReplay)
+    {
+        if (m_pBulkRenderer) m_pSegmentReplay->advance(*m_pBulkRenderer, m_replaySpeed);
+        return;
     }
+
+    auto startTime = std::chrono::steady_clock::now();
+    std::size_t steppedSegments = m_vpTraces.size();
+    std::lock_guard<std::mutex> recordingLock{m_recordingMutex};
+    if (m_pSegmentRecorder) m_pSegmentRecorder->beginFrame();
+
+    m_stepArena.reset();
+    interactTraces();
+    std::pmr::vector<std::shared_ptr<Trace>> newTraces{&m_stepArena};
+
+    float splitProbability = m_populationController.splitProbability();
+    withLifetimePolicy(m_options, [this, splitProbability, &newTraces](auto lifetime)
+    {
+        using LifetimePolicy = decltype(lifetime);
+        auto itKept = m_vpTraces.begin();
+        for (auto& pTrace : m_vpTraces)
+        {
+            if (pTrace->killed_)
+            {
+                emitSegment(*pTrace, true);
+                continue;
+            }
+            if (LifetimePolicy::dead(*pTrace, m_simulationTime))
+            {
+                emitSegment(*pTrace, true);
+                if (m_random.uniform(0.0, 1.0) < splitProbability)
+                {
+                    auto [pTrace1, pTrace2] = pTrace->split(m_random, &m_traceMemory);
+                    newTraces.push_back(pTrace1);
+                    newTraces.push_back(pTrace2);
+                }
+                continue;
+            }
+            *itKept++ = std::move(pTrace);
+        }
+        m_vpTraces.erase(itKept, m_vpTraces.end());
+    });
+
     for (auto pTrace : newTraces)
     {
-        //std::cout << "NEW " << *pTrace << std::endl;
         m_vpTraces.push_back(pTrace);
     }
 
-    if (m_vpTraces.size() == 0)
+    // traces over the cap go when there is time for it, unless there are far too many
+    std::size_t const hardCap = m_populationController.hardCap();
+    if (m_vpTraces.size() > overshootLimit(hardCap))
     {
-        genTraces(20);
+        removeOldestTraces(m_vpTraces.size() - hardCap);
+    }
+    else if (m_vpTraces.size() > hardCap && !m_cullQueued)
+    {
+        m_cullQueued = true;
+        m_maintenance.post([this] { return cullSlice(); });
     }
 
+    m_simulationTime += m_options.stepPeriod;
 
-    if (m_pBulkRenderer)
+    auto stepTime = m_stepTracesTime + (std::chrono::steady_clock::now() - startTime);
+    m_lastStepTime = stepTime;
+    m_populationController.measure(steppedSegments, stepTime, m_lastDrawTime);
+    m_populationController.update(m_vpTraces.size());
+    // the controller asks anew every step, a refill in progress spawns what it asks for now
+    m_pendingSpawns = m_populationController.spawnCount();
+    if (m_pendingSpawns > 0 && !m_spawnQueued)
+    {
+        m_spawnQueued = true;
+        m_maintenance.post([this] { return spawnSlice(); });
+    }
+    // in the time left of the scenario's share of the frame, the last draw counted in
+    auto const frameBudget = std::chrono::duration_cast<std::chrono::nanoseconds>(m_options.stepPeriod * m_options.frameBudgetFraction);
+    m_maintenance.runUntil(std::chrono::steady_clock::now() + (frameBudget - stepTime - m_lastDrawTime));
+
+    // the next step bends the traces towards or away from where the tips are now
+    if (m_options.attraction != 0.0f)
+    {
+        std::pmr::vector<glm::vec2> tips{&m_stepArena};
+        tips.reserve(m_vpTraces.size());
+        for (auto const& pTrace : m_vpTraces) tips.push_back(pTrace->position_);
+        glm::vec2 const lower{m_windowBoundariesMonometric.topLeft.x, m_windowBoundariesMonometric.bottomRight.y};
+        glm::vec2 const upper{m_windowBoundariesMonometric.bottomRight.x, m_windowBoundariesMonometric.topLeft.y};
+        m_attractionTree.build(tips.data(), tips.size(), lower, upper);
+    }
+
+    for (auto const& pTrace : m_vpTraces)
+    {
+        emitSegment(*pTrace, false);
+    }
+    if (m_pSegmentRecorder) m_pSegmentRecorder->endFrame();
+}
+
+bool Scenario::spawnSlice()
+{
+    std::size_t const count = std::min(m_pendingSpawns, kSpawnSlice);
+    genTraces(static_cast<int>(count));
+    m_pendingSpawns -= count;
+    m_spawnQueued = m_pendingSpawns > 0;
+    return m_spawnQueued;
+}
+
+bool Scenario::cullSlice()
+{
+    std::size_t const hardCap = m_populationController.hardCap();
+    if (m_vpTraces.size() > hardCap) removeOldestTraces(std::min(m_vpTraces.size() - hardCap, kCullSlice));
+    m_cullQueued = m_vpTraces.size() > hardCap;
+    return m_cullQueued;
+}
+
+void Scenario::addSegment(glm::vec2 const& from, glm::vec2 const& to)
+{
+    if (!m_renderCullBox || !outside(m_renderCullBox.value(), glm::min(from, to), glm::max(from, to)))
+    {
+        m_pBulkRenderer->addSegment(from, to);
+    }
+    if (m_pSegmentRecorder) m_pSegmentRecorder->addSegment(from, to);
+}
+
+void Scenario::addPoint(glm::vec2 const& point)
+{
+    if (!m_renderCullBox || !outside(m_renderCullBox.value(), point, point)) m_pBulkRenderer->addPoint(point);
+    if (m_pSegmentRecorder) m_pSegmentRecorder->addPoint(point);
+}
+
+void Scenario::emitSegment(Trace& trace, bool dying)
+{
+    if (!m_pBulkRenderer) return;
+    if (m_minSegmentLengthMonometric <= 0.0f)
+    {
+        if (!dying) addSegment(trace.prevPosition_, trace.position_);
+        return;
+    }
+    if (trace.hasSegmentLongerThan(m_minSegmentLengthMonometric))
+    {
+        addSegment(trace.segmentStart_, trace.position_);
+        trace.markSegmentEmitted();
+        return;
+    }
+    // a trace that dies before its motion ever reaches a pixel still leaves a dot behind
+    if (dying && trace.segmentStart_ != trace.position_)
+    {
+        addPoint(trace.position_);
+    }
+}
+
+void Scenario::interactTraces()
+{
+    bool const avoid = m_avoidanceRadiusMonometric > 0.0f && m_options.avoidanceWeight > 0.0f;
+    bool const collide = m_options.collision != Collision::None;
+    if (!avoid && !collide) return;
+
+    std::pmr::vector<Trace*> live{&m_stepArena};
+    std::pmr::vector<glm::vec2> midpoints{&m_stepArena};
+    live.reserve(m_vpTraces.size());
+    midpoints.reserve(m_vpTraces.size());
+    float maxSquaredLength{0.0f};
+    for (auto const& pTrace : m_vpTraces)
+    {
+        if (pTrace->killed_) continue;
+        glm::vec2 segment = pTrace->position_ - pTrace->prevPosition_;
+        maxSquaredLength = std::max(maxSquaredLength, segment.x * segment.x + segment.y * segment.y);
+        live.push_back(pTrace.get());
+        midpoints.push_back(0.5f * (pTrace->prevPosition_ + pTrace->position_));
+    }
+    if (live.empty()) return;
+
+    // Midpoints of crossing segments are at most the longest segment apart, so cells that size put
+    // both in neighbouring cells. Smaller cells mean fewer candidates but more empty cells to sort
+    // and visit, kCellsPerTrace balances the two.
+    glm::vec2 const lower{m_windowBoundariesMonometric.topLeft.x, m_windowBoundariesMonometric.bottomRight.y};
+    glm::vec2 const upper{m_windowBoundariesMonometric.bottomRight.x, m_windowBoundariesMonometric.topLeft.y};
+    glm::vec2 const size = upper - lower;
+    float cellSize = std::max({std::sqrt(maxSquaredLength), m_avoidanceRadiusMonometric, std::sqrt(size.x * size.y / (kCellsPerTrace * live.size()))});
+    m_interactionGrid.rebuild(midpoints.data(), midpoints.size(), lower, upper, cellSize);
+
+    // copies of the segments in grid order, so that neighbour queries stay out of the scattered traces
+    struct Segment
+    {
+        glm::vec2 from;
+        glm::vec2 to;
+        glm::vec2 midpoint;
+        std::size_t id;
+    };
+    std::pmr::vector<Segment> segments{&m_stepArena};
+    segments.reserve(live.size());
+    for (std::size_t slot = 0; slot < live.size(); slot++)
+    {
+        std::uint32_t i = m_interactionGrid.item(slot);
+        Trace const& trace = *live[i];
+        segments.push_back(Segment{trace.prevPosition_, trace.position_, midpoints[i], trace.id_});
+    }
+
+    // collisions are decided on this step's segments before any trace is cut short
+    std::pmr::vector<float> crossings(live.size(), -1.0f, &m_stepArena);
+    float const radius = m_avoidanceRadiusMonometric;
+    for (std::size_t slot = 0; slot < segments.size(); slot++)
+    {
+        Segment const segment = segments[slot];
+        glm::vec2 repulsion{0.0f, 0.0f};
+        float crossing{-1.0f};
+        m_interactionGrid.forEachNear(segment.midpoint, [&](std::size_t otherSlot)
+        {
+            Segment const& other = segments[otherSlot];
+            if (collide)
+            {
+                float t = crossingFraction(segment.from, segment.to, other.from, other.to);
+                bool older = other.id < segment.id;
+                if (older & (t >= 0.0f) & ((crossing < 0.0f) | (t < crossing))) crossing = t;
+            }
+            // the trace itself is at distance 0
+            if (avoid)
+            {
+                glm::vec2 away = segment.midpoint - other.midpoint;
+                float squaredDistance = away.x * away.x + away.y * away.y;
+                if (squaredDistance <= 0.0f || squaredDistance >= radius * radius) return;
+                float distance = std::sqrt(squaredDistance);
+                repulsion += away * ((1.0f - distance / radius) / distance);
+            }
+        });
+        crossings[slot] = crossing;
+        if (avoid)
+        {
+            Trace& trace = *live[m_interactionGrid.item(slot)];
+            trace.direction_ = trace.steeredDirection(repulsion, m_options.avoidanceWeight);
+        }
+    }
+
+    if (!collide) return;
+    for (std::size_t slot = 0; slot < crossings.size(); slot++)
+    {
+        if (crossings[slot] < 0.0f) continue;
+        Trace& trace = *live[m_interactionGrid.item(slot)];
+        if (m_options.collision == Collision::Merge)
+        {
+            // drawn up to the crossing, so that it visibly runs into the other trace
+            trace.position_ = trace.prevPosition_ + crossings[slot] * (trace.position_ - trace.prevPosition_);
+            if (m_pBulkRenderer) addSegment(m_minSegmentLengthMonometric > 0.0f ? trace.segmentStart_ : trace.prevPosition_, trace.position_);
+            trace.markSegmentEmitted();
+        }
+        trace.kill();
+    }
+}
+
+Error Scenario::startRecording(std::string const& path, bool compress)
+{
+    auto header = SegmentRecorder::makeHeader(m_windowHeightOverWidth, m_options.color,
+                                              static_cast<std::uint32_t>(m_options.stepPeriod.count()), compress);
+    auto [pRecorder, err] = SegmentRecorder::make(path, header, kMaxQueuedRecordingBytes);
+    if (err != nil) return makeError("could not start recording:", err.value());
+    std::lock_guard<std::mutex> lock{m_recordingMutex};
+    m_pSegmentRecorder = pRecorder;
+    return nil;
+}
+
+std::pair<std::size_t, Error> Scenario::stopRecording()
+{
+    std::shared_ptr<SegmentRecorder> pRecorder;
+    {
+        std::lock_guard<std::mutex> lock{m_recordingMutex};
+        pRecorder = std::move(m_pSegmentRecorder);
+    }
+    if (!pRecorder) return std::make_pair(std::size_t{0}, makeError("could not stop recording: nothing is being recorded"));
+    Error err = pRecorder->finish();
+    std::size_t droppedFrames = pRecorder->droppedFrames();
+    if (err != nil) return std::make_pair(droppedFrames, makeError("could not stop recording:", err.value()));
+    return std::make_pair(droppedFrames, nil);
+}
+
+Error Scenario::setFrameSink(std::shared_ptr<FrameSink> pSink)
+{
+    if (m_pSetup) return makeError("could not set frame sink: scenario is not set up yet");
+    if (!m_pDoubleFramebuffer) return makeError("could not set frame sink: scenario draws no frames of its own");
+    m_pFrameReadback.reset();
+    if (!pSink) return nil;
+    auto [pReadback, err] = FrameReadback::make(m_pDoubleFramebuffer->screenSize, pSink);
+    if (err != nil) return makeError("could not set frame sink:", err.value());
+    m_pFrameReadback = pReadback;
+    return nil;
+}
+
+std::pair<std::shared_ptr<Scenario>, Error> Scenario::makeReplay(std::string const& recordingPath, glm::ivec2 const& windowSize, Options options, float speed)
+{
+    auto [pReplay, err] = SegmentReplay::open(recordingPath);
+    if (err != nil)
+    {
+        return std::make_pair(nullptr, makeError("could not make replay scenario:", err.value()));
+    }
+    auto const& header = pReplay->header();
+    options.color = glm::vec3{header.color[0], header.color[1], header.color[2]};
+    std::shared_ptr<Scenario> pScenario;
+    std::tie(pScenario, err) = make(0, windowSize, options);
+    if (err != nil)
+    {
+        return std::make_pair(nullptr, makeError("could not make replay scenario:", err.value()));
+    }
+    pScenario->m_pSegmentReplay = pReplay;
+    pScenario->m_replaySpeed = speed;
+    return std::make_pair(pScenario, nil);
+}
+
+void Scenario::setAdaptiveQuality(bool enabled)
+{
+    m_options.adaptiveQuality = enabled;
+    if (!m_pDoubleFramebuffer) return;
+    if (enabled == m_qualityGovernor.has_value()) return;
+    if (!enabled)
+    {
+        applyQualityLevel(QualityGovernor::kLevels.front());
+        m_qualityGovernor.reset();
+        m_pGpuTimer.reset();
+        return;
+    }
+
+    m_fullQualityBlur = m_pDoubleFramebuffer->blurStandardDeviationOnBlitAndSwap();
+    // without timestamp queries the governor goes by the CPU time alone
+    m_pGpuTimer = GpuTimer::make().first;
+    m_qualityGovernor = QualityGovernor{std::chrono::duration_cast<std::chrono::nanoseconds>(m_options.stepPeriod * m_options.frameBudgetFraction)};
+}
+
+void Scenario::setObstacleMask(std::shared_ptr<ObstacleMask const> pMask, ObstacleResponse response)
+{
+    m_options.pObstacleMask = pMask;
+    m_options.obstacleResponse = response;
+    if (m_pTraceFactory) m_pTraceFactory->setSpawnMask(std::move(pMask));
+}
+
+void Scenario::applyQualityLevel(QualityGovernor::Level const& level)
+{
+    glm::vec2 renderSize = glm::round(glm::vec2{m_pDoubleFramebuffer->screenSize} * level.resolutionScale);
+    m_pDoubleFramebuffer->requestRenderSize(glm::ivec2{renderSize});
+    m_pDoubleFramebuffer->setBlurStandardDeviationOnBlitAndSwap(level.blur ? m_fullQualityBlur : 0.0f);
+    // widths are in pixels of the render targets, which cover more of the screen each at lower resolutions
+    if (m_pBulkRenderer) m_pBulkRenderer->setLineWidth(m_options.lineWidth * level.resolutionScale * level.lineWidthScale);
+}
+
+void Scenario::removeOldestTraces(std::size_t count)
+{
+    count = std::min(count, m_vpTraces.size());
+    if (count == 0) return;
+    auto itSplit = m_vpTraces.begin() + count;
+    std::nth_element(m_vpTraces.begin(), itSplit - 1, m_vpTraces.end(),
+                     [](std::shared_ptr<Trace> const& pLhs, std::shared_ptr<Trace> const& pRhs)
+    {
+        return pLhs->creationTime_ < pRhs->creationTime_;
+    });
+    m_vpTraces.erase(m_vpTraces.begin(), itSplit);
+}
+
+void Scenario::stepAll(std::vector<Scenario*> vpScenarios)
+{
+    stepAll(vpScenarios.data(), vpScenarios.size());
+}
+
+void Scenario::stepAll(Scenario* const* ppScenarios, std::size_t count)
+{
+    struct Chunk
+    {
+        Scenario* pScenario;
+        std::size_t begin;
+        std::size_t end;
+    };
+
+    // the task lists of every call live here, reset at the start of the next
+    thread_local FrameArena arena;
+    arena.reset();
+    std::pmr::vector<Scenario*> vpScenarios{ppScenarios, ppScenarios + count, &arena};
+    vpScenarios.erase(std::remove(vpScenarios.begin(), vpScenarios.end(), nullptr), vpScenarios.end());
+    std::sort(vpScenarios.begin(), vpScenarios.end(), std::less<Scenario*>{});
+    vpScenarios.erase(std::unique(vpScenarios.begin(), vpScenarios.end()), vpScenarios.end());
+
+    std::pmr::vector<Chunk> chunks{&arena};
+    for (auto pScenario : vpScenarios)
     {
-        for (auto pTrace : m_vpTraces)
+        pScenario->addStepRandom();
+        std::size_t traceCount = pScenario->m_vpTraces.size();
+        for (std::size_t begin = 0; begin < traceCount; begin += kTracesPerStepChunk)
         {
-            m_pBulkRenderer->add(pTrace);
+            chunks.push_back(Chunk{pScenario, begin, std::min(traceCount, begin + kTracesPerStepChunk)});
         }
-        m_pBulkRenderer->bufferData();
     }
+
+    auto startTime = std::chrono::steady_clock::now();
+    auto& pool = ThreadPool::instance();
+    pool.run(chunks.size(), [](void* pContext, std::size_t index)
+    {
+        Chunk const& chunk = static_cast<Chunk const*>(pContext)[index];
+        chunk.pScenario->stepTraces(chunk.begin, chunk.end);
+    }, chunks.data());
+
+    // attribute the time the chunks took to the scenarios in proportion to the traces they stepped
+    auto stepTime = std::chrono::steady_clock::now() - startTime;
+    std::size_t totalTraces{0};
+    for (auto pScenario : vpScenarios) totalTraces += pScenario->m_vpTraces.size();
+    for (auto pScenario : vpScenarios)
+    {
+        pScenario->m_stepTracesTime = totalTraces == 0
+                ? std::chrono::nanoseconds{0}
+                : std::chrono::duration_cast<std::chrono::nanoseconds>(stepTime * pScenario->m_vpTraces.size() / totalTraces);
+    }
+    pool.run(vpScenarios.size(), [](void* pContext, std::size_t index)
+    {
+        static_cast<Scenario* const*>(pContext)[index]->finishStep();
+    }, vpScenarios.data());
 }
 
 void Scenario::draw()
 {
+    Scenario* pThis = this;
+    drawAll(&pThis, 1);
+}
+
+void Scenario::drawTo(GLuint framebuffer, glm::ivec4 const& viewport)
+{
+    if (m_pSetup || !m_pDoubleFramebuffer)
+    {
+        draw();
+        return;
+    }
+    auto previousFramebuffer = m_pDoubleFramebuffer->outputFramebuffer;
+    auto previousViewport = m_pDoubleFramebuffer->outputViewport;
+    m_pDoubleFramebuffer->outputFramebuffer = framebuffer;
+    m_pDoubleFramebuffer->outputViewport = viewport;
+    draw();
+    m_pDoubleFramebuffer->outputFramebuffer = previousFramebuffer;
+    m_pDoubleFramebuffer->outputViewport = previousViewport;
+}
+
+Error Scenario::drawToTexture(GLuint texture)
+{
+    if (m_pSetup)
+    {
+        draw();
+        return nil;
+    }
+    if (!m_pDoubleFramebuffer) return makeError("cannot draw to", texture, ": scenario draws no frames of its own");
+    if (!glIsTexture(texture)) return makeError("cannot draw to", texture, ": not a texture");
+    if (!m_pTextureFramebuffer)
+    {
+        GLuint framebuffer{InvalidId};
+        glCreateFramebuffers(1, &framebuffer);
+        m_pTextureFramebuffer.reset(new GLuint(framebuffer), [](GLuint const* pFramebuffer)
+        {
+            glDeleteFramebuffers(1, pFramebuffer);
+            delete pFramebuffer;
+        });
+    }
+    // attached on every call, the host may have deleted the texture and reused its name
+    glNamedFramebufferTexture(*m_pTextureFramebuffer, GL_COLOR_ATTACHMENT0, texture, 0);
+    if (texture != m_framebufferTexture)
+    {
+        auto status = glCheckNamedFramebufferStatus(*m_pTextureFramebuffer, GL_DRAW_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            m_framebufferTexture = InvalidId;
+            return makeError("texture", texture, "cannot be drawn to, framebuffer status:", status);
+        }
+        m_framebufferTexture = texture;
+    }
+
+    GLint width{0};
+    GLint height{0};
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &height);
+    drawTo(*m_pTextureFramebuffer, glm::ivec4{0, 0, width, height});
+    return nil;
+}
+
+void Scenario::drawAll(std::vector<Scenario*> vpScenarios)
+{
+    drawAll(vpScenarios.data(), vpScenarios.size());
+}
+
+void Scenario::drawAll(Scenario* const* ppScenarios, std::size_t count)
+{
+    // the temporaries of every draw live here, drawing is confined to the thread owning the GL context
+    thread_local FrameArena arena;
+    arena.reset();
+    std::pmr::vector<Scenario*> vpScenarios{ppScenarios, ppScenarios + count, &arena};
+    vpScenarios.erase(std::remove(vpScenarios.begin(), vpScenarios.end(), nullptr), vpScenarios.end());
+    // scenarios still being set up only move their setup on
+    vpScenarios.erase(std::remove_if(vpScenarios.begin(), vpScenarios.end(), [](Scenario* pScenario)
+    {
+        return !pScenario->advanceSetup().first || !pScenario->m_pDoubleFramebuffer;
+    }), vpScenarios.end());
+    if (vpScenarios.empty()) return;
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (auto pScenario : vpScenarios)
+    {
+        auto err = pScenario->m_pDoubleFramebuffer->applyRenderSize();
+        if (err != nil) std::cerr << "could not change render resolution: " << err.value() << std::endl;
+    }
+
+    // group scenarios sharing programs so that each program is bound once per pass
+    auto traceProgram = [](Scenario const* pScenario)
+    {
+        return pScenario->m_pBulkRenderer ? pScenario->m_pBulkRenderer->program() : InvalidId;
+    };
+    std::sort(vpScenarios.begin(), vpScenarios.end(), [&traceProgram](Scenario const* pLhs, Scenario const* pRhs)
+    {
+        GLuint lhsProgram = traceProgram(pLhs);
+        GLuint rhsProgram = traceProgram(pRhs);
+        if (lhsProgram != rhsProgram) return lhsProgram < rhsProgram;
+        return std::less<Scenario const*>{}(pLhs, pRhs);
+    });
+    vpScenarios.erase(std::unique(vpScenarios.begin(), vpScenarios.end()), vpScenarios.end());
+
+    // the quad passes draw with different program variants, each pass groups the scenarios by its own
+    auto forEachQuadProgramGroup = [&vpScenarios](auto&& quadProgram, auto&& fn)
+    {
+        std::pmr::vector<std::pair<GLuint, Scenario*>> group{&arena};
+        group.reserve(vpScenarios.size());
+        for (auto pScenario : vpScenarios) group.emplace_back(quadProgram(pScenario), pScenario);
+        std::sort(group.begin(), group.end(), [](auto const& lhs, auto const& rhs)
+        {
+            if (lhs.first != rhs.first) return lhs.first < rhs.first;
+            return std::less<Scenario*>{}(lhs.second, rhs.second);
+        });
+
+        DoubleFramebuffer* pBound{nullptr};
+        GLuint boundProgram{InvalidId};
+        for (auto [program, pScenario] : group)
+        {
+            auto pDoubleFramebuffer = pScenario->m_pDoubleFramebuffer.get();
+            if (!pBound || boundProgram != program)
+            {
+                if (pBound) pBound->unuseQuadProgram(boundProgram);
+                pDoubleFramebuffer->useQuadProgram(program);
+                pBound = pDoubleFramebuffer;
+                boundProgram = program;
+            }
+            fn(pScenario, program);
+        }
+        if (pBound) pBound->unuseQuadProgram(boundProgram);
+    };
+
     glClearColor(0, 0, 0, 1.0);
-    glClear(GL_COLOR_BUFFER_BIT);
+    forEachQuadProgramGroup([](Scenario* pScenario) { return *pScenario->m_pDoubleFramebuffer->pFeedbackProgram; },
+                            [](Scenario* pScenario, GLuint program)
+    {
+        if (pScenario->m_pGpuTimer) pScenario->m_pGpuTimer->beginInterval();
+        pScenario->m_pDoubleFramebuffer->bindFramebuffer();
+        glClear(GL_COLOR_BUFFER_BIT);
+        pScenario->m_pDoubleFramebuffer->drawPreviousFrame(program, 0.0, pScenario->m_options.fadeFactor);
+        if (pScenario->m_pGpuTimer) pScenario->m_pGpuTimer->endInterval();
+    });
 
-    m_pDoubleFramebuffer->renderPreviousFrame(0.0, 0.985);
-    if (m_pBulkRenderer)
+    BulkRenderer* pBound{nullptr};
+    for (auto pScenario : vpScenarios)
     {
-        m_pBulkRenderer->setColor(m_options.color);
-        m_pBulkRenderer->render();
+        auto pBulkRenderer = pScenario->m_pBulkRenderer.get();
+        if (!pBulkRenderer || pBulkRenderer->program() == InvalidId) continue;
+        if (!pBound || pBound->program() != pBulkRenderer->program())
+        {
+            if (pBound) pBound->unuse();
+            pBulkRenderer->use();
+            pBound = pBulkRenderer;
+        }
+        if (pScenario->m_pGpuTimer) pScenario->m_pGpuTimer->beginInterval();
+        pScenario->m_pDoubleFramebuffer->bindFramebuffer();
+        pBulkRenderer->bufferData();
+        pBulkRenderer->setColor(pScenario->m_options.color);
+        pBulkRenderer->setSecondaryColor(pScenario->m_options.secondaryColor);
+        pBulkRenderer->draw();
+        if (pScenario->m_pGpuTimer) pScenario->m_pGpuTimer->endInterval();
+    }
+    if (pBound) pBound->unuse();
+
+    forEachQuadProgramGroup([](Scenario* pScenario)
+    {
+        auto [pProgram, err] = pScenario->m_pDoubleFramebuffer->presentProgram();
+        if (err != nil) std::cerr << "could not present frame: " << err.value() << std::endl;
+        return pProgram ? *pProgram : InvalidId;
+    },
+                            [](Scenario* pScenario, GLuint program)
+    {
+        if (pScenario->m_pGpuTimer) pScenario->m_pGpuTimer->beginInterval();
+        pScenario->m_pDoubleFramebuffer->drawToScreen(program);
+        if (pScenario->m_pGpuTimer) pScenario->m_pGpuTimer->endInterval();
+    });
+
+    for (auto pScenario : vpScenarios)
+    {
+        if (!pScenario->m_pFrameReadback) continue;
+        auto err = captureFrame(*pScenario->m_pFrameReadback, pScenario->m_pDoubleFramebuffer->lastFrame());
+        if (err != nil)
+        {
+            std::cerr << "stopped frame output: " << err.value() << std::endl;
+            pScenario->m_pFrameReadback.reset();
+        }
     }
 
-    m_pDoubleFramebuffer->blitAndSwap();
+    for (auto pScenario : vpScenarios) pScenario->m_pDoubleFramebuffer->bindFramebuffer();
+
+    // attribute the submission time to the scenarios in proportion to the segments they drew
+    auto drawTime = std::chrono::steady_clock::now() - startTime;
+    std::size_t totalSegments{0};
+    for (auto pScenario : vpScenarios) totalSegments += pScenario->m_vpTraces.size();
+    for (auto pScenario : vpScenarios)
+    {
+        pScenario->m_lastDrawTime = totalSegments == 0
+                ? std::chrono::nanoseconds{0}
+                : std::chrono::duration_cast<std::chrono::nanoseconds>(drawTime * pScenario->m_vpTraces.size() / totalSegments);
+    }
+
+    for (auto pScenario : vpScenarios)
+    {
+        if (!pScenario->m_qualityGovernor) continue;
+        std::optional<std::chrono::nanoseconds> gpuTime;
+        if (pScenario->m_pGpuTimer)
+        {
+            pScenario->m_pGpuTimer->endFrame();
+            gpuTime = pScenario->m_pGpuTimer->poll();
+        }
+        if (pScenario->m_qualityGovernor->update(pScenario->m_lastStepTime + pScenario->m_lastDrawTime, gpuTime))
+        {
+            pScenario->applyQualityLevel(pScenario->m_qualityGovernor->level());
+        }
+    }
 }
@@ -1,20 +1,88 @@
 #pragma once
 
+#include "BarnesHutTree.h"
 #include "BoundingBox.h"
 #include "Error.h"
+#include "FrameArena.h"
+#include "MaintenanceScheduler.h"
+#include "PopulationController.h"
+#include "QualityGovernor.h"
+#include "RandomSource.h"
+#include "ShaderSources.h"
+#include "UniformGrid.h"
+#include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <chrono>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <string>
 #include <utility>
 #include <vector>
 
 struct BulkRenderer;
 struct DoubleFramebuffer;
+struct FlowField;
+struct FrameReadback;
+struct FrameSink;
+struct GpuTimer;
+struct ObstacleMask;
+struct ScenarioSetup;
+struct SegmentRecorder;
+struct SegmentReplay;
 struct Trace;
 struct TraceFactory;
 
 struct Scenario
 {
+    enum class FadeMode
+    {
+        // trails keep a fadeFactor share of their brightness every step
+        Multiply,
+        // trails lose 1 - fadeFactor of full brightness every step and end at black
+        ToBlack,
+    };
+
+    enum class ColorMode
+    {
+        Solid,
+        // color at the bottom of the window, secondaryColor at the top
+        VerticalGradient,
+    };
+
+    // what happens to traces reaching the edge of the window, see StepPolicies.h
+    enum class Boundary
+    {
+        Kill,
+        Wrap,
+        Reflect,
+    };
+
+    enum class Lifetime
+    {
+        Mortal,
+        // traces only die at a Kill boundary, the population controller keeps spawning up to its target
+        Immortal,
+    };
+
+    // what happens to a trace whose latest segment crosses the latest segment of an older trace
+    enum class Collision
+    {
+        None,
+        Kill,
+        // the younger trace ends at the crossing, joining the older one
+        Merge,
+    };
+
+    // what happens to a trace stepping where the obstacle mask does not allow
+    enum class ObstacleResponse
+    {
+        Kill,
+        // the trace steps back and turns away, mirrored off the obstacle's edge
+        Deflect,
+    };
+
     struct Options
     {
         std::size_t maxTraces{200};
@@ -22,22 +90,120 @@ struct Scenario
         std::chrono::milliseconds stepPeriod{16};
         float traceBlurStandardDeviation{0.0015};
         glm::vec3 color{1.0, 0.0, 1.0};
+        glm::vec3 secondaryColor{0.0, 1.0, 1.0};
+        ColorMode colorMode{ColorMode::Solid};
+        float fadeFactor{0.985f};
+        FadeMode fadeMode{FadeMode::Multiply};
+        // share of stepPeriod the population controller lets this scenario spend stepping and drawing
+        float frameBudgetFraction{0.5f};
+        // segments shorter than this many pixels are accumulated until they grow past it, 0 disables
+        float minSegmentPixels{0.0f};
+        Boundary boundary{Boundary::Kill};
+        Lifetime lifetime{Lifetime::Mortal};
+        // traces steer along the field, pulled towards it by flowWeight from 0 (random walk) to 1;
+        // the field is shared, so it can be changed between steps
+        std::shared_ptr<FlowField> pFlowField;
+        float flowWeight{0.5f};
+        Collision collision{Collision::None};
+        // traces turn away from traces nearer than this many pixels, by avoidanceWeight (0 to 1); 0 disables
+        float avoidancePixels{0.0f};
+        float avoidanceWeight{0.5f};
+        // traces bend towards the other traces' tips, or away from them when negative, as if pulled by
+        // gravity; about 1 turns a trace fully towards a crowd half the window height away. 0 disables.
+        float attraction{0.0f};
+        // Barnes-Hut opening angle: tree nodes that look smaller than this from a trace pull as one,
+        // larger is faster and coarser
+        float attractionOpeningAngle{0.8f};
+        // region traces live in, stretched over the window; traces only spawn where it allows.
+        // Change it with setObstacleMask() so that spawning follows.
+        std::shared_ptr<ObstacleMask const> pObstacleMask;
+        ObstacleResponse obstacleResponse{ObstacleResponse::Kill};
+        // width of the traces in pixels at full quality
+        float lineWidth{1.0f};
+        // smooths the edges of the traces
+        bool lineAntialiasing{false};
+        // lets a QualityGovernor trade render resolution, blur and line width for frame time
+        bool adaptiveQuality{false};
+        // draw only into the scenario's own framebuffers, for contexts without a default framebuffer
+        bool offscreen{false};
+        // false leaves drawing to whoever takes the segments from m_pBulkRenderer, e.g. a VideoWall:
+        // the scenario makes no framebuffers and draw() only moves an asynchronous setup on
+        bool ownFramebuffers{true};
     };
 
     static std::pair<std::shared_ptr<Scenario>, Error> make(std::size_t initialTraceCount, glm::ivec2 const& windowSize);
-
     static std::pair<std::shared_ptr<Scenario>, Error> make(std::size_t initialTraceCount, glm::ivec2 const& windowSize, std::shared_ptr<Options> pOptions);
     static std::pair<std::shared_ptr<Scenario>, Error> make(std::size_t initialTraceCount, glm::ivec2 const& windowSize, Options options);
 
+    // Returns at once with a scenario whose programs compile on the driver's threads where
+    // GL_KHR_parallel_shader_compile allows and whose initial traces are generated on a worker thread.
+    // It neither steps nor draws until advanceSetup() has finished it. Needs the GL context.
+    static std::pair<std::shared_ptr<Scenario>, Error> makeAsync(std::size_t initialTraceCount, glm::ivec2 const& windowSize, Options options);
+    // Moves an asynchronous setup on without blocking, true once the scenario is ready. Needs the GL context.
+    std::pair<bool, Error> advanceSetup();
+    bool ready() const;
+
+    // Scenario with the traces, clock and random state restored from a snapshot written by save().
+    static std::pair<std::shared_ptr<Scenario>, Error> load(std::string const& snapshotPath, glm::ivec2 const& windowSize, Options options);
+    Error save(std::string const& snapshotPath, bool includeFeedbackTexture) const;
+
+    // Records the segments emitted by every step to path, see SegmentRecording.h.
+    Error startRecording(std::string const& path, bool compress);
+    // Finishes the recording, returning the frames dropped because the writer could not keep up and
+    // an error when it could not be written completely or nothing was being recorded. Safe while
+    // another thread steps the scenario.
+    std::pair<std::size_t, Error> stopRecording();
+    // Scenario drawing a recording instead of simulating, advancing speed recorded frames per step.
+    static std::pair<std::shared_ptr<Scenario>, Error> makeReplay(std::string const& recordingPath, glm::ivec2 const& windowSize, Options options, float speed);
+
+    // Reads every drawn frame back asynchronously and hands it to pSink, nullptr stops. Needs the GL context.
+    Error setFrameSink(std::shared_ptr<FrameSink> pSink);
+
+    // Starts or stops the QualityGovernor, stopping returns to full quality. Needs the GL context.
+    void setAdaptiveQuality(bool enabled);
+    void applyQualityLevel(QualityGovernor::Level const& level);
+
+    // Options::pObstacleMask and obstacleResponse, with new traces spawning where the mask allows;
+    // nullptr removes the mask. Not while makeAsync() is generating the initial traces.
+    void setObstacleMask(std::shared_ptr<ObstacleMask const> pMask, ObstacleResponse response);
+
+    // trace factory, renderers and framebuffers, with the shared programs when none are given
+    Error setupRenderers(glm::ivec2 const& windowSize, std::shared_ptr<const GLuint> pTraceProgram, std::shared_ptr<const GLuint> pFeedbackProgram);
+    // shader variants the options require, see ShaderSources.h
+    ShaderFeatures traceShaderFeatures() const;
+    ShaderFeatures feedbackShaderFeatures() const;
 
     void genTraces(int count);
+    void removeOldestTraces(std::size_t count);
+    // continuations of the deferred refill and cut down to the cap, see m_maintenance
+    bool spawnSlice();
+    bool cullSlice();
+    void emitSegment(Trace& trace, bool dying);
+    void addSegment(glm::vec2 const& from, glm::vec2 const& to);
+    void addPoint(glm::vec2 const& point);
+    // collisions and avoidance between the traces that just stepped, see Options::collision
+    void interactTraces();
 
     Options m_options;
+    // every trace is allocated here, so that traces dying and being born reuse each other's memory;
+    // declared before everything holding traces so that it outlives them
+    std::pmr::unsynchronized_pool_resource m_traceMemory;
+    // memory of one step's temporaries, reset at the start of each
+    FrameArena m_stepArena;
     std::vector<std::shared_ptr<Trace>> m_vpTraces;
     std::shared_ptr<TraceFactory> m_pTraceFactory;
     std::shared_ptr<BulkRenderer> m_pBulkRenderer;
+    // when set, segments and points wholly outside it (in monometric coordinates) are not added to
+    // m_pBulkRenderer, e.g. for a TiledCanvas drawing only the tiles in view; recordings get them all
+    std::optional<BoundingBox> m_renderCullBox;
     std::shared_ptr<DoubleFramebuffer> m_pDoubleFramebuffer;
     float m_windowHeightOverWidth;
+    float m_minSegmentLengthMonometric{0.0f};
+    float m_avoidanceRadiusMonometric{0.0f};
+    // segment midpoints of the live traces, rebuilt by every interactTraces()
+    UniformGrid m_interactionGrid;
+    // trace tips at the end of the last step, when attraction is on
+    BarnesHutTree m_attractionTree;
     struct WindowBoundaries : public BoundingBox
     {
         WindowBoundaries();
@@ -47,7 +213,70 @@ struct Scenario
 
     void step();
 
+    // step() in two phases: stepTraces() moves any range of traces and can run on several threads
+    // at once, finishStep() then removes dead traces, splits them and refills, on a single thread.
+    // Before stepping ranges of the traces separately, addStepRandom() has to be called once.
+    void stepTraces(std::size_t begin, std::size_t end);
+    // the traces from begin to end, all in one chunk of m_stepRandom
+    void stepChunk(std::size_t begin, std::size_t end, RandomSource& random, glm::vec2 const& lower, glm::vec2 const& upper);
+    void finishStep();
+    // a source in m_stepRandom for every kTracesPerStepChunk traces
+    void addStepRandom();
+
+    // Steps several scenarios on the library thread pool, splitting large ones into chunks.
+    static void stepAll(std::vector<Scenario*> vpScenarios);
+    static void stepAll(Scenario* const* ppScenarios, std::size_t count);
+
     void draw();
+    // draw() presenting into viewport (x, y, width, height) of framebuffer instead of the default framebuffer
+    void drawTo(GLuint framebuffer, glm::ivec4 const& viewport);
+    // draw() presenting into all of level 0 of texture, a color-renderable GL_TEXTURE_2D
+    Error drawToTexture(GLuint texture);
+
+    // Draws several scenarios, binding each shared program once per pass instead of once per scenario.
+    static void drawAll(std::vector<Scenario*> vpScenarios);
+    static void drawAll(Scenario* const* ppScenarios, std::size_t count);
     
     WindowBoundaries m_windowBoundariesMonometric;
+
+    // what spawning and splitting traces draw from
+    RandomSource m_random;
+    // what stepping draws from, one source per kTracesPerStepChunk traces, so that chunks stepped
+    // on different threads draw the same numbers as one thread stepping them all
+    std::vector<RandomSource> m_stepRandom;
+    static std::size_t const kTracesPerStepChunk;
+
+    PopulationController m_populationController;
+    // refills and cuts down to the cap, run in the time finishStep() leaves of the frame
+    MaintenanceScheduler m_maintenance;
+    // traces the population controller last asked for and the refill did not spawn yet
+    std::size_t m_pendingSpawns{0};
+    bool m_spawnQueued{false};
+    bool m_cullQueued{false};
+    // wall-clock time stepTraces() took over all the scenario's traces in the last step
+    std::chrono::nanoseconds m_stepTracesTime{};
+    // advances by stepPeriod on every step, trace lifetimes are measured against it
+    std::chrono::steady_clock::time_point m_simulationTime{std::chrono::steady_clock::now()};
+    std::chrono::nanoseconds m_lastStepTime{};
+    std::chrono::nanoseconds m_lastDrawTime{};
+
+    std::optional<QualityGovernor> m_qualityGovernor;
+    std::shared_ptr<GpuTimer> m_pGpuTimer;
+    float m_fullQualityBlur{0.0f};
+
+    std::shared_ptr<SegmentRecorder> m_pSegmentRecorder;
+    // held by finishStep() while it records and by whatever replaces m_pSegmentRecorder
+    std::mutex m_recordingMutex;
+    std::shared_ptr<SegmentReplay> m_pSegmentReplay;
+    float m_replaySpeed{1.0f};
+
+    std::shared_ptr<FrameReadback> m_pFrameReadback;
+
+    // set while makeAsync() is not finished
+    std::shared_ptr<ScenarioSetup> m_pSetup;
+
+    // wraps the texture last passed to drawToTexture()
+    std::shared_ptr<const GLuint> m_pTextureFramebuffer;
+    GLuint m_framebufferTexture{0u};
+    static constexpr std::size_t kMaxQueuedRecordingBytes{64 * 1024 * 1024};
 };
@@ -0,0 +1,74 @@
+#include "SegmentBins.h"
+#include <limits>
+
+namespace {
+
+std::uint32_t const kDropped{std::numeric_limits<std::uint32_t>::max()};
+
+} // namespace
+
+void SegmentBins::rebuild(std::vector<glm::vec2> const& vertices, std::size_t verticesPerItem, glm::vec2 const& lower, glm::vec2 const& upper,
+                          float binSize, bool dropOutside)
+{
+    std::size_t const itemCount = vertices.size() / verticesPerItem;
+    m_reach = 0.0f;
+    for (std::size_t i = 0; i < itemCount; i++)
+    {
+        glm::vec2 const& key = vertices[i * verticesPerItem];
+        for (std::size_t k = 1; k < verticesPerItem; k++)
+        {
+            glm::vec2 const& vertex = vertices[i * verticesPerItem + k];
+            m_reach = std::max({m_reach, std::abs(vertex.x - key.x), std::abs(vertex.y - key.y)});
+        }
+    }
+
+    // kept items may start up to m_reach outside lower..upper
+    glm::vec2 const grow = dropOutside ? glm::vec2{m_reach, m_reach} : glm::vec2{0.0f, 0.0f};
+    glm::vec2 const binnedLower = lower - grow;
+    glm::vec2 const binnedUpper = upper + grow;
+    m_lower = binnedLower;
+    m_binsPerUnit = 1.0f / binSize;
+    glm::vec2 const extent = (binnedUpper - binnedLower) * m_binsPerUnit;
+    m_bins = glm::ivec2{std::max(static_cast<int>(std::ceil(extent.x)), 1), std::max(static_cast<int>(std::ceil(extent.y)), 1)};
+    std::size_t const binCount = static_cast<std::size_t>(m_bins.x) * m_bins.y;
+
+    // counting sort, the items of a bin keep their order
+    m_start.assign(binCount + 1, 0u);
+    m_itemBins.resize(itemCount);
+    std::size_t keptItems{0};
+    for (std::size_t i = 0; i < itemCount; i++)
+    {
+        glm::vec2 const& key = vertices[i * verticesPerItem];
+        bool outside = (key.x < binnedLower.x) | (key.x > binnedUpper.x) | (key.y < binnedLower.y) | (key.y > binnedUpper.y);
+        if (dropOutside && outside)
+        {
+            m_itemBins[i] = kDropped;
+            continue;
+        }
+        glm::ivec2 bin = binOf(key);
+        auto index = static_cast<std::uint32_t>(bin.y * m_bins.x + bin.x);
+        m_itemBins[i] = index;
+        m_start[index] += static_cast<std::uint32_t>(verticesPerItem);
+        keptItems++;
+    }
+    std::uint32_t offset{0};
+    for (std::size_t b = 0; b < binCount; b++)
+    {
+        std::uint32_t binVertices = m_start[b];
+        m_start[b] = offset;
+        offset += binVertices;
+    }
+    m_vertices.resize(keptItems * verticesPerItem);
+    for (std::size_t i = 0; i < itemCount; i++)
+    {
+        if (m_itemBins[i] == kDropped) continue;
+        std::uint32_t& cursor = m_start[m_itemBins[i]];
+        std::copy(vertices.begin() + i * verticesPerItem, vertices.begin() + (i + 1) * verticesPerItem, m_vertices.begin() + cursor);
+        cursor += static_cast<std::uint32_t>(verticesPerItem);
+    }
+    for (std::size_t b = binCount; b > 0; b--)
+    {
+        m_start[b] = m_start[b - 1];
+    }
+    m_start[0] = 0u;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Segments or points of one step sorted into a uniform grid of bins by their first vertex, so that
+// drawing part of the scene only uploads the items near it, see VideoWall and TiledCanvas. Each bin
+// row is one contiguous run of vertices. Memory is kept between rebuilds.
+struct SegmentBins
+{
+    // Items are verticesPerItem consecutive vertices. The bins cover lower..upper; items whose first
+    // vertex lies outside fall into the nearest edge bin, or are left out with dropOutside when none
+    // of their vertices can reach into lower..upper.
+    void rebuild(std::vector<glm::vec2> const& vertices, std::size_t verticesPerItem, glm::vec2 const& lower, glm::vec2 const& upper,
+                 float binSize, bool dropOutside);
+
+    // calls fn(vertices, count) for runs of vertices holding every item within margin of lower..upper
+    template <typename Fn>
+    void forEachRunNear(glm::vec2 const& lower, glm::vec2 const& upper, float margin, Fn&& fn) const
+    {
+        glm::vec2 const grow{margin + m_reach, margin + m_reach};
+        glm::ivec2 first = binOf(lower - grow);
+        glm::ivec2 last = binOf(upper + grow);
+        for (int y = first.y; y <= last.y; y++)
+        {
+            std::size_t row = static_cast<std::size_t>(y) * m_bins.x;
+            std::uint32_t begin = m_start[row + first.x];
+            std::uint32_t end = m_start[row + last.x + 1];
+            if (end > begin) fn(m_vertices.data() + begin, static_cast<std::size_t>(end - begin));
+        }
+    }
+
+    // farthest any vertex of an item lies from its first one, per axis
+    float reach() const { return m_reach; }
+
+private:
+    glm::ivec2 binOf(glm::vec2 const& p) const
+    {
+        glm::vec2 bin = (p - m_lower) * m_binsPerUnit;
+        return glm::ivec2{std::clamp(static_cast<int>(std::floor(bin.x)), 0, m_bins.x - 1),
+                          std::clamp(static_cast<int>(std::floor(bin.y)), 0, m_bins.y - 1)};
+    }
+
+    glm::vec2 m_lower{};
+    float m_binsPerUnit{1.0f};
+    glm::ivec2 m_bins{1, 1};
+    float m_reach{0.0f};
+    // vertices of bin b are m_vertices[m_start[b]] up to m_vertices[m_start[b + 1]]
+    std::vector<std::uint32_t> m_start{0u, 0u};
+    std::vector<std::uint32_t> m_itemBins;
+    std::vector<glm::vec2> m_vertices;
+};
@@ -0,0 +1,364 @@
+#include "SegmentRecording.h"
+#include "BlockCompression.h"
+#include "BulkRenderer.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+char const kMagic[8] = {'T', 'R', 'C', 'R', 'E', 'C', '\0', '\0'};
+
+void writeVarint(std::vector<std::uint8_t>& out, std::uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back(static_cast<std::uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(v));
+}
+
+void writeZigzag(std::vector<std::uint8_t>& out, std::int64_t v)
+{
+    writeVarint(out, (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63));
+}
+
+bool readVarint(std::vector<std::uint8_t> const& in, std::size_t& cursor, std::uint64_t& v)
+{
+    v = 0;
+    for (unsigned shift = 0; shift < 64 && cursor < in.size(); shift += 7)
+    {
+        std::uint8_t byte = in[cursor++];
+        v |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+bool readZigzag(std::vector<std::uint8_t> const& in, std::size_t& cursor, std::int64_t& v)
+{
+    std::uint64_t u;
+    if (!readVarint(in, cursor, u)) return false;
+    v = static_cast<std::int64_t>(u >> 1) ^ -static_cast<std::int64_t>(u & 1);
+    return true;
+}
+
+std::int64_t quantize(float v, float scale)
+{
+    return static_cast<std::int64_t>(std::lround(v * scale));
+}
+
+} // namespace
+
+RecordingHeader SegmentRecorder::makeHeader(float windowHeightOverWidth, glm::vec3 const& color, std::uint32_t stepPeriodMs, bool compress)
+{
+    RecordingHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kRecordingVersion;
+    header.flags = compress ? kRecordingCompressed : 0;
+    header.quantizationScale = kQuantizationScale;
+    header.windowHeightOverWidth = windowHeightOverWidth;
+    header.color[0] = color.r;
+    header.color[1] = color.g;
+    header.color[2] = color.b;
+    header.stepPeriodMs = stepPeriodMs;
+    return header;
+}
+
+std::pair<std::shared_ptr<SegmentRecorder>, Error> SegmentRecorder::make(std::string const& path, RecordingHeader const& header, std::size_t maxQueuedBytes)
+{
+    std::shared_ptr<SegmentRecorder> pRecorder{new (std::nothrow) SegmentRecorder()};
+    if (!pRecorder) return std::make_pair(nullptr, makeError("could not instantiate SegmentRecorder"));
+
+    pRecorder->m_file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!pRecorder->m_file.is_open()) return std::make_pair(nullptr, makeError("could not open", path, "for recording"));
+    pRecorder->m_header = header;
+    pRecorder->m_maxQueuedBytes = maxQueuedBytes;
+    pRecorder->m_file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    if (!pRecorder->m_file) return std::make_pair(nullptr, makeError("could not write recording header to", path));
+
+    pRecorder->m_block.reserve(kBlockSize + kBlockSize / 4);
+    pRecorder->m_writer = std::thread{[p = pRecorder.get()] { p->writerLoop(); }};
+    return std::make_pair(pRecorder, nil);
+}
+
+SegmentRecorder::~SegmentRecorder()
+{
+    finish();
+}
+
+void SegmentRecorder::beginFrame()
+{
+    if (m_pCurrentFrame) return;
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (!m_freeFrames.empty())
+    {
+        m_pCurrentFrame = std::move(m_freeFrames.back());
+        m_freeFrames.pop_back();
+    }
+    else
+    {
+        m_pCurrentFrame = std::make_unique<Frame>();
+    }
+    m_pCurrentFrame->segmentVertices.clear();
+    m_pCurrentFrame->points.clear();
+}
+
+void SegmentRecorder::addSegment(glm::vec2 const& from, glm::vec2 const& to)
+{
+    if (!m_pCurrentFrame) return;
+    m_pCurrentFrame->segmentVertices.push_back(from);
+    m_pCurrentFrame->segmentVertices.push_back(to);
+}
+
+void SegmentRecorder::addPoint(glm::vec2 const& point)
+{
+    if (!m_pCurrentFrame) return;
+    m_pCurrentFrame->points.push_back(point);
+}
+
+void SegmentRecorder::endFrame()
+{
+    if (!m_pCurrentFrame) return;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        std::size_t bytes = m_pCurrentFrame->bytes();
+        if (m_queuedBytes + bytes > m_maxQueuedBytes && !m_queue.empty())
+        {
+            m_droppedFrames++;
+            m_freeFrames.push_back(std::move(m_pCurrentFrame));
+            return;
+        }
+        m_queuedBytes += bytes;
+        m_queue.push_back(std::move(m_pCurrentFrame));
+    }
+    m_frameQueued.notify_one();
+}
+
+std::size_t SegmentRecorder::droppedFrames() const
+{
+    return m_droppedFrames;
+}
+
+Error SegmentRecorder::writeError()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_writeError;
+}
+
+Error SegmentRecorder::finish()
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_stopping = true;
+    }
+    m_frameQueued.notify_one();
+    if (m_writer.joinable()) m_writer.join();
+    if (m_file.is_open())
+    {
+        m_file.close();
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (!m_file && m_writeError == nil) m_writeError = makeError("could not finish writing recording");
+    }
+    return writeError();
+}
+
+void SegmentRecorder::writerLoop()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    while (true)
+    {
+        m_frameQueued.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+        if (m_queue.empty() && m_stopping) break;
+
+        auto pFrame = std::move(m_queue.front());
+        m_queue.pop_front();
+        lock.unlock();
+
+        encode(*pFrame);
+        if (m_block.size() >= kBlockSize) flushBlock();
+
+        lock.lock();
+        m_queuedBytes -= pFrame->bytes();
+        m_freeFrames.push_back(std::move(pFrame));
+    }
+    lock.unlock();
+    flushBlock();
+    m_file.flush();
+}
+
+void SegmentRecorder::encode(Frame const& frame)
+{
+    float const scale = m_header.quantizationScale;
+    writeVarint(m_block, frame.segmentVertices.size() / 2);
+    writeVarint(m_block, frame.points.size());
+
+    std::int64_t previousX{0}, previousY{0};
+    for (std::size_t i = 0; i + 1 < frame.segmentVertices.size(); i += 2)
+    {
+        std::int64_t fromX = quantize(frame.segmentVertices[i].x, scale), fromY = quantize(frame.segmentVertices[i].y, scale);
+        std::int64_t toX = quantize(frame.segmentVertices[i + 1].x, scale), toY = quantize(frame.segmentVertices[i + 1].y, scale);
+        writeZigzag(m_block, fromX - previousX);
+        writeZigzag(m_block, fromY - previousY);
+        writeZigzag(m_block, toX - fromX);
+        writeZigzag(m_block, toY - fromY);
+        previousX = fromX;
+        previousY = fromY;
+    }
+    previousX = previousY = 0;
+    for (auto const& point : frame.points)
+    {
+        std::int64_t x = quantize(point.x, scale), y = quantize(point.y, scale);
+        writeZigzag(m_block, x - previousX);
+        writeZigzag(m_block, y - previousY);
+        previousX = x;
+        previousY = y;
+    }
+    m_blockFrameCount++;
+}
+
+void SegmentRecorder::flushBlock()
+{
+    if (m_blockFrameCount == 0) return;
+
+    RecordingBlockHeader blockHeader{m_blockFrameCount, static_cast<std::uint32_t>(m_block.size()), static_cast<std::uint32_t>(m_block.size())};
+    std::vector<std::uint8_t> const* pPayload = &m_block;
+    if (m_header.flags & kRecordingCompressed)
+    {
+        compressBlock(m_block.data(), m_block.size(), m_compressedBlock);
+        if (m_compressedBlock.size() < m_block.size())
+        {
+            blockHeader.storedSize = static_cast<std::uint32_t>(m_compressedBlock.size());
+            pPayload = &m_compressedBlock;
+        }
+    }
+    m_file.write(reinterpret_cast<char const*>(&blockHeader), sizeof(blockHeader));
+    m_file.write(reinterpret_cast<char const*>(pPayload->data()), static_cast<std::streamsize>(pPayload->size()));
+    if (!m_file)
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (m_writeError == nil) m_writeError = makeError("could not write recording block");
+    }
+    m_block.clear();
+    m_blockFrameCount = 0;
+}
+
+std::pair<std::shared_ptr<SegmentReplay>, Error> SegmentReplay::open(std::string const& path)
+{
+    std::shared_ptr<SegmentReplay> pReplay{new (std::nothrow) SegmentReplay()};
+    if (!pReplay) return std::make_pair(nullptr, makeError("could not instantiate SegmentReplay"));
+
+    pReplay->m_file.open(path, std::ios::in | std::ios::binary);
+    if (!pReplay->m_file.is_open()) return std::make_pair(nullptr, makeError("could not open recording", path));
+    pReplay->m_file.read(reinterpret_cast<char*>(&pReplay->m_header), sizeof(RecordingHeader));
+    if (!pReplay->m_file || std::memcmp(pReplay->m_header.magic, kMagic, sizeof(kMagic)) != 0)
+    {
+        return std::make_pair(nullptr, makeError(path, "is not a recording"));
+    }
+    if (pReplay->m_header.version != kRecordingVersion)
+    {
+        return std::make_pair(nullptr, makeError("recording", path, "has unsupported version", pReplay->m_header.version));
+    }
+    if (!(pReplay->m_header.quantizationScale > 0.0f))
+    {
+        return std::make_pair(nullptr, makeError("recording", path, "has an invalid quantization scale"));
+    }
+    return std::make_pair(pReplay, nil);
+}
+
+RecordingHeader const& SegmentReplay::header() const
+{
+    return m_header;
+}
+
+bool SegmentReplay::advance(BulkRenderer& bulkRenderer, float speed)
+{
+    m_pendingFrames += speed;
+    while (m_pendingFrames >= 1.0f && !m_exhausted)
+    {
+        if (m_framesLeftInBlock == 0)
+        {
+            auto err = readBlock();
+            if (err != nil)
+            {
+                m_exhausted = true;
+                break;
+            }
+        }
+        decodeFrame(bulkRenderer);
+        m_pendingFrames -= 1.0f;
+    }
+    if (m_exhausted) m_pendingFrames = 0.0f;
+    return !m_exhausted;
+}
+
+Error SegmentReplay::readBlock()
+{
+    RecordingBlockHeader blockHeader;
+    m_file.read(reinterpret_cast<char*>(&blockHeader), sizeof(blockHeader));
+    if (!m_file) return makeError("end of recording");
+    if (blockHeader.frameCount == 0 || blockHeader.storedSize > blockHeader.rawSize) return makeError("corrupted block header");
+
+    m_storedBlock.resize(blockHeader.storedSize);
+    m_file.read(reinterpret_cast<char*>(m_storedBlock.data()), blockHeader.storedSize);
+    if (!m_file) return makeError("truncated block");
+
+    if (blockHeader.storedSize == blockHeader.rawSize)
+    {
+        std::swap(m_block, m_storedBlock);
+    }
+    else
+    {
+        auto err = decompressBlock(m_storedBlock.data(), m_storedBlock.size(), m_block, blockHeader.rawSize);
+        if (err != nil) return makeError("could not decompress block:", err.value());
+    }
+    m_cursor = 0;
+    m_framesLeftInBlock = blockHeader.frameCount;
+    return nil;
+}
+
+void SegmentReplay::decodeFrame(BulkRenderer& bulkRenderer)
+{
+    m_framesLeftInBlock--;
+    float const inverseScale = 1.0f / m_header.quantizationScale;
+    std::uint64_t segmentCount, pointCount;
+    if (!readVarint(m_block, m_cursor, segmentCount) || !readVarint(m_block, m_cursor, pointCount))
+    {
+        m_framesLeftInBlock = 0;
+        return;
+    }
+
+    std::int64_t previousX{0}, previousY{0};
+    for (std::uint64_t i = 0; i < segmentCount; i++)
+    {
+        std::int64_t dFromX, dFromY, dToX, dToY;
+        if (!readZigzag(m_block, m_cursor, dFromX) || !readZigzag(m_block, m_cursor, dFromY) ||
+                !readZigzag(m_block, m_cursor, dToX) || !readZigzag(m_block, m_cursor, dToY))
+        {
+            m_framesLeftInBlock = 0;
+            return;
+        }
+        std::int64_t fromX = previousX + dFromX, fromY = previousY + dFromY;
+        bulkRenderer.addSegment(glm::vec2{fromX * inverseScale, fromY * inverseScale},
+                                glm::vec2{(fromX + dToX) * inverseScale, (fromY + dToY) * inverseScale});
+        previousX = fromX;
+        previousY = fromY;
+    }
+    previousX = previousY = 0;
+    for (std::uint64_t i = 0; i < pointCount; i++)
+    {
+        std::int64_t dX, dY;
+        if (!readZigzag(m_block, m_cursor, dX) || !readZigzag(m_block, m_cursor, dY))
+        {
+            m_framesLeftInBlock = 0;
+            return;
+        }
+        previousX += dX;
+        previousY += dY;
+        bulkRenderer.addPoint(glm::vec2{previousX * inverseScale, previousY * inverseScale});
+    }
+}
+
+std::size_t const SegmentRecorder::kBlockSize{64 * 1024};
+float const SegmentRecorder::kQuantizationScale{8192.0f};
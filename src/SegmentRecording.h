@@ -0,0 +1,130 @@
+#pragma once
+
+#include "Error.h"
+#include <glm/glm.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct BulkRenderer;
+
+// Streaming recording of the segments and points a scenario emits, one frame per step.
+//
+// File layout: RecordingHeader, then blocks of whole frames, each a RecordingBlockHeader followed by
+// its payload, LZ4-style compressed when that makes it smaller. A frame is
+//   varint segmentCount, varint pointCount,
+//   per segment: zigzag varint deltas of the start from the previous segment start, then of the end
+//                from the start,
+//   per point:   zigzag varint deltas from the previous point,
+// all coordinates quantized to 1/quantizationScale monometric units.
+struct RecordingHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t flags;
+    float quantizationScale;
+    float windowHeightOverWidth;
+    float color[3];
+    std::uint32_t stepPeriodMs;
+};
+
+struct RecordingBlockHeader
+{
+    std::uint32_t frameCount;
+    std::uint32_t rawSize;
+    std::uint32_t storedSize;
+};
+
+constexpr std::uint32_t kRecordingVersion{1};
+constexpr std::uint32_t kRecordingCompressed{1u << 0};
+
+// Frames are handed to a writer thread which quantizes, encodes, compresses and writes them.
+// The live path only copies the frame's vertices; when more than maxQueuedBytes are waiting to be
+// written the frame is dropped and counted instead of stalling the caller.
+struct SegmentRecorder
+{
+    static std::pair<std::shared_ptr<SegmentRecorder>, Error> make(std::string const& path, RecordingHeader const& header, std::size_t maxQueuedBytes);
+    ~SegmentRecorder();
+
+    void beginFrame();
+    void addSegment(glm::vec2 const& from, glm::vec2 const& to);
+    void addPoint(glm::vec2 const& point);
+    void endFrame();
+
+    std::size_t droppedFrames() const;
+    Error writeError();
+    // writes what is queued, closes the file and returns the first error writing it; no frames after
+    Error finish();
+
+    static RecordingHeader makeHeader(float windowHeightOverWidth, glm::vec3 const& color, std::uint32_t stepPeriodMs, bool compress);
+
+    static std::size_t const kBlockSize;
+    static float const kQuantizationScale;
+
+private:
+    struct Frame
+    {
+        std::vector<glm::vec2> segmentVertices;
+        std::vector<glm::vec2> points;
+        std::size_t bytes() const { return (segmentVertices.size() + points.size()) * sizeof(glm::vec2); }
+    };
+
+    void writerLoop();
+    void encode(Frame const& frame);
+    void flushBlock();
+
+    std::ofstream m_file;
+    RecordingHeader m_header;
+    std::size_t m_maxQueuedBytes;
+
+    std::unique_ptr<Frame> m_pCurrentFrame;
+    std::vector<std::unique_ptr<Frame>> m_freeFrames;
+    std::deque<std::unique_ptr<Frame>> m_queue;
+    std::size_t m_queuedBytes{0};
+    bool m_stopping{false};
+    std::mutex m_mutex;
+    std::condition_variable m_frameQueued;
+    std::atomic<std::size_t> m_droppedFrames{0};
+    Error m_writeError;
+
+    // owned by the writer thread
+    std::vector<std::uint8_t> m_block;
+    std::vector<std::uint8_t> m_compressedBlock;
+    std::uint32_t m_blockFrameCount{0};
+
+    std::thread m_writer;
+};
+
+// Plays a recording back into a BulkRenderer without running the simulation.
+struct SegmentReplay
+{
+    static std::pair<std::shared_ptr<SegmentReplay>, Error> open(std::string const& path);
+
+    // Adds the segments of the next frames to bulkRenderer. speed is in recorded frames per call,
+    // fractions carry over to the next call. Returns false once the recording is exhausted.
+    bool advance(BulkRenderer& bulkRenderer, float speed);
+
+    RecordingHeader const& header() const;
+
+private:
+    Error readBlock();
+    void decodeFrame(BulkRenderer& bulkRenderer);
+
+    std::ifstream m_file;
+    RecordingHeader m_header;
+    std::vector<std::uint8_t> m_storedBlock;
+    std::vector<std::uint8_t> m_block;
+    std::size_t m_cursor{0};
+    std::uint32_t m_framesLeftInBlock{0};
+    float m_pendingFrames{0.0f};
+    bool m_exhausted{false};
+};
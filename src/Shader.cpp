@@ -98,6 +98,11 @@ Error compileShader(GLuint id, std::string const &source)
     char const *pSource = source.data();
     glShaderSource(id, 1, &pSource, &len);
     glCompileShader(id);
+    return compileStatus(id);
+}
+
+Error compileStatus(GLuint id)
+{
     GLint ok{-1};
     glGetShaderiv(id, GL_COMPILE_STATUS, &ok);
     if (ok == GL_TRUE)
@@ -112,6 +117,20 @@ Error compileShader(GLuint id, std::string const &source)
     return makeError("could not compile shader, nor could the info log be retrieved:", err.value());
 }
 
+std::pair<std::shared_ptr<const GLuint>, Error> startShader(std::string const &source, GLenum type)
+{
+    GLuint id = glCreateShader(type);
+    if (id == InvalidId)
+    {
+        return std::make_pair(nullptr, makeError("could not glCreateShader() for shader type", type));
+    }
+    int len = static_cast<int>(source.size());
+    char const *pSource = source.data();
+    glShaderSource(id, 1, &pSource, &len);
+    glCompileShader(id);
+    return std::make_pair(makeSharedPtr(id), nil);
+}
+
 std::pair<std::string, Error> getShaderInfoLog(GLuint id)
 {
     GLint infoLogLength{-1};
@@ -11,3 +11,7 @@ std::pair<std::shared_ptr<const GLuint>, Error> loadShader(std::string const& pa
 std::tuple<std::shared_ptr<const GLuint>, std::shared_ptr<const GLuint>, Error> loadShaderPair(std::string const& directory, std::string const& name);
 std::pair<std::shared_ptr<const GLuint>, Error> makeShader(std::string const& source, GLenum type);
 std::tuple<std::shared_ptr<const GLuint>, std::shared_ptr<const GLuint>, Error> makeShaderPair(std::string const& vertexShaderSource, std::string const& fragmentShaderSource);
+
+// Submits source for compilation without waiting for the result, which compileStatus() reports.
+std::pair<std::shared_ptr<const GLuint>, Error> startShader(std::string const& source, GLenum type);
+Error compileStatus(GLuint id);
@@ -1,7 +1,41 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
+// The shaders below are templates: each ShaderFeature compiles in only when its #define is inserted,
+// see shaderDefines(), so that a variant carries neither the code nor the uniforms of unused features.
+enum ShaderFeature : std::uint32_t
+{
+    // texturedQuad: gaussian blur around every texel
+    kShaderBlur = 1u << 0,
+    // texturedQuad: multiplies by fadeFactor
+    kShaderFade = 1u << 1,
+    // texturedQuad: subtracts fadeStep, so trails reach black instead of lingering at low intensities
+    kShaderFadeToBlack = 1u << 2,
+    // trace: blends from color at the bottom of the window to secondaryColor at the top
+    kShaderColorGradient = 1u << 3,
+};
+
+// bitmask of ShaderFeature
+using ShaderFeatures = std::uint32_t;
+
+inline std::string shaderDefines(ShaderFeatures features)
+{
+    std::string defines;
+    if (features & kShaderBlur) defines += "#define BLUR\n";
+    if (features & kShaderFade) defines += "#define FADE\n";
+    if (features & kShaderFadeToBlack) defines += "#define FADE_TO_BLACK\n";
+    if (features & kShaderColorGradient) defines += "#define COLOR_GRADIENT\n";
+    return defines;
+}
+
+// key of the variant of program name built with features in getSharedProgram()
+inline std::string shaderVariantKey(char const* name, ShaderFeatures features)
+{
+    return std::string{name} + "/" + std::to_string(features);
+}
+
 inline std::string const texturedQuad_frag{
     #include "shaders/texturedQuad.frag"
 };
@@ -16,4 +50,4 @@ inline std::string const trace_frag{
 
 inline std::string const trace_vert{
     #include "shaders/trace.vert"
-};
\ No newline at end of file
+};
@@ -0,0 +1,135 @@
+#include "SharedFrameRing.h"
+
+#ifdef __linux__
+#include "ThreadPool.h"
+#include "traces_frame_ring.h"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+std::size_t const kPageSize{4096};
+
+std::size_t roundUp(std::size_t value, std::size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+std::uint64_t monotonicNanoseconds()
+{
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<std::uint64_t>(now.tv_sec) * 1'000'000'000u + static_cast<std::uint64_t>(now.tv_nsec);
+}
+
+} // namespace
+
+std::pair<std::shared_ptr<SharedFrameRing>, Error> SharedFrameRing::make(glm::ivec2 const& size, std::size_t slotCount)
+{
+    if (size.x <= 0 || size.y <= 0 || slotCount < 2)
+    {
+        return std::make_pair(nullptr, makeError("a frame ring needs a valid size and at least 2 slots"));
+    }
+    std::shared_ptr<SharedFrameRing> pRing{new (std::nothrow) SharedFrameRing()};
+    if (!pRing) return std::make_pair(nullptr, makeError("could not instantiate SharedFrameRing"));
+
+    std::size_t const stride = static_cast<std::size_t>(size.x) * 4;
+    std::size_t const firstSlotOffset = roundUp(sizeof(TracesFrameRingHeader), kPageSize);
+    std::size_t const slotSize = roundUp(sizeof(TracesFrameSlotHeader) + stride * size.y, kPageSize);
+    pRing->m_mappingSize = firstSlotOffset + slotSize * slotCount;
+
+    pRing->m_fd = memfd_create("traces-frames", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (pRing->m_fd < 0) return std::make_pair(nullptr, makeError("could not create frame ring memfd:", std::strerror(errno)));
+    if (ftruncate(pRing->m_fd, static_cast<off_t>(pRing->m_mappingSize)) != 0)
+    {
+        return std::make_pair(nullptr, makeError("could not size frame ring to", pRing->m_mappingSize, "bytes:", std::strerror(errno)));
+    }
+    // readers can rely on the size they mapped
+    fcntl(pRing->m_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+
+    pRing->m_pMapping = mmap(nullptr, pRing->m_mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, pRing->m_fd, 0);
+    if (pRing->m_pMapping == MAP_FAILED)
+    {
+        pRing->m_pMapping = nullptr;
+        return std::make_pair(nullptr, makeError("could not map frame ring:", std::strerror(errno)));
+    }
+
+    auto pHeader = static_cast<TracesFrameRingHeader*>(pRing->m_pMapping);
+    std::memcpy(pHeader->magic, TRACES_FRAME_RING_MAGIC, sizeof(TRACES_FRAME_RING_MAGIC));
+    pHeader->version = TRACES_FRAME_RING_VERSION;
+    pHeader->headerSize = sizeof(TracesFrameRingHeader);
+    pHeader->slotCount = static_cast<std::uint32_t>(slotCount);
+    pHeader->width = static_cast<std::uint32_t>(size.x);
+    pHeader->height = static_cast<std::uint32_t>(size.y);
+    pHeader->stride = static_cast<std::uint32_t>(stride);
+    pHeader->format = TRACES_FRAME_RING_FORMAT_RGBA8;
+    pHeader->slotSize = slotSize;
+    pHeader->firstSlotOffset = firstSlotOffset;
+    __atomic_store_n(&pHeader->latestFrame, 0, __ATOMIC_RELEASE);
+    pRing->m_pHeader = pHeader;
+    return std::make_pair(pRing, nil);
+}
+
+SharedFrameRing::~SharedFrameRing()
+{
+    if (m_pMapping) munmap(m_pMapping, m_mappingSize);
+    if (m_fd >= 0) close(m_fd);
+}
+
+Error SharedFrameRing::write(std::uint8_t const* pixels, glm::ivec2 const& size, std::size_t, std::chrono::steady_clock::time_point captureTime)
+{
+    if (static_cast<std::uint32_t>(size.x) != m_pHeader->width || static_cast<std::uint32_t>(size.y) != m_pHeader->height)
+    {
+        return makeError("frame of", size.x, "x", size.y, "does not fit the frame ring");
+    }
+    std::uint64_t const frame = ++m_lastFrame;
+    auto pBase = static_cast<std::uint8_t*>(m_pMapping) + m_pHeader->firstSlotOffset;
+    auto pSlot = reinterpret_cast<TracesFrameSlotHeader*>(pBase + (frame % m_pHeader->slotCount) * m_pHeader->slotSize);
+    auto pSlotPixels = reinterpret_cast<std::uint8_t*>(pSlot + 1);
+
+    __atomic_store_n(&pSlot->sequence, 2 * frame - 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    pSlot->frame = frame;
+    // steady_clock is CLOCK_MONOTONIC on Linux
+    pSlot->captureTimeNs = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(captureTime.time_since_epoch()).count());
+    std::size_t const stride = m_pHeader->stride;
+    ThreadPool::instance().parallelFor(static_cast<std::size_t>(size.y), 64, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t y = begin; y < end; y++)
+        {
+            std::memcpy(pSlotPixels + y * stride, pixels + (size.y - 1 - y) * stride, stride);
+        }
+    });
+    pSlot->publishTimeNs = monotonicNanoseconds();
+
+    __atomic_store_n(&pSlot->sequence, 2 * frame, __ATOMIC_RELEASE);
+    __atomic_store_n(&m_pHeader->latestFrame, frame, __ATOMIC_RELEASE);
+    return nil;
+}
+
+#else
+
+std::pair<std::shared_ptr<SharedFrameRing>, Error> SharedFrameRing::make(glm::ivec2 const&, std::size_t)
+{
+    return std::make_pair(nullptr, makeError("shared frame rings need memfd, which is Linux only"));
+}
+
+SharedFrameRing::~SharedFrameRing() = default;
+
+Error SharedFrameRing::write(std::uint8_t const*, glm::ivec2 const&, std::size_t, std::chrono::steady_clock::time_point)
+{
+    return makeError("shared frame rings need memfd, which is Linux only");
+}
+
+#endif
+
+int SharedFrameRing::fd() const
+{
+    return m_fd;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Error.h"
+#include "FrameSink.h"
+#include <glm/glm.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+struct TracesFrameRingHeader;
+
+// FrameSink publishing frames into a memfd-backed ring that other processes map read-only,
+// layout and reader side in traces_frame_ring.h. Linux only, make() fails elsewhere.
+struct SharedFrameRing : FrameSink
+{
+    static std::pair<std::shared_ptr<SharedFrameRing>, Error> make(glm::ivec2 const& size, std::size_t slotCount);
+    ~SharedFrameRing() override;
+
+    Error write(std::uint8_t const* pixels, glm::ivec2 const& size, std::size_t frameIndex, std::chrono::steady_clock::time_point captureTime) override;
+
+    // stays valid, and the ring mapped, as long as this object lives
+    int fd() const;
+
+    int m_fd{-1};
+    void* m_pMapping{nullptr};
+    std::size_t m_mappingSize{0};
+    TracesFrameRingHeader* m_pHeader{nullptr};
+    std::uint64_t m_lastFrame{0};
+};
@@ -0,0 +1,354 @@
+#include "Snapshot.h"
+#include "DoubleFramebuffer.h"
+#include "GlStateGuard.h"
+#include "RandomSource.h"
+#include "Scenario.h"
+#include "Trace.h"
+#include "TraceFactory.h"
+#include "Utils.h"
+
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+char const kMagic[8] = {'T', 'R', 'C', 'S', 'N', 'A', 'P', '\0'};
+std::uint32_t const kByteOrderMark{0x01020304u};
+
+std::array<std::size_t, SnapshotColumnCount> const kColumnElementSizes{
+    sizeof(float), sizeof(float),
+    sizeof(float), sizeof(float),
+    sizeof(float), sizeof(float),
+    sizeof(float), sizeof(float),
+    sizeof(float), sizeof(float), sizeof(float),
+    sizeof(std::int64_t), sizeof(std::int64_t),
+    sizeof(std::uint64_t),
+    sizeof(std::uint8_t)
+};
+
+std::uint64_t alignUp(std::uint64_t offset)
+{
+    return (offset + kSnapshotAlignment - 1) / kSnapshotAlignment * kSnapshotAlignment;
+}
+
+std::int64_t toNs(std::chrono::steady_clock::time_point const& t)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+std::chrono::steady_clock::time_point fromNs(std::int64_t ns)
+{
+    return std::chrono::steady_clock::time_point{std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds{ns})};
+}
+
+template<typename T>
+T columnValue(Trace const& trace, SnapshotColumn column)
+{
+    switch (column)
+    {
+    case PositionX: return static_cast<T>(trace.position_.x);
+    case PositionY: return static_cast<T>(trace.position_.y);
+    case PrevPositionX: return static_cast<T>(trace.prevPosition_.x);
+    case PrevPositionY: return static_cast<T>(trace.prevPosition_.y);
+    case SegmentStartX: return static_cast<T>(trace.segmentStart_.x);
+    case SegmentStartY: return static_cast<T>(trace.segmentStart_.y);
+    case Direction: return static_cast<T>(trace.direction_);
+    case Speed: return static_cast<T>(trace.speed_);
+    case ColorR: return static_cast<T>(trace.color_.r);
+    case ColorG: return static_cast<T>(trace.color_.g);
+    case ColorB: return static_cast<T>(trace.color_.b);
+    case CreationTimeNs: return static_cast<T>(toNs(trace.creationTime_));
+    case DeathTimeNs: return static_cast<T>(toNs(trace.deathTime_));
+    case Id: return static_cast<T>(trace.id_);
+    case Killed: return static_cast<T>(trace.killed_ ? 1 : 0);
+    default: return T{};
+    }
+}
+
+template<typename T>
+Error writeColumn(std::FILE* pFile, Scenario const& scenario, SnapshotColumn column)
+{
+    std::size_t const kBatch{4096};
+    std::vector<T> values;
+    values.reserve(kBatch);
+    for (auto const& pTrace : scenario.m_vpTraces)
+    {
+        values.push_back(columnValue<T>(*pTrace, column));
+        if (values.size() == kBatch)
+        {
+            if (std::fwrite(values.data(), sizeof(T), values.size(), pFile) != values.size()) return makeError("short write in column", column);
+            values.clear();
+        }
+    }
+    if (!values.empty() && std::fwrite(values.data(), sizeof(T), values.size(), pFile) != values.size()) return makeError("short write in column", column);
+    return nil;
+}
+
+Error padTo(std::FILE* pFile, std::uint64_t offset)
+{
+    static std::array<char, kSnapshotAlignment> const zeros{};
+    long position = std::ftell(pFile);
+    if (position < 0) return makeError("could not tell file position");
+    std::uint64_t padding = offset - static_cast<std::uint64_t>(position);
+    if (padding > 0 && std::fwrite(zeros.data(), 1, padding, pFile) != padding) return makeError("short write while padding");
+    return nil;
+}
+
+// read-only view of a whole file, mapped where mmap is available
+struct MappedFile
+{
+    static std::pair<std::shared_ptr<MappedFile>, Error> open(std::string const& path)
+    {
+        auto pFile = std::make_shared<MappedFile>();
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return std::make_pair(nullptr, makeError("could not open", path, ":", std::strerror(errno)));
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            return std::make_pair(nullptr, makeError("could not stat", path, ":", std::strerror(errno)));
+        }
+        pFile->size = static_cast<std::size_t>(st.st_size);
+        if (pFile->size > 0)
+        {
+            void* pMapped = mmap(nullptr, pFile->size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (pMapped == MAP_FAILED)
+            {
+                ::close(fd);
+                return std::make_pair(nullptr, makeError("could not map", path, ":", std::strerror(errno)));
+            }
+            pFile->pData = static_cast<unsigned char const*>(pMapped);
+            madvise(pMapped, pFile->size, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+#else
+        std::ifstream f{path, std::ios::binary};
+        if (!f.is_open()) return std::make_pair(nullptr, makeError("could not open", path));
+        pFile->buffer.assign(std::istreambuf_iterator<char>{f}, std::istreambuf_iterator<char>{});
+        pFile->size = pFile->buffer.size();
+        pFile->pData = reinterpret_cast<unsigned char const*>(pFile->buffer.data());
+#endif
+        return std::make_pair(pFile, nil);
+    }
+
+    ~MappedFile()
+    {
+#ifndef _WIN32
+        if (pData) munmap(const_cast<unsigned char*>(pData), size);
+#endif
+    }
+
+    bool contains(std::uint64_t offset, std::uint64_t length) const
+    {
+        return offset <= size && length <= size - offset;
+    }
+
+    unsigned char const* pData{nullptr};
+    std::size_t size{0};
+#ifdef _WIN32
+    std::vector<char> buffer;
+#endif
+};
+
+template<typename T>
+T const* columnData(MappedFile const& file, SnapshotHeader const& header, SnapshotColumn column)
+{
+    return reinterpret_cast<T const*>(file.pData + header.columnOffsets[column]);
+}
+
+} // namespace
+
+Error saveSnapshot(Scenario const& scenario, std::string const& path, bool includeFeedbackTexture)
+{
+    SnapshotHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kSnapshotVersion;
+    header.byteOrderMark = kByteOrderMark;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.traceCount = scenario.m_vpTraces.size();
+    header.simulationTimeNs = toNs(scenario.m_simulationTime);
+
+    std::uint64_t offset = alignUp(sizeof(SnapshotHeader));
+    for (std::size_t column = 0; column < SnapshotColumnCount; column++)
+    {
+        header.columnOffsets[column] = offset;
+        offset = alignUp(offset + header.traceCount * kColumnElementSizes[column]);
+    }
+
+    std::ostringstream randomState;
+    randomState << scenario.m_random << ' ' << scenario.m_stepRandom.size();
+    for (auto const& random : scenario.m_stepRandom) randomState << ' ' << random;
+    std::string randomStateString = randomState.str();
+    header.randomStateOffset = offset;
+    header.randomStateSize = randomStateString.size();
+    offset = alignUp(offset + header.randomStateSize);
+
+    std::vector<unsigned char> pixels;
+    auto pDoubleFramebuffer = scenario.m_pDoubleFramebuffer;
+    if (includeFeedbackTexture && pDoubleFramebuffer && !pDoubleFramebuffer->noPreviousFrame)
+    {
+        glm::ivec2 textureSize = pDoubleFramebuffer->targets[pDoubleFramebuffer->previousIndex()].size;
+        header.textureWidth = textureSize.x;
+        header.textureHeight = textureSize.y;
+        header.textureSize = static_cast<std::uint64_t>(header.textureWidth) * header.textureHeight * 4;
+        header.textureOffset = offset;
+        pixels.resize(header.textureSize);
+        GlStateGuard stateGuard;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, pDoubleFramebuffer->targets[pDoubleFramebuffer->previousIndex()].texture);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    }
+
+    std::string temporaryPath = path + ".tmp";
+    std::unique_ptr<std::FILE, int(*)(std::FILE*)> pFile{std::fopen(temporaryPath.c_str(), "wb"), std::fclose};
+    if (!pFile) return makeError("could not open", temporaryPath, "for writing:", std::strerror(errno));
+
+    Error err;
+    if (std::fwrite(&header, sizeof(header), 1, pFile.get()) != 1) return makeError("could not write snapshot header");
+    for (std::size_t column = 0; column < SnapshotColumnCount && err == nil; column++)
+    {
+        err = padTo(pFile.get(), header.columnOffsets[column]);
+        if (err != nil) break;
+        auto c = static_cast<SnapshotColumn>(column);
+        if (c <= ColorB) err = writeColumn<float>(pFile.get(), scenario, c);
+        else if (c <= DeathTimeNs) err = writeColumn<std::int64_t>(pFile.get(), scenario, c);
+        else if (c == Id) err = writeColumn<std::uint64_t>(pFile.get(), scenario, c);
+        else err = writeColumn<std::uint8_t>(pFile.get(), scenario, c);
+    }
+    if (err == nil) err = padTo(pFile.get(), header.randomStateOffset);
+    if (err == nil && std::fwrite(randomStateString.data(), 1, randomStateString.size(), pFile.get()) != randomStateString.size())
+    {
+        err = makeError("could not write random state");
+    }
+    if (err == nil && !pixels.empty())
+    {
+        err = padTo(pFile.get(), header.textureOffset);
+        if (err == nil && std::fwrite(pixels.data(), 1, pixels.size(), pFile.get()) != pixels.size()) err = makeError("could not write feedback texture");
+    }
+    if (err == nil && std::fflush(pFile.get()) != 0) err = makeError("could not flush", temporaryPath);
+    pFile.reset();
+
+    if (err != nil)
+    {
+        std::remove(temporaryPath.c_str());
+        return makeError("could not save snapshot to", path, ":", err.value());
+    }
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporaryPath.c_str());
+        return makeError("could not move snapshot into place at", path, ":", std::strerror(errno));
+    }
+    return nil;
+}
+
+Error loadSnapshot(Scenario& scenario, std::string const& path)
+{
+    auto [pFile, err] = MappedFile::open(path);
+    if (err != nil) return makeError("could not load snapshot:", err.value());
+    if (!pFile->contains(0, sizeof(SnapshotHeader))) return makeError("could not load snapshot", path, ": file too short");
+
+    SnapshotHeader header;
+    std::memcpy(&header, pFile->pData, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) return makeError("could not load snapshot", path, ": not a snapshot");
+    if (header.byteOrderMark != kByteOrderMark) return makeError("could not load snapshot", path, ": written with a different byte order");
+    if (header.version != kSnapshotVersion) return makeError("could not load snapshot", path, ": unsupported version", header.version);
+    if (header.headerSize != sizeof(SnapshotHeader)) return makeError("could not load snapshot", path, ": unexpected header size", header.headerSize);
+    for (std::size_t column = 0; column < SnapshotColumnCount; column++)
+    {
+        if (header.columnOffsets[column] % kSnapshotAlignment != 0 ||
+                header.traceCount > pFile->size ||
+                !pFile->contains(header.columnOffsets[column], header.traceCount * kColumnElementSizes[column]))
+        {
+            return makeError("could not load snapshot", path, ": column", column, "out of bounds");
+        }
+    }
+    if (!pFile->contains(header.randomStateOffset, header.randomStateSize) || !pFile->contains(header.textureOffset, header.textureSize))
+    {
+        return makeError("could not load snapshot", path, ": random state or texture out of bounds");
+    }
+
+    auto positionX = columnData<float>(*pFile, header, PositionX), positionY = columnData<float>(*pFile, header, PositionY);
+    auto prevPositionX = columnData<float>(*pFile, header, PrevPositionX), prevPositionY = columnData<float>(*pFile, header, PrevPositionY);
+    auto segmentStartX = columnData<float>(*pFile, header, SegmentStartX), segmentStartY = columnData<float>(*pFile, header, SegmentStartY);
+    auto direction = columnData<float>(*pFile, header, Direction), speed = columnData<float>(*pFile, header, Speed);
+    auto colorR = columnData<float>(*pFile, header, ColorR), colorG = columnData<float>(*pFile, header, ColorG), colorB = columnData<float>(*pFile, header, ColorB);
+    auto creationTimeNs = columnData<std::int64_t>(*pFile, header, CreationTimeNs), deathTimeNs = columnData<std::int64_t>(*pFile, header, DeathTimeNs);
+    auto id = columnData<std::uint64_t>(*pFile, header, Id);
+    auto killed = columnData<std::uint8_t>(*pFile, header, Killed);
+
+    std::vector<std::shared_ptr<Trace>> vpTraces;
+    err = scenario.m_pTraceFactory->make(header.traceCount, [&](std::size_t i)
+    {
+        return Trace::State{
+            glm::vec2{positionX[i], positionY[i]},
+            glm::vec2{prevPositionX[i], prevPositionY[i]},
+            glm::vec2{segmentStartX[i], segmentStartY[i]},
+            direction[i],
+            speed[i],
+            glm::vec3{colorR[i], colorG[i], colorB[i]},
+            fromNs(creationTimeNs[i]),
+            fromNs(deathTimeNs[i]),
+            killed[i] != 0,
+            static_cast<std::size_t>(id[i])};
+    }, vpTraces);
+    if (err != nil) return makeError("could not load snapshot", path, ": could not restore traces:", err.value());
+
+    std::istringstream randomState{std::string{reinterpret_cast<char const*>(pFile->pData + header.randomStateOffset), header.randomStateSize}};
+    RandomSource restoredRandom;
+    std::size_t stepRandomCount{0};
+    if (!(randomState >> restoredRandom >> stepRandomCount) || stepRandomCount > header.randomStateSize)
+    {
+        return makeError("could not load snapshot", path, ": corrupted random state");
+    }
+    std::vector<RandomSource> restoredStepRandom(stepRandomCount);
+    for (auto& random : restoredStepRandom)
+    {
+        if (!(randomState >> random)) return makeError("could not load snapshot", path, ": corrupted random state");
+    }
+
+    auto pDoubleFramebuffer = scenario.m_pDoubleFramebuffer;
+    if (header.textureSize > 0 && pDoubleFramebuffer)
+    {
+        glm::ivec2 textureSize = pDoubleFramebuffer->targets[pDoubleFramebuffer->previousIndex()].size;
+        if (header.textureWidth == textureSize.x && header.textureHeight == textureSize.y &&
+                header.textureSize == static_cast<std::uint64_t>(header.textureWidth) * header.textureHeight * 4)
+        {
+            GlStateGuard stateGuard;
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glBindTexture(GL_TEXTURE_2D, pDoubleFramebuffer->targets[pDoubleFramebuffer->previousIndex()].texture);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, header.textureWidth, header.textureHeight, GL_RGBA, GL_UNSIGNED_BYTE, pFile->pData + header.textureOffset);
+            pDoubleFramebuffer->noPreviousFrame = false;
+        }
+        else
+        {
+            std::cerr << "snapshot " << path << ": feedback texture is " << header.textureWidth << "x" << header.textureHeight
+                      << ", scenario is " << textureSize.x << "x" << textureSize.y
+                      << ", starting from an empty frame" << std::endl;
+        }
+    }
+
+    // into the room Scenario::setupRenderers() reserved
+    scenario.m_vpTraces.assign(std::make_move_iterator(vpTraces.begin()), std::make_move_iterator(vpTraces.end()));
+    scenario.m_simulationTime = fromNs(header.simulationTimeNs);
+    scenario.m_random = restoredRandom;
+    scenario.m_stepRandom = std::move(restoredStepRandom);
+    return nil;
+}
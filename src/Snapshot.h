@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Error.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct Scenario;
+
+// Versioned binary snapshot of a running scenario.
+//
+// Layout, in host byte order (the header records it):
+//   SnapshotHeader
+//   one column per SnapshotColumn, traceCount elements each, every column starting on a
+//   kSnapshotAlignment boundary so that a mapped file can be read in place
+//   the scenario's random sources as operator<< writes them: Scenario::m_random, the number of
+//   sources in Scenario::m_stepRandom and each of those, separated by spaces
+//   optionally the feedback texture, RGBA8, textureWidth * textureHeight pixels, bottom row first
+enum SnapshotColumn : std::uint32_t
+{
+    PositionX, PositionY,
+    PrevPositionX, PrevPositionY,
+    SegmentStartX, SegmentStartY,
+    Direction, Speed,
+    ColorR, ColorG, ColorB,
+    CreationTimeNs, DeathTimeNs,
+    Id,
+    Killed,
+    SnapshotColumnCount
+};
+
+struct SnapshotHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrderMark;
+    std::uint64_t headerSize;
+    std::uint64_t traceCount;
+    std::int64_t simulationTimeNs;
+    std::uint64_t columnOffsets[SnapshotColumnCount];
+    std::uint64_t randomStateOffset;
+    std::uint64_t randomStateSize;
+    std::int32_t textureWidth;
+    std::int32_t textureHeight;
+    std::uint64_t textureOffset;
+    std::uint64_t textureSize;
+};
+
+constexpr std::uint32_t kSnapshotVersion{2};
+constexpr std::size_t kSnapshotAlignment{64};
+
+// Writes to path + ".tmp" first and renames, so a crash never leaves a truncated snapshot behind.
+// Saving the feedback texture needs the scenario's GL context to be current.
+Error saveSnapshot(Scenario const& scenario, std::string const& path, bool includeFeedbackTexture);
+
+// Replaces the traces, clock and random state of scenario with the ones in the snapshot.
+// The feedback texture, if any, is restored only when its size matches the scenario's.
+Error loadSnapshot(Scenario& scenario, std::string const& path);
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "ObstacleMask.h"
+#include "Trace.h"
+#include "Utils.h"
+#include <glm/glm.hpp>
+#include <chrono>
+#include <cmath>
+
+// Policies Scenario::stepTraces() is specialized on. A boundary policy's apply() runs for every trace
+// before it steps, with the window's lower left and upper right corner in monometric coordinates;
+// a lifetime policy decides which traces no longer step and are removed by finishStep().
+// apply() is written without branches so that the stepping loop only branches on the lifetime.
+// An obstacle policy's apply() runs after the boundary's, with the scenario's ObstacleMask.
+
+// traces leaving the window die
+struct KillBoundary
+{
+    static void apply(Trace& trace, glm::vec2 const& lower, glm::vec2 const& upper)
+    {
+        glm::vec2 const& p = trace.position_;
+        bool outside = (p.x < lower.x) | (p.x > upper.x) | (p.y < lower.y) | (p.y > upper.y);
+        trace.killed_ = trace.killed_ | outside;
+    }
+};
+
+// traces leaving the window come back in on the opposite side
+struct WrapBoundary
+{
+    static void apply(Trace& trace, glm::vec2 const& lower, glm::vec2 const& upper)
+    {
+        glm::vec2 size = upper - lower;
+        glm::vec2 relative = trace.position_ - lower;
+        glm::vec2 offset = -size * glm::floor(relative / size);
+        // the pending segment moves along so that no segment spans the window
+        trace.position_ += offset;
+        trace.prevPosition_ += offset;
+        trace.segmentStart_ += offset;
+    }
+};
+
+// traces leaving the window are mirrored back in at the edge they crossed and turn around
+struct ReflectBoundary
+{
+    static void apply(Trace& trace, glm::vec2 const& lower, glm::vec2 const& upper)
+    {
+        glm::vec2& p = trace.position_;
+        glm::vec2 below{static_cast<float>(p.x < lower.x), static_cast<float>(p.y < lower.y)};
+        glm::vec2 above{static_cast<float>(p.x > upper.x), static_cast<float>(p.y > upper.y)};
+        p += 2.0f * (below * (lower - p) + above * (upper - p));
+
+        glm::vec2 flip = below + above;
+        float direction = trace.direction_;
+        direction += flip.x * (static_cast<float>(M_PI) - 2.0f * direction);
+        direction -= flip.y * 2.0f * direction;
+        trace.direction_ = direction;
+    }
+};
+
+// traces die at their deathTime_, splitting with the scenario's split probability
+struct MortalLifetime
+{
+    static bool dead(Trace const& trace, std::chrono::steady_clock::time_point const& now)
+    {
+        return trace.isDead(now);
+    }
+};
+
+// traces only die when a boundary kills them
+struct ImmortalLifetime
+{
+    static bool dead(Trace const& trace, std::chrono::steady_clock::time_point const&)
+    {
+        return trace.killed_;
+    }
+};
+
+// no mask, nothing to test
+struct NoObstacles
+{
+    static void apply(Trace&, ObstacleMask const*, glm::vec2 const&, glm::vec2 const&)
+    {
+    }
+};
+
+// traces reaching an obstacle die
+struct KillObstacles
+{
+    static void apply(Trace& trace, ObstacleMask const* pMask, glm::vec2 const& lower, glm::vec2 const& upper)
+    {
+        trace.killed_ = trace.killed_ | !pMask->allowed((trace.position_ - lower) / (upper - lower));
+    }
+};
+
+// traces reaching an obstacle step back and are mirrored off its edge
+struct DeflectObstacles
+{
+    static void apply(Trace& trace, ObstacleMask const* pMask, glm::vec2 const& lower, glm::vec2 const& upper)
+    {
+        glm::vec2 const size = upper - lower;
+        glm::vec2 const uv = (trace.position_ - lower) / size;
+        if (pMask->allowed(uv)) return;
+
+        // the edge normal in monometric units, from the gradient in mask units
+        glm::vec2 normal = pMask->gradient(uv) / size;
+        float length = std::sqrt(normal.x * normal.x + normal.y * normal.y);
+        glm::vec2 heading{std::cos(trace.direction_), std::sin(trace.direction_)};
+        if (length > 0.0f)
+        {
+            normal = normal / length;
+            float along = heading.x * normal.x + heading.y * normal.y;
+            if (along < 0.0f) heading -= 2.0f * along * normal;
+        }
+        else
+        {
+            heading = -heading;
+        }
+        trace.direction_ = fastAtan2(heading.y, heading.x);
+        trace.position_ = trace.prevPosition_;
+    }
+};
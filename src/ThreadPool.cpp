@@ -0,0 +1,173 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace {
+
+std::size_t const kInitialQueueCapacity{64};
+
+} // namespace
+
+ThreadPool::ThreadPool(std::size_t workerCount)
+{
+    // one extra queue for tasks pushed by threads outside the pool
+    for (std::size_t i = 0; i < workerCount + 1; i++) queues.push_back(std::make_unique<Queue>());
+    for (std::size_t i = 0; i < workerCount; i++) workers.emplace_back([this, i] { workerLoop(i); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock{sleepMutex};
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+ThreadPool& ThreadPool::instance()
+{
+    static ThreadPool pool{std::max(1u, std::thread::hardware_concurrency()) - 1};
+    return pool;
+}
+
+std::size_t ThreadPool::workerCount() const
+{
+    return workers.size();
+}
+
+void ThreadPool::run(std::size_t count, TaskFunction fn, void* pContext)
+{
+    if (count == 0) return;
+    if (workers.empty() || count == 1)
+    {
+        for (std::size_t i = 0; i < count; i++) fn(pContext, i);
+        return;
+    }
+
+    TaskGroup group;
+    group.pending = count;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        auto& queue = *queues[nextQueue++ % queues.size()];
+        std::lock_guard<std::mutex> lock{queue.mutex};
+        queue.pushBack(Task{fn, pContext, i, &group});
+        // counted before the lock publishes the task, so that taking it never finds the count at 0
+        queuedTasks++;
+    }
+    {
+        std::lock_guard<std::mutex> lock{sleepMutex};
+    }
+    wakeUp.notify_all();
+
+    while (group.pending.load(std::memory_order_acquire) > 0)
+    {
+        if (!tryRunOne(workers.size())) std::this_thread::yield();
+    }
+}
+
+void ThreadPool::run(std::vector<std::function<void()>> tasks)
+{
+    run(tasks.size(), [](void* pContext, std::size_t index)
+    {
+        (*static_cast<std::vector<std::function<void()>>*>(pContext))[index]();
+    }, &tasks);
+}
+
+void ThreadPool::parallelFor(std::size_t count, std::size_t grainSize, std::function<void(std::size_t, std::size_t)> const& fn)
+{
+    struct Context
+    {
+        std::size_t count;
+        std::size_t grainSize;
+        std::function<void(std::size_t, std::size_t)> const& fn;
+    };
+    grainSize = std::max<std::size_t>(grainSize, 1);
+    Context context{count, grainSize, fn};
+    run((count + grainSize - 1) / grainSize, [](void* pContext, std::size_t index)
+    {
+        auto& context = *static_cast<Context*>(pContext);
+        std::size_t begin = index * context.grainSize;
+        context.fn(begin, std::min(context.count, begin + context.grainSize));
+    }, &context);
+}
+
+void ThreadPool::workerLoop(std::size_t index)
+{
+    while (true)
+    {
+        if (tryRunOne(index)) continue;
+
+        std::unique_lock<std::mutex> lock{sleepMutex};
+        wakeUp.wait(lock, [this] { return stopping || queuedTasks.load() > 0; });
+        if (stopping) return;
+    }
+}
+
+bool ThreadPool::tryRunOne(std::size_t preferredQueue)
+{
+    Task task;
+    if (popOwn(preferredQueue, task) || steal(preferredQueue, task))
+    {
+        execute(task);
+        return true;
+    }
+    return false;
+}
+
+bool ThreadPool::popOwn(std::size_t index, Task& task)
+{
+    auto& queue = *queues[index];
+    std::lock_guard<std::mutex> lock{queue.mutex};
+    if (queue.count == 0) return false;
+    task = queue.popBack();
+    queuedTasks--;
+    return true;
+}
+
+bool ThreadPool::steal(std::size_t thiefIndex, Task& task)
+{
+    for (std::size_t offset = 1; offset < queues.size(); offset++)
+    {
+        auto& queue = *queues[(thiefIndex + offset) % queues.size()];
+        std::unique_lock<std::mutex> lock{queue.mutex, std::try_to_lock};
+        if (!lock || queue.count == 0) continue;
+        task = queue.popFront();
+        queuedTasks--;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::execute(Task& task)
+{
+    task.fn(task.pContext, task.index);
+    task.pGroup->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void ThreadPool::Queue::pushBack(Task const& task)
+{
+    if (count == tasks.size())
+    {
+        std::vector<Task> grown(std::max<std::size_t>(2 * tasks.size(), kInitialQueueCapacity));
+        for (std::size_t i = 0; i < count; i++) grown[i] = tasks[(head + i) % tasks.size()];
+        tasks.swap(grown);
+        head = 0;
+    }
+    tasks[(head + count) % tasks.size()] = task;
+    count++;
+}
+
+ThreadPool::Task ThreadPool::Queue::popBack()
+{
+    count--;
+    return tasks[(head + count) % tasks.size()];
+}
+
+ThreadPool::Task ThreadPool::Queue::popFront()
+{
+    Task task = tasks[head];
+    head = (head + 1) % tasks.size();
+    count--;
+    return task;
+}
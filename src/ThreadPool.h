@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool shared by the whole library. Every worker owns a double-ended queue: it pops
+// its own tasks from the back and steals from the front of the others' when it runs dry.
+// The thread calling run() or parallelFor() works on the tasks too, until all of them are done.
+// Once the queues have grown to the largest batch, running tasks through a TaskFunction and
+// parallelFor() allocate nothing.
+struct ThreadPool
+{
+    // one task of a batch, called with the batch's context and the task's index in it
+    using TaskFunction = void (*)(void* pContext, std::size_t index);
+
+    explicit ThreadPool(std::size_t workerCount);
+    ~ThreadPool();
+
+    static ThreadPool& instance();
+
+    // calls fn(pContext, i) for every i below count
+    void run(std::size_t count, TaskFunction fn, void* pContext);
+    void run(std::vector<std::function<void()>> tasks);
+    void parallelFor(std::size_t count, std::size_t grainSize, std::function<void(std::size_t begin, std::size_t end)> const& fn);
+
+    std::size_t workerCount() const;
+
+private:
+    struct TaskGroup
+    {
+        std::atomic<std::size_t> pending{0};
+    };
+
+    struct Task
+    {
+        TaskFunction fn{nullptr};
+        void* pContext{nullptr};
+        std::size_t index{0};
+        TaskGroup* pGroup{nullptr};
+    };
+
+    // ring of count tasks starting at head, doubling when full and never shrinking
+    struct Queue
+    {
+        std::mutex mutex;
+        std::vector<Task> tasks;
+        std::size_t head{0};
+        std::size_t count{0};
+
+        void pushBack(Task const& task);
+        Task popBack();
+        Task popFront();
+    };
+
+    void workerLoop(std::size_t index);
+    bool tryRunOne(std::size_t preferredQueue);
+    bool popOwn(std::size_t index, Task& task);
+    bool steal(std::size_t thiefIndex, Task& task);
+    void execute(Task& task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> queuedTasks{0};
+    std::atomic<std::size_t> nextQueue{0};
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    bool stopping{false};
+};
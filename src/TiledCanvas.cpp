@@ -0,0 +1,292 @@
+#include "TiledCanvas.h"
+#include "BulkRenderer.h"
+#include "DoubleFramebuffer.h"
+#include "TraceFactory.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+int const TiledCanvas::kTilePixels{256};
+float const TiledCanvas::kMaxZoom{8.0f};
+std::size_t const TiledCanvas::kDefaultMaxTiles{128};
+
+namespace {
+
+// side of the segment bins, in world pixels
+int const kBinPixels{32};
+
+std::uint64_t packKey(glm::ivec2 const& key)
+{
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(key.y)) << 32) | static_cast<std::uint32_t>(key.x);
+}
+
+} // namespace
+
+std::pair<std::shared_ptr<TiledCanvas>, Error> TiledCanvas::make(glm::ivec2 const& screenSize, glm::ivec2 const& worldSize, std::size_t initialTraceCount,
+                                                                 Scenario::Options options, std::size_t maxTiles)
+{
+    if (screenSize.x <= 0 || screenSize.y <= 0)
+    {
+        return std::make_pair(nullptr, makeError("could not make tiled canvas: invalid screen size", screenSize.x, "x", screenSize.y));
+    }
+    if (worldSize.x <= 0 || worldSize.y <= 0)
+    {
+        return std::make_pair(nullptr, makeError("could not make tiled canvas: invalid world size", worldSize.x, "x", worldSize.y));
+    }
+
+    std::shared_ptr<TiledCanvas> pCanvas{new (std::nothrow) TiledCanvas()};
+    if (!pCanvas) return std::make_pair(nullptr, makeError("could not instantiate TiledCanvas"));
+    pCanvas->screenSize = screenSize;
+    pCanvas->worldSize = worldSize;
+    pCanvas->m_maxTiles = maxTiles;
+    if (pCanvas->maxVisibleTiles(kMaxZoom) > maxTiles)
+    {
+        return std::make_pair(nullptr, makeError("could not make tiled canvas:", maxTiles, "tiles do not cover the screen even at zoom", kMaxZoom));
+    }
+    // the fewest tiles are in view at the highest zoom, search down from there
+    float lowest = 0.0f;
+    float highest = kMaxZoom;
+    for (int i = 0; i < 32; i++)
+    {
+        float zoom = 0.5f * (lowest + highest);
+        if (pCanvas->maxVisibleTiles(zoom) <= maxTiles) highest = zoom;
+        else lowest = zoom;
+    }
+    pCanvas->m_minZoom = highest;
+
+    options.ownFramebuffers = false;
+    Error err;
+    std::tie(pCanvas->pScenario, err) = Scenario::make(initialTraceCount, worldSize, options);
+    if (err != nil) return std::make_pair(nullptr, makeError("could not make tiled canvas:", err.value()));
+    auto& scenario = *pCanvas->pScenario;
+
+    // a renderer with the scenario's trace program and a vertex buffer of its own
+    std::shared_ptr<TraceFactory> pTraceFactory;
+    std::tie(pTraceFactory, err) = TraceFactory::make(scenario.m_windowHeightOverWidth, scenario.traceShaderFeatures());
+    if (err != nil) return std::make_pair(nullptr, makeError("could not make tiled canvas:", err.value()));
+    pCanvas->m_pBulkRenderer = pTraceFactory->getBulkRenderer();
+    pCanvas->m_pBulkRenderer->setLineWidth(options.lineWidth);
+    pCanvas->m_pBulkRenderer->setLineAntialiasing(options.lineAntialiasing);
+
+    pCanvas->setCamera(0.5f * glm::vec2{worldSize}, 1.0f);
+    return std::make_pair(pCanvas, nil);
+}
+
+void TiledCanvas::step()
+{
+    // draw() would bin and drop the segments outside the tiles in view, they are not emitted at all
+    auto [firstTile, lastTile] = tilesInView();
+    auto [lower, upper] = toMonometric(firstTile, lastTile);
+    float const reach = lineReach();
+    pScenario->m_renderCullBox = BoundingBox{glm::vec2{lower.x - reach, upper.y + reach}, glm::vec2{upper.x + reach, lower.y - reach}};
+    pScenario->step();
+}
+
+void TiledCanvas::setCamera(glm::vec2 const& center, float zoom)
+{
+    m_cameraCenter = glm::vec2{std::clamp(center.x, 0.0f, static_cast<float>(worldSize.x)), std::clamp(center.y, 0.0f, static_cast<float>(worldSize.y))};
+    m_cameraZoom = std::clamp(zoom, m_minZoom, kMaxZoom);
+}
+
+void TiledCanvas::pan(glm::vec2 const& screenPixels)
+{
+    setCamera(m_cameraCenter - screenPixels / m_cameraZoom, m_cameraZoom);
+}
+
+void TiledCanvas::zoomAt(glm::vec2 const& screenPixel, float factor)
+{
+    glm::vec2 fromCenter = screenPixel - 0.5f * glm::vec2{screenSize};
+    glm::vec2 anchor = m_cameraCenter + fromCenter / m_cameraZoom;
+    float zoom = std::clamp(m_cameraZoom * factor, m_minZoom, kMaxZoom);
+    setCamera(anchor - fromCenter / zoom, zoom);
+}
+
+std::size_t TiledCanvas::maxVisibleTiles(float zoom) const
+{
+    // a view of n tiles' width straddles at most ceil(n) + 1 columns, and no more than the world has
+    glm::vec2 viewTiles = glm::vec2{screenSize} / (zoom * kTilePixels);
+    glm::ivec2 worldTiles = (worldSize + glm::ivec2{kTilePixels - 1, kTilePixels - 1}) / kTilePixels;
+    auto columns = std::min(static_cast<std::size_t>(std::ceil(viewTiles.x)) + 1, static_cast<std::size_t>(worldTiles.x));
+    auto rows = std::min(static_cast<std::size_t>(std::ceil(viewTiles.y)) + 1, static_cast<std::size_t>(worldTiles.y));
+    return columns * rows;
+}
+
+glm::vec2 TiledCanvas::toMonometric(glm::vec2 const& worldPixel) const
+{
+    // the world height spans 2 monometric units, as the window does for a scenario of its own
+    float const pixelsToMonometric = 2.0f / worldSize.y;
+    return glm::vec2{(worldPixel.x - 0.5f * worldSize.x) * pixelsToMonometric, (0.5f * worldSize.y - worldPixel.y) * pixelsToMonometric};
+}
+
+std::pair<glm::vec2, glm::vec2> TiledCanvas::toMonometric(glm::ivec2 const& firstTile, glm::ivec2 const& lastTile) const
+{
+    glm::vec2 const lower = toMonometric(glm::vec2{static_cast<float>(firstTile.x * kTilePixels), static_cast<float>((lastTile.y + 1) * kTilePixels)});
+    glm::vec2 const upper = toMonometric(glm::vec2{static_cast<float>((lastTile.x + 1) * kTilePixels), static_cast<float>(firstTile.y * kTilePixels)});
+    return std::make_pair(lower, upper);
+}
+
+std::pair<glm::ivec2, glm::ivec2> TiledCanvas::tilesInView() const
+{
+    glm::vec2 const viewSize = glm::vec2{screenSize} / m_cameraZoom;
+    glm::vec2 const viewTopLeft = m_cameraCenter - 0.5f * viewSize;
+    glm::vec2 const viewBottomRight = m_cameraCenter + 0.5f * viewSize;
+    glm::ivec2 const worldTiles = (worldSize + glm::ivec2{kTilePixels - 1, kTilePixels - 1}) / kTilePixels;
+    glm::ivec2 const firstTile{std::max(static_cast<int>(std::floor(viewTopLeft.x / kTilePixels)), 0),
+                               std::max(static_cast<int>(std::floor(viewTopLeft.y / kTilePixels)), 0)};
+    glm::ivec2 const lastTile{std::min(static_cast<int>(std::ceil(viewBottomRight.x / kTilePixels)), worldTiles.x) - 1,
+                              std::min(static_cast<int>(std::ceil(viewBottomRight.y / kTilePixels)), worldTiles.y) - 1};
+    return std::make_pair(firstTile, lastTile);
+}
+
+float TiledCanvas::lineReach() const
+{
+    // segments wider than a pixel reach half their width past their ends
+    return 0.5f * std::max(pScenario->m_options.lineWidth, 1.0f) * 2.0f / worldSize.y;
+}
+
+std::pair<std::size_t, Error> TiledCanvas::acquireTile(glm::ivec2 const& key)
+{
+    auto found = m_tileIndices.find(packKey(key));
+    if (found != m_tileIndices.end())
+    {
+        m_tiles[found->second].lastSeenFrame = m_frame;
+        return std::make_pair(found->second, nil);
+    }
+
+    std::size_t index = m_tiles.size();
+    if (m_tiles.size() < m_maxTiles)
+    {
+        auto [pDoubleFramebuffer, err] = DoubleFramebuffer::make(kTilePixels, kTilePixels, pScenario->feedbackShaderFeatures());
+        if (err != nil) return std::make_pair(index, makeError("could not make tile:", err.value()));
+        pDoubleFramebuffer->outputFramebuffer = std::nullopt;
+        m_tiles.push_back(Tile{key, pDoubleFramebuffer, m_frame});
+    }
+    else
+    {
+        // take over the tile seen least recently, never one in view this frame
+        for (std::size_t i = 0; i < m_tiles.size(); i++)
+        {
+            if (m_tiles[i].lastSeenFrame == m_frame) continue;
+            if (index == m_tiles.size() || m_tiles[i].lastSeenFrame < m_tiles[index].lastSeenFrame) index = i;
+        }
+        if (index == m_tiles.size()) return std::make_pair(index, makeError("could not make tile: all", m_maxTiles, "tiles are in view"));
+        Tile& tile = m_tiles[index];
+        m_tileIndices.erase(packKey(tile.key));
+        tile.key = key;
+        tile.lastSeenFrame = m_frame;
+        tile.pDoubleFramebuffer->noPreviousFrame = true;
+    }
+    m_tileIndices.emplace(packKey(key), index);
+    return std::make_pair(index, nil);
+}
+
+void TiledCanvas::draw()
+{
+    if (!pScenario->m_pBulkRenderer) return;
+    auto startTime = std::chrono::steady_clock::now();
+    m_frame++;
+    m_lastSegmentCount = 0;
+
+    pScenario->m_pBulkRenderer->takeVertices(m_segmentVertices, m_points);
+
+    // the view in world pixels and the tiles it overlaps
+    glm::vec2 const viewTopLeft = m_cameraCenter - 0.5f * glm::vec2{screenSize} / m_cameraZoom;
+    auto const [firstTile, lastTile] = tilesInView();
+    m_visibleTiles.clear();
+    for (int row = firstTile.y; row <= lastTile.y; row++)
+    {
+        for (int column = firstTile.x; column <= lastTile.x; column++)
+        {
+            auto [index, err] = acquireTile(glm::ivec2{column, row});
+            if (err != nil)
+            {
+                std::cerr << "could not draw tiled canvas: " << err.value() << std::endl;
+                continue;
+            }
+            m_visibleTiles.push_back(index);
+        }
+    }
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, outputFramebuffer);
+    glViewport(0, 0, screenSize.x, screenSize.y);
+    glClearColor(0, 0, 0, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (m_visibleTiles.empty())
+    {
+        pScenario->m_lastDrawTime = std::chrono::steady_clock::now() - startTime;
+        return;
+    }
+
+    // the scenario emitted only the segments near these tiles, if the camera did not move since step()
+    float const pixelsToMonometric = 2.0f / worldSize.y;
+    float const lineReach = this->lineReach();
+    auto const [viewLower, viewUpper] = toMonometric(firstTile, lastTile);
+    glm::vec2 const reach{lineReach, lineReach};
+    m_segmentBins.rebuild(m_segmentVertices, 2, viewLower - reach, viewUpper + reach, kBinPixels * pixelsToMonometric, true);
+    m_pointBins.rebuild(m_points, 1, viewLower - reach, viewUpper + reach, kBinPixels * pixelsToMonometric, true);
+
+    // the fade of every tile in view and then their traces, binding each program once
+    DoubleFramebuffer& firstFramebuffer = *m_tiles[m_visibleTiles.front()].pDoubleFramebuffer;
+    GLuint feedbackProgram = *firstFramebuffer.pFeedbackProgram;
+    firstFramebuffer.useQuadProgram(feedbackProgram);
+    for (std::size_t index : m_visibleTiles)
+    {
+        DoubleFramebuffer& doubleFramebuffer = *m_tiles[index].pDoubleFramebuffer;
+        doubleFramebuffer.bindFramebuffer();
+        glClear(GL_COLOR_BUFFER_BIT);
+        doubleFramebuffer.drawPreviousFrame(feedbackProgram, 0.0f, pScenario->m_options.fadeFactor);
+    }
+    firstFramebuffer.unuseQuadProgram(feedbackProgram);
+
+    BulkRenderer& renderer = *m_pBulkRenderer;
+    renderer.use();
+    for (std::size_t index : m_visibleTiles)
+    {
+        Tile& tile = m_tiles[index];
+        auto const [lower, upper] = toMonometric(tile.key, tile.key);
+        m_segmentBins.forEachRunNear(lower, upper, lineReach, [&](glm::vec2 const* vertices, std::size_t count)
+        {
+            renderer.addSegments(vertices, count);
+            m_lastSegmentCount += count / 2;
+        });
+        m_pointBins.forEachRunNear(lower, upper, lineReach, [&renderer](glm::vec2 const* points, std::size_t count)
+        {
+            renderer.addPoints(points, count);
+        });
+        renderer.setView(lower, upper);
+        tile.pDoubleFramebuffer->bindFramebuffer();
+        renderer.bufferData();
+        renderer.setColor(pScenario->m_options.color);
+        renderer.setSecondaryColor(pScenario->m_options.secondaryColor);
+        renderer.draw();
+    }
+    renderer.unuse();
+
+    // Every tile covers the screen rectangle between its rounded edges, so that neighbours share
+    // their edge pixels exactly. The blur would sample across tile edges and is left out.
+    auto [pPresentProgram, err] = firstFramebuffer.presentProgram();
+    if (err != nil)
+    {
+        std::cerr << "could not draw tiled canvas: " << err.value() << std::endl;
+        return;
+    }
+    firstFramebuffer.useQuadProgram(*pPresentProgram);
+    for (std::size_t index : m_visibleTiles)
+    {
+        Tile& tile = m_tiles[index];
+        glm::vec2 const tileTopLeft = glm::vec2{tile.key} * static_cast<float>(kTilePixels);
+        glm::vec2 const from = (tileTopLeft - viewTopLeft) * m_cameraZoom;
+        glm::vec2 const to = (tileTopLeft + glm::vec2{static_cast<float>(kTilePixels), static_cast<float>(kTilePixels)} - viewTopLeft) * m_cameraZoom;
+        int left = static_cast<int>(std::lround(from.x));
+        int right = static_cast<int>(std::lround(to.x));
+        int top = static_cast<int>(std::lround(from.y));
+        int bottom = static_cast<int>(std::lround(to.y));
+        tile.pDoubleFramebuffer->outputFramebuffer = outputFramebuffer;
+        tile.pDoubleFramebuffer->outputViewport = glm::ivec4{left, screenSize.y - bottom, right - left, bottom - top};
+        tile.pDoubleFramebuffer->drawToScreen(*pPresentProgram);
+    }
+    firstFramebuffer.unuseQuadProgram(*pPresentProgram);
+
+    pScenario->m_lastDrawTime = std::chrono::steady_clock::now() - startTime;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Error.h"
+#include "Scenario.h"
+#include "SegmentBins.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct BulkRenderer;
+struct DoubleFramebuffer;
+
+// A world much larger than the screen, seen through a camera that pans and zooms. The scenario
+// simulates the whole world and draws nothing itself (see Scenario::Options::ownFramebuffers). The
+// trails persist in square tiles of the world, each a DoubleFramebuffer, made on demand up to
+// maxTiles; past that the tile seen least recently is taken over. draw() fades, draws into and
+// composites only the tiles in view, and step() has the scenario emit only the segments near them,
+// so traces off screen cost no more than their stepping and tiles out of view keep their trails as
+// they were. The camera should not move between step() and draw(): segments in tiles that came into
+// view in between are missing from them.
+// Positions are in world pixels from the world's top left, y down; at zoom 1 a world pixel covers
+// a screen pixel.
+struct TiledCanvas
+{
+    // needs the GL context
+    static std::pair<std::shared_ptr<TiledCanvas>, Error> make(glm::ivec2 const& screenSize, glm::ivec2 const& worldSize, std::size_t initialTraceCount,
+                                                               Scenario::Options options, std::size_t maxTiles = kDefaultMaxTiles);
+
+    void step();
+    // composites the view into outputFramebuffer
+    void draw();
+
+    // the center stays in the world, the zoom between minZoom() and kMaxZoom
+    void setCamera(glm::vec2 const& center, float zoom);
+    // moves the view by screenPixels, e.g. the cursor's movement while dragging
+    void pan(glm::vec2 const& screenPixels);
+    // zooms by factor, keeping what is under screenPixel (from the screen's top left) in place
+    void zoomAt(glm::vec2 const& screenPixel, float factor);
+    glm::vec2 cameraCenter() const { return m_cameraCenter; }
+    float cameraZoom() const { return m_cameraZoom; }
+    // the zoom at which the most tiles are in view that maxTiles still covers
+    float minZoom() const { return m_minZoom; }
+
+    std::size_t tileCount() const { return m_tiles.size(); }
+    std::size_t visibleTileCount() const { return m_visibleTiles.size(); }
+    // segments the last draw() drew into tiles in view
+    std::size_t lastSegmentCount() const { return m_lastSegmentCount; }
+
+    // side of the tiles, in world pixels and in pixels of their framebuffers
+    static int const kTilePixels;
+    static float const kMaxZoom;
+    static std::size_t const kDefaultMaxTiles;
+
+    std::shared_ptr<Scenario> pScenario;
+    glm::ivec2 screenSize{};
+    glm::ivec2 worldSize{};
+    // where draw() composites the view, the default framebuffer unless set
+    GLuint outputFramebuffer{0u};
+
+private:
+    struct Tile
+    {
+        // column and row from the world's top left
+        glm::ivec2 key;
+        std::shared_ptr<DoubleFramebuffer> pDoubleFramebuffer;
+        std::uint64_t lastSeenFrame{0};
+    };
+
+    // index in m_tiles of the tile at key, made or taken over if there is none
+    std::pair<std::size_t, Error> acquireTile(glm::ivec2 const& key);
+    // tiles in view at zoom with the camera anywhere
+    std::size_t maxVisibleTiles(float zoom) const;
+    glm::vec2 toMonometric(glm::vec2 const& worldPixel) const;
+    // lower and upper corner of the tiles from firstTile to lastTile, in monometric coordinates
+    std::pair<glm::vec2, glm::vec2> toMonometric(glm::ivec2 const& firstTile, glm::ivec2 const& lastTile) const;
+    // first and last column and row of the tiles the camera sees
+    std::pair<glm::ivec2, glm::ivec2> tilesInView() const;
+    // how far past their ends segments cover pixels, in monometric units
+    float lineReach() const;
+
+    std::vector<Tile> m_tiles;
+    std::unordered_map<std::uint64_t, std::size_t> m_tileIndices;
+    std::size_t m_maxTiles{0};
+    std::uint64_t m_frame{0};
+    // indices in m_tiles
+    std::vector<std::size_t> m_visibleTiles;
+
+    glm::vec2 m_cameraCenter{};
+    float m_cameraZoom{1.0f};
+    float m_minZoom{1.0f};
+
+    // draws into every tile in turn, its view set to the tile
+    std::shared_ptr<BulkRenderer> m_pBulkRenderer;
+    std::vector<glm::vec2> m_segmentVertices;
+    std::vector<glm::vec2> m_points;
+    SegmentBins m_segmentBins;
+    SegmentBins m_pointBins;
+    std::size_t m_lastSegmentCount{0};
+};
@@ -1,20 +1,18 @@
 #include "Trace.h"
+#include "RandomSource.h"
 #include "TraceFactory.h"
 #include "Utils.h"
 #include <glm/gtx/polar_coordinates.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <random>
 
-namespace {
-std::random_device rd;
-std::mt19937 gen{rd()};
-std::geometric_distribution<> dis;
-std::normal_distribution<> nd{1.0, 0.5};
-}
-
-Trace::Trace(glm::vec2 const& initialPosition, float initialDirection_, glm::vec3 const& color, std::chrono::steady_clock::time_point const& creationTime, std::shared_ptr<const GLuint> pProgram, std::shared_ptr<const GLuint> pBuffer)
+Trace::Trace(glm::vec2 const& initialPosition, float initialDirection_, glm::vec3 const& color, std::chrono::steady_clock::time_point const& creationTime, RandomSource& random, std::shared_ptr<const GLuint> pProgram, std::shared_ptr<const GLuint> pBuffer)
     : position_{initialPosition}
     , direction_{initialDirection_}
     , color_{color}
+    , segmentStart_{initialPosition}
     , pProgram_{pProgram}
     , pBuffer_{pBuffer}
     , creationTime_{creationTime}
@@ -22,15 +20,53 @@ Trace::Trace(glm::vec2 const& initialPosition, float initialDirection_, glm::vec
     , killed_{false}
     , id_{++nextId_}
 {
-    //deathTime_ += std::chrono::milliseconds{dis(gen)*2000};
-    deathTime_ += std::chrono::milliseconds{static_cast<int>(nd(gen)*1000)};
-    speed_ = nd(gen);
-    step(periodMs());
+    //deathTime_ += std::chrono::milliseconds{random.geometricDistribution(random.generator)*2000};
+    deathTime_ += std::chrono::milliseconds{static_cast<int>(random.normal()*1000)};
+    speed_ = random.normal();
+    step(periodMs(), random);
+}
+
+Trace::Trace(State const& state, std::shared_ptr<const GLuint> pProgram, std::shared_ptr<const GLuint> pBuffer)
+    : position_{state.position}
+    , direction_{state.direction}
+    , speed_{state.speed}
+    , color_{state.color}
+    , prevPosition_{state.prevPosition}
+    , segmentStart_{state.segmentStart}
+    , pProgram_{pProgram}
+    , pBuffer_{pBuffer}
+    , creationTime_{state.creationTime}
+    , deathTime_{state.deathTime}
+    , killed_{state.killed}
+    , id_{state.id}
+{
+    std::size_t nextId = nextId_.load();
+    while (nextId < id_ && !nextId_.compare_exchange_weak(nextId, id_)) {}
+}
+
+void Trace::step(std::chrono::milliseconds const &ms, RandomSource& random)
+{
+    advance(ms, direction_, random);
+}
+
+void Trace::step(std::chrono::milliseconds const &ms, glm::vec2 const &steering, float weight, RandomSource& random)
+{
+    advance(ms, steeredDirection(steering, weight), random);
+}
+
+float Trace::steeredDirection(glm::vec2 const &steering, float weight) const
+{
+    float strength = std::min(std::sqrt(steering.x * steering.x + steering.y * steering.y), 1.0f);
+    if (strength <= 0.0f || weight <= 0.0f) return direction_;
+    // turn the shorter way round towards the steering direction
+    float turn = fastAtan2(steering.y, steering.x) - direction_;
+    turn -= static_cast<float>(2 * M_PI) * std::floor(turn / static_cast<float>(2 * M_PI) + 0.5f);
+    return direction_ + weight * strength * turn;
 }
 
-void Trace::step(std::chrono::milliseconds const &ms)
+void Trace::advance(std::chrono::milliseconds const &ms, float centerDirection, RandomSource& random)
 {
-    float newDirection = uniformAround(direction_, 3 * M_PI / 36.0);
+    float newDirection = uniformAround(centerDirection, 3 * M_PI / 36.0, random);
 
     glm::vec2 deltaPositionPolar = glm::vec2(
         speed_ * kMaxStepMagnitude * ms.count(),
@@ -52,7 +88,7 @@ void Trace::render()
     glUseProgram(*pProgram_);
 
     glBindBuffer(GL_ARRAY_BUFFER, *pBuffer_);
-    std::vector<float> vs{prevPosition_.x, prevPosition_.y, position_.x, position_.y};
+    std::array<float, 4> vs{prevPosition_.x, prevPosition_.y, position_.x, position_.y};
     glBufferData(GL_ARRAY_BUFFER, static_cast<int>(vs.size()) * sizeof(vs[0]), vs.data(), GL_STREAM_DRAW);
 
     GLint positionLocation = glGetAttribLocation(*pProgram_, "positionMonometric");
@@ -68,18 +104,29 @@ void Trace::render()
     glUseProgram(0);
 }
 
-std::pair<std::shared_ptr<Trace>, std::shared_ptr<Trace>> Trace::split() const
+std::pair<std::shared_ptr<Trace>, std::shared_ptr<Trace>> Trace::split(RandomSource& random, std::pmr::memory_resource* pMemory) const
 {
-    return std::make_pair(
-        std::make_shared<Trace>(position_, uniformAround(direction_, M_PI / 4), color_, deathTime_, pProgram_, pBuffer_),
-        std::make_shared<Trace>(position_, uniformAround(direction_, M_PI / 4), color_, deathTime_, pProgram_, pBuffer_)
-    );
+    std::pmr::polymorphic_allocator<Trace> allocator{pMemory};
+    auto pTrace1 = std::allocate_shared<Trace>(allocator, position_, uniformAround(direction_, M_PI / 4, random), color_, deathTime_, random, pProgram_, pBuffer_);
+    auto pTrace2 = std::allocate_shared<Trace>(allocator, position_, uniformAround(direction_, M_PI / 4, random), color_, deathTime_, random, pProgram_, pBuffer_);
+    return std::make_pair(pTrace1, pTrace2);
 }
 
 
-bool Trace::isDead() const
+bool Trace::hasSegmentLongerThan(float minLength) const
+{
+    glm::vec2 pending = position_ - segmentStart_;
+    return pending.x * pending.x + pending.y * pending.y >= minLength * minLength;
+}
+
+void Trace::markSegmentEmitted()
+{
+    segmentStart_ = position_;
+}
+
+bool Trace::isDead(std::chrono::steady_clock::time_point const& now) const
 {
-    return killed_ || std::chrono::steady_clock::now() >= deathTime_;
+    return killed_ || now >= deathTime_;
 }
 
 void Trace::kill()
@@ -93,9 +140,9 @@ float Trace::prevTheta() const
     return atan2(prevDeltaPosition.y, prevDeltaPosition.x);
 }
 
-float Trace::uniformAround(float thetaCenter, float thetaWidth) const
+float Trace::uniformAround(float thetaCenter, float thetaWidth, RandomSource& random) const
 {
-    return uniformInInterval(
+    return random.uniform(
         thetaCenter - thetaWidth / 2.0,
         thetaCenter + thetaWidth / 2.0);
 }
@@ -110,4 +157,4 @@ std::ostream &operator<<(std::ostream &str, Trace const &t)
 }
 
 float const Trace::kMaxStepMagnitude{0.1f/(periodMs().count() * 60)};
-std::size_t Trace::nextId_{0};
+std::atomic<std::size_t> Trace::nextId_{0};
@@ -4,33 +4,67 @@
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
 #include <utility>
 #include <vector>
 
+struct RandomSource;
+
 struct Trace
 {
-    Trace(glm::vec2 const& initialPosition, float initialDirection_, const glm::vec3 &color, std::chrono::steady_clock::time_point const& creationTime, std::shared_ptr<const GLuint> pProgram, std::shared_ptr<const GLuint> pBuffer);
+    // everything needed to bring a trace back exactly as it was, see Snapshot.h
+    struct State
+    {
+        glm::vec2 position;
+        glm::vec2 prevPosition;
+        glm::vec2 segmentStart;
+        float direction;
+        float speed;
+        glm::vec3 color;
+        std::chrono::steady_clock::time_point creationTime;
+        std::chrono::steady_clock::time_point deathTime;
+        bool killed;
+        std::size_t id;
+    };
+
+    Trace(glm::vec2 const& initialPosition, float initialDirection_, const glm::vec3 &color, std::chrono::steady_clock::time_point const& creationTime, RandomSource& random, std::shared_ptr<const GLuint> pProgram, std::shared_ptr<const GLuint> pBuffer);
+    Trace(State const& state, std::shared_ptr<const GLuint> pProgram, std::shared_ptr<const GLuint> pBuffer);
 
-    void step(std::chrono::milliseconds const& ms);
+    void step(std::chrono::milliseconds const& ms, RandomSource& random);
+    // Random walk pulled towards steering by weight (0 to 1) times its length, capped at 1;
+    // see FlowField.
+    void step(std::chrono::milliseconds const& ms, glm::vec2 const& steering, float weight, RandomSource& random);
+    // direction_ turned towards steering as step() does
+    float steeredDirection(glm::vec2 const& steering, float weight) const;
 
     void render();
 
-    std::pair<std::shared_ptr<Trace>, std::shared_ptr<Trace>> split() const;
+    // the two traces are allocated from pMemory
+    std::pair<std::shared_ptr<Trace>, std::shared_ptr<Trace>> split(RandomSource& random, std::pmr::memory_resource* pMemory = std::pmr::get_default_resource()) const;
+
+    // Level of detail: the segment drawn for a trace starts at segmentStart_ and is only emitted
+    // once the trace has moved at least minLength away from it.
+    bool hasSegmentLongerThan(float minLength) const;
+    void markSegmentEmitted();
 
-    bool isDead() const;
+    bool isDead(std::chrono::steady_clock::time_point const& now) const;
     void kill();
 
     float prevTheta() const;
-    float uniformAround(float thetaCenter, float thetaWidth) const;
+    float uniformAround(float thetaCenter, float thetaWidth, RandomSource& random) const;
+    // one step of the random walk, its direction drawn around centerDirection
+    void advance(std::chrono::milliseconds const& ms, float centerDirection, RandomSource& random);
 
     glm::vec2 position_;
     float direction_;
     float speed_;
     glm::vec3 color_;
     glm::vec2 prevPosition_;
+    glm::vec2 segmentStart_;
     std::shared_ptr<GLuint const> pProgram_;
     std::shared_ptr<GLuint const> pBuffer_;
     std::chrono::steady_clock::time_point creationTime_;
@@ -39,7 +73,7 @@ struct Trace
     std::size_t id_;
 
     static float const kMaxStepMagnitude;
-    static std::size_t nextId_;
+    static std::atomic<std::size_t> nextId_;
 
     friend std::ostream& operator<<(std::ostream& str, Trace const& t);
 };
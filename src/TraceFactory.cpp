@@ -1,113 +1,150 @@
 #include "TraceFactory.h"
+#include "ObstacleMask.h"
 #include "Utils.h"
 #include "Program.h"
-#include "Shader.h"
+#include "ProgramCache.h"
+#include "RandomSource.h"
 #include "ShaderSources.h"
-#include <glm/gtc/type_ptr.hpp>
 
 struct TraceFactoryImpl
 {
     std::pair<std::shared_ptr<Trace>, Error> make(BoundingBox const& allowedBox, glm::vec3 const& color, const std::chrono::steady_clock::time_point &creationTime);
     std::pair<std::shared_ptr<Trace>, Error> make(glm::vec2 const& initialPosition, float initialDirection_, glm::vec3 const& color, const std::chrono::steady_clock::time_point &creationTime);
-    void setNormalCoordinatesTransform(float windowHeightOverWidth);
+    RandomSource& random() const { return pRandom ? *pRandom : threadRandomSource(); }
 
     std::shared_ptr<const GLuint> pProgram;
     std::shared_ptr<const GLuint> pBuffer;
+    float windowHeightOverWidth;
+    std::pmr::memory_resource* pTraceMemory{std::pmr::get_default_resource()};
+    std::shared_ptr<ObstacleMask const> pSpawnMask;
+    RandomSource* pRandom{nullptr};
 };
 
+namespace {
 
-std::pair<std::shared_ptr<const GLuint>, Error> makeProgram()
+// tries at an allowed position inside the box before looking anywhere the mask allows
+int const kSpawnAttempts{32};
+
+} // namespace
+
+
+char const* const TraceFactory::kSharedProgramKey{"trace"};
+
+std::pair<std::shared_ptr<const GLuint>, Error> TraceFactory::makeProgram(ShaderFeatures features)
 {
-    auto [pVert, pFrag, err] = makeShaderPair(trace_vert, trace_frag);
+    auto [pProgram, err] = makeCachedProgram(trace_vert, trace_frag, shaderDefines(features));
     if (err != nil)
     {
-        return std::make_pair(nullptr, makeError("could not load shaders:", err.value()));
+        return std::make_pair(nullptr, makeError("could not build trace program:", err.value()));
     }
-    return makeProgram(pVert, pFrag);
+    return std::make_pair(pProgram, nil);
+}
+
+std::pair<std::shared_ptr<PendingProgram>, Error> TraceFactory::startProgram(ShaderFeatures features)
+{
+    return startCachedProgram(trace_vert, trace_frag, shaderDefines(features));
 }
 
 std::pair<std::shared_ptr<Trace>, Error> TraceFactoryImpl::make(BoundingBox const &allowedBox, glm::vec3 const& color, const std::chrono::steady_clock::time_point &creationTime)
 {
-    glm::vec2 initialPosition = uniformInBox(allowedBox);
-    return std::make_pair(std::make_shared<Trace>(initialPosition, uniformInInterval(0, 2 * M_PI), color, creationTime, pProgram, pBuffer), nil);
+    RandomSource& random = this->random();
+    glm::vec2 initialPosition = random.uniformInBox(allowedBox);
+    if (pSpawnMask)
+    {
+        // the window as Scenario::WindowBoundaries has it
+        glm::vec2 const lower{-1.0 / windowHeightOverWidth, -1.0};
+        glm::vec2 const upper{1.0 / windowHeightOverWidth, 1.0};
+        bool found = false;
+        for (int attempt = 0; attempt < kSpawnAttempts && !found; attempt++)
+        {
+            found = pSpawnMask->allowed((initialPosition - lower) / (upper - lower));
+            if (!found) initialPosition = random.uniformInBox(allowedBox);
+        }
+        glm::vec2 uv;
+        if (!found && pSpawnMask->sampleAllowed(uv, random)) initialPosition = lower + uv * (upper - lower);
+    }
+    return make(initialPosition, random.uniform(0, 2 * M_PI), color, creationTime);
 }
 
 std::pair<std::shared_ptr<Trace>, Error> TraceFactoryImpl::make(glm::vec2 const &initialPosition, float initialDirection_, glm::vec3 const& color, const std::chrono::steady_clock::time_point &creationTime)
 {
-    return std::make_pair(std::make_shared<Trace>(initialPosition, initialDirection_, color, creationTime, pProgram, pBuffer), nil);
+    std::pmr::polymorphic_allocator<Trace> allocator{pTraceMemory};
+    return std::make_pair(std::allocate_shared<Trace>(allocator, initialPosition, initialDirection_, color, creationTime, random(), pProgram, pBuffer), nil);
 }
 
-void TraceFactoryImpl::setNormalCoordinatesTransform(float windowHeightOverWidth)
+std::pair<std::shared_ptr<TraceFactory>, Error> TraceFactory::make(float windowHeightOverWidth, ShaderFeatures features)
 {
-    glUseProgram(*pProgram);
-    glm::mat2 toNormalCoordinates{
-        glm::vec2{windowHeightOverWidth, 0.0f},
-        glm::vec2{0.0f, 1.0f}};
-    glUniformMatrix2fv(glGetUniformLocation(*pProgram, "toNormalCoordinates"),
-                       1,
-                       GL_FALSE,
-                       glm::value_ptr(toNormalCoordinates));
-    glUseProgram(InvalidId);
+    auto [pProgram, err] = getSharedProgram(shaderVariantKey(kSharedProgramKey, features), [features] { return makeProgram(features); });
+    if (err != nil)
+    {
+        return std::make_pair(nullptr, makeError("could not create TraceFactory instance, failed building program:", err.value()));
+    }
+    return make(windowHeightOverWidth, pProgram);
 }
 
-std::pair<std::shared_ptr<TraceFactory>, Error> TraceFactory::getInstance(float windowHeightOverWidth)
+std::pair<std::shared_ptr<TraceFactory>, Error> TraceFactory::make(float windowHeightOverWidth, std::shared_ptr<const GLuint> pProgram)
 {
-    if (!pImpl && instanceCreationError) return std::make_pair(nullptr, makeError("could not make instance:", instanceCreationError.value()));
-    if (!instanceCreationError)
+    auto pTraceFactory = std::make_shared<TraceFactory>();
+    pTraceFactory->pImpl = std::make_shared<TraceFactoryImpl>();
+    pTraceFactory->pImpl->pProgram = pProgram;
+    pTraceFactory->pImpl->pBuffer = genBuffer();
+    pTraceFactory->pImpl->windowHeightOverWidth = windowHeightOverWidth;
+    if (!pTraceFactory->pImpl->pBuffer)
     {
-        std::tie(pImpl, instanceCreationError) = createInstance(windowHeightOverWidth);
-        if (instanceCreationError) return std::make_pair(nullptr, makeError("could not make instance:", instanceCreationError.value()));
+        return std::make_pair(nullptr, makeError("could not create TraceFactory instance, failed generating vertex buffer"));
     }
-    return std::make_pair(std::make_shared<TraceFactory>(), nil);
+    return std::make_pair(pTraceFactory, nil);
 }
 
 std::pair<std::shared_ptr<Trace>, Error> TraceFactory::make(BoundingBox const& allowedBox, glm::vec3 const& color, const std::chrono::steady_clock::time_point &creationTime)
 {
-    if (!pImpl) return std::make_pair(nullptr, makeError("no TraceFactory instance:", instanceCreationError.value()));
+    if (!pImpl) return std::make_pair(nullptr, makeError("TraceFactory was not initialized"));
     return pImpl->make(allowedBox, color, creationTime);
 }
 
 std::pair<std::shared_ptr<Trace>, Error> TraceFactory::make(glm::vec2 const &initialPosition, float initialDirection_, glm::vec3 const& color, const std::chrono::steady_clock::time_point &creationTime)
 {
-    if (!pImpl) return std::make_pair(nullptr, makeError("no TraceFactory instance:", instanceCreationError.value()));
+    if (!pImpl) return std::make_pair(nullptr, makeError("TraceFactory was not initialized"));
     return pImpl->make(initialPosition, initialDirection_, color, creationTime);
 }
 
-void TraceFactory::setNormalCoordinatesTransform(float windowHeightOverWidth)
+Error TraceFactory::make(std::size_t count, std::function<Trace::State(std::size_t)> const& stateAt, std::vector<std::shared_ptr<Trace>>& vpTraces)
 {
-    if (!pImpl) return;
-    pImpl->setNormalCoordinatesTransform(windowHeightOverWidth);
+    if (!pImpl) return makeError("TraceFactory was not initialized");
+    auto pBlock = std::make_shared<std::vector<Trace>>();
+    pBlock->reserve(count);
+    vpTraces.reserve(vpTraces.size() + count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        pBlock->emplace_back(stateAt(i), pImpl->pProgram, pImpl->pBuffer);
+        // shares the block's count, there is no allocation per trace
+        vpTraces.emplace_back(pBlock, &pBlock->back());
+    }
+    return nil;
 }
 
 std::shared_ptr<BulkRenderer> TraceFactory::getBulkRenderer() const
 {
     if (!pImpl) return nullptr;
-    return std::make_shared<BulkRenderer>(*pImpl->pProgram, *pImpl->pBuffer);
+    return std::make_shared<BulkRenderer>(pImpl->pProgram, pImpl->pBuffer, pImpl->windowHeightOverWidth);
 }
 
-std::pair<std::shared_ptr<TraceFactoryImpl>, Error> TraceFactory::createInstance(float windowHeightOverWidth)
+void TraceFactory::setTraceMemory(std::pmr::memory_resource* pMemory)
 {
-    if (!pImpl)
-    {
-        if (instanceCreationError)
-        {
-            return std::make_pair(nullptr, makeError("could not create TraceFactory instance, don't have program:", instanceCreationError.value()));
-        }
-        auto [pProgram, err] = makeProgram();
-        if (err != nil)
-        {
-            instanceCreationError = err;
-            return std::make_pair(nullptr, makeError("could not create TraceFactory instance, failed building program:", instanceCreationError.value()));
-        }
-        pImpl = std::make_shared<TraceFactoryImpl>();
-        pImpl->pProgram = pProgram;
-        pImpl->setNormalCoordinatesTransform(windowHeightOverWidth);
-    }
-    if (!pImpl->pBuffer)
-        pImpl->pBuffer = genBuffer();
+    if (pImpl) pImpl->pTraceMemory = pMemory;
+}
 
-    return std::make_pair(pImpl, nil);
+std::pmr::memory_resource* TraceFactory::traceMemory() const
+{
+    return pImpl ? pImpl->pTraceMemory : std::pmr::get_default_resource();
 }
 
-std::shared_ptr<TraceFactoryImpl> TraceFactory::pImpl;
-Error TraceFactory::instanceCreationError;
+void TraceFactory::setRandomSource(RandomSource* pRandom)
+{
+    if (pImpl) pImpl->pRandom = pRandom;
+}
+
+void TraceFactory::setSpawnMask(std::shared_ptr<ObstacleMask const> pMask)
+{
+    if (pImpl) pImpl->pSpawnMask = std::move(pMask);
+}
@@ -3,27 +3,49 @@
 #include "BulkRenderer.h"
 #include "BoundingBox.h"
 #include "Error.h"
+#include "ShaderSources.h"
 #include "Trace.h"
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include <functional>
 #include <memory>
+#include <memory_resource>
 #include <utility>
+#include <vector>
 
+struct ObstacleMask;
+struct PendingProgram;
+struct RandomSource;
 struct TraceFactoryImpl;
 
 struct TraceFactory
 {
-    static std::pair<std::shared_ptr<TraceFactory>, Error> getInstance(float windowHeightOverWidth);
+    // uses the shared trace program variant built with features
+    static std::pair<std::shared_ptr<TraceFactory>, Error> make(float windowHeightOverWidth, ShaderFeatures features = 0);
+    static std::pair<std::shared_ptr<TraceFactory>, Error> make(float windowHeightOverWidth, std::shared_ptr<const GLuint> pProgram);
+    static std::pair<std::shared_ptr<const GLuint>, Error> makeProgram(ShaderFeatures features);
+    // the trace program without waiting for the compiler, see startCachedProgram()
+    static std::pair<std::shared_ptr<PendingProgram>, Error> startProgram(ShaderFeatures features);
+    // name of the trace program variants in getSharedProgram(), see shaderVariantKey()
+    static char const* const kSharedProgramKey;
 
     std::pair<std::shared_ptr<Trace>, Error> make(BoundingBox const& allowedBox, const glm::vec3 &color, std::chrono::steady_clock::time_point const& creationTime);
     std::pair<std::shared_ptr<Trace>, Error> make(glm::vec2 const& initialPosition, float initialDirection_, glm::vec3 const& color, std::chrono::steady_clock::time_point const& creationTime);
-    static void setNormalCoordinatesTransform(float windowHeightOverWidth);
+    // Appends count traces, stateAt(i) giving the i-th, all in one block of memory that lives as
+    // long as any of them does.
+    Error make(std::size_t count, std::function<Trace::State(std::size_t)> const& stateAt, std::vector<std::shared_ptr<Trace>>& vpTraces);
 
     std::shared_ptr<BulkRenderer> getBulkRenderer() const;
 
-private:
-    static std::pair<std::shared_ptr<TraceFactoryImpl>, Error> createInstance(float windowHeightOverWidth);
+    // where traces are allocated from, the default resource unless set; it must outlive them
+    void setTraceMemory(std::pmr::memory_resource* pMemory);
+    std::pmr::memory_resource* traceMemory() const;
+    // what new traces draw their positions, directions, speeds and lifetimes from, the calling
+    // thread's threadRandomSource() unless set; it must outlive the factory
+    void setRandomSource(RandomSource* pRandom);
+    // traces made in a box start where the mask, stretched over the window, allows; null allows everywhere
+    void setSpawnMask(std::shared_ptr<ObstacleMask const> pMask);
 
-    static std::shared_ptr<TraceFactoryImpl> pImpl;
-    static Error instanceCreationError;
+private:
+    std::shared_ptr<TraceFactoryImpl> pImpl;
 };
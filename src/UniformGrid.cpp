@@ -0,0 +1,41 @@
+#include "UniformGrid.h"
+#include <cmath>
+
+void UniformGrid::rebuild(glm::vec2 const* keys, std::size_t count, glm::vec2 const& lower, glm::vec2 const& upper, float cellSize)
+{
+    glm::vec2 size = upper - lower;
+    m_lower = lower;
+    m_inverseCellSize = 1.0f / cellSize;
+    m_cells = glm::ivec2{std::max(1, static_cast<int>(std::ceil(size.x * m_inverseCellSize))),
+                         std::max(1, static_cast<int>(std::ceil(size.y * m_inverseCellSize)))};
+    std::size_t const cellCount = static_cast<std::size_t>(m_cells.x) * m_cells.y;
+
+    // count the items per cell, turn the counts into start offsets, then scatter the items
+    m_cellStart.assign(cellCount + 1, 0u);
+    m_itemCells.resize(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        glm::ivec2 cell = cellOf(keys[i]);
+        std::uint32_t index = static_cast<std::uint32_t>(cell.y * m_cells.x + cell.x);
+        m_itemCells[i] = index;
+        m_cellStart[index]++;
+    }
+    std::uint32_t offset{0};
+    for (std::size_t c = 0; c < cellCount; c++)
+    {
+        std::uint32_t cellItems = m_cellStart[c];
+        m_cellStart[c] = offset;
+        offset += cellItems;
+    }
+    m_items.resize(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        m_items[m_cellStart[m_itemCells[i]]++] = static_cast<std::uint32_t>(i);
+    }
+    // scattering moved every start to the start of the next cell
+    for (std::size_t c = cellCount; c > 0; c--)
+    {
+        m_cellStart[c] = m_cellStart[c - 1];
+    }
+    m_cellStart[0] = 0u;
+}
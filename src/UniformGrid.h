@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Uniform grid over a rectangle, rebuilt from scratch with a counting sort whenever the items move,
+// for neighbour queries in O(n) per rebuild. The rectangle is bounded, so cells are indexed directly
+// instead of hashed; keys outside it fall into the nearest edge cell. Items two cells apart are never
+// both visited by forEachNear(), so the cell size must be at least the interaction distance.
+// Items are sorted by cell into slots; callers keep their per-item data in slot order (item(slot) is
+// the index it was given at) so that neighbours are next to each other in memory too.
+// Memory is kept between rebuilds.
+struct UniformGrid
+{
+    void rebuild(glm::vec2 const* keys, std::size_t count, glm::vec2 const& lower, glm::vec2 const& upper, float cellSize);
+
+    std::uint32_t item(std::size_t slot) const { return m_items[slot]; }
+
+    // calls fn(slot) for every item in the cell of key and the eight around it
+    template <typename Fn>
+    void forEachNear(glm::vec2 const& key, Fn&& fn) const
+    {
+        glm::ivec2 cell = cellOf(key);
+        int x0 = std::max(cell.x - 1, 0);
+        int x1 = std::min(cell.x + 1, m_cells.x - 1);
+        int y0 = std::max(cell.y - 1, 0);
+        int y1 = std::min(cell.y + 1, m_cells.y - 1);
+        for (int y = y0; y <= y1; y++)
+        {
+            // the cells of a row are contiguous in the sorted items
+            std::size_t row = static_cast<std::size_t>(y) * m_cells.x;
+            for (std::uint32_t i = m_cellStart[row + x0], end = m_cellStart[row + x1 + 1]; i < end; i++)
+            {
+                fn(i);
+            }
+        }
+    }
+
+    glm::ivec2 cells() const { return m_cells; }
+
+private:
+    glm::ivec2 cellOf(glm::vec2 const& key) const
+    {
+        glm::vec2 cell = (key - m_lower) * m_inverseCellSize;
+        return glm::ivec2{std::clamp(static_cast<int>(cell.x), 0, m_cells.x - 1),
+                          std::clamp(static_cast<int>(cell.y), 0, m_cells.y - 1)};
+    }
+
+    glm::vec2 m_lower{};
+    float m_inverseCellSize{1.0f};
+    glm::ivec2 m_cells{1, 1};
+    // items of cell c are m_items[m_cellStart[c]] up to m_items[m_cellStart[c + 1]]
+    std::vector<std::uint32_t> m_cellStart{0u, 0u};
+    std::vector<std::uint32_t> m_items;
+    std::vector<std::uint32_t> m_itemCells;
+};
@@ -1,15 +1,11 @@
 #include "Utils.h"
+#include "RandomSource.h"
 #include "Trace.h"
 #include "TraceFactory.h"
 #include <GLFW/glfw3.h>
 #include <fstream>
 #include <random>
 
-namespace {
-std::random_device rd;
-std::mt19937 gen{rd()};
-}
-
 std::pair<std::string, Error> readFile(std::string const& path)
 {
     std::ifstream f;
@@ -26,9 +22,7 @@ std::pair<std::string, Error> readFile(std::string const& path)
 
 glm::vec2 uniformInBox(glm::vec2 const& boundTopLeft, glm::vec2 const& boundBottomRight)
 {
-    std::uniform_real_distribution<float> unifX{boundTopLeft.x, boundBottomRight.x};
-    std::uniform_real_distribution<float> unifY{boundBottomRight.y, boundTopLeft.y};
-    return glm::vec2{unifX(gen), unifY(gen)};
+    return threadRandomSource().uniformInBox(BoundingBox{boundTopLeft, boundBottomRight});
 }
 
 glm::vec2 uniformInBox(BoundingBox const& bb)
@@ -36,10 +30,14 @@ glm::vec2 uniformInBox(BoundingBox const& bb)
     return uniformInBox(bb.topLeft, bb.bottomRight);
 }
 
+std::mt19937& randomGenerator()
+{
+    return threadRandomSource().generator;
+}
+
 float uniformInInterval(float left, float right)
 {
-    std::uniform_real_distribution<float> dis{left, right};
-    return dis(gen);
+    return threadRandomSource().uniform(left, right);
 }
 
 std::shared_ptr<GLuint const> genBuffer()
@@ -112,7 +110,7 @@ void mouseBtnFun(GLFWwindow *window, int button, int action, int mod)
         //std::cout << "mouse: (" << monometricPosition.x << "," << monometricPosition.y << ")" << std::endl;
 
         std::vector<std::shared_ptr<Trace>> *vpTraces = reinterpret_cast<std::vector<std::shared_ptr<Trace>> *>(glfwGetWindowUserPointer(window));
-        auto [pTraceFactory, err] = TraceFactory::getInstance(windowSize.y/windowSize.x);
+        auto [pTraceFactory, err] = TraceFactory::make(windowSize.y/windowSize.x);
                 if (err != nil)
         {
             std::cout << "could not get TraceFactory instance: " << err.value() << std::endl;
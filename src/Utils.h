@@ -4,8 +4,11 @@
 #include "Error.h"
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <memory>
+#include <random>
 #include <string>
 #include <utility>
 #include <vector>
@@ -18,6 +21,7 @@ std::pair<std::string, Error> readFile(std::string const& path);
 glm::vec2 uniformInBox(glm::vec2 const& boundTopLeft, glm::vec2 const& boundBottomRight);
 glm::vec2 uniformInBox(BoundingBox const& bb);
 float uniformInInterval(float left, float right);
+std::mt19937& randomGenerator();
 std::shared_ptr<GLuint const> genBuffer();
 
 glm::vec2 getMouseCursorPosition(GLFWwindow* window);
@@ -37,3 +41,17 @@ inline std::chrono::milliseconds periodMs()
     return std::chrono::milliseconds{16};
 }
 constexpr GLuint InvalidId = 0u;
+
+// std::atan2 to within 0.004 radians, for per-trace steering where the libm call would dominate
+inline float fastAtan2(float y, float x)
+{
+    float ax = std::abs(x);
+    float ay = std::abs(y);
+    float maxXY = std::max(ax, ay);
+    if (maxXY == 0.0f) return 0.0f;
+    float z = std::min(ax, ay) / maxXY;
+    float angle = z * (0.7853982f + 0.273f * (1.0f - z));
+    if (ay > ax) angle = 1.5707963f - angle;
+    if (x < 0.0f) angle = 3.1415927f - angle;
+    return y < 0.0f ? -angle : angle;
+}
@@ -0,0 +1,163 @@
+#include "VideoWall.h"
+#include "BulkRenderer.h"
+#include "DoubleFramebuffer.h"
+#include "TraceFactory.h"
+#include "Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <iostream>
+
+int const VideoWall::kBinPixels{32};
+
+std::pair<std::shared_ptr<VideoWall>, Error> VideoWall::make(std::vector<Panel> const& panels, std::size_t initialTraceCount, Scenario::Options options)
+{
+    if (panels.empty()) return std::make_pair(nullptr, makeError("could not make video wall: no panels"));
+    glm::ivec2 minCorner{INT_MAX, INT_MAX};
+    glm::ivec2 maxCorner{INT_MIN, INT_MIN};
+    for (auto const& panel : panels)
+    {
+        if (panel.viewport.z <= 0 || panel.viewport.w <= 0)
+        {
+            return std::make_pair(nullptr, makeError("could not make video wall: invalid panel size", panel.viewport.z, "x", panel.viewport.w));
+        }
+        minCorner = glm::ivec2{std::min(minCorner.x, panel.viewport.x), std::min(minCorner.y, panel.viewport.y)};
+        maxCorner = glm::ivec2{std::max(maxCorner.x, panel.viewport.x + panel.viewport.z), std::max(maxCorner.y, panel.viewport.y + panel.viewport.w)};
+    }
+
+    std::shared_ptr<VideoWall> pWall{new (std::nothrow) VideoWall()};
+    if (!pWall) return std::make_pair(nullptr, makeError("could not instantiate VideoWall"));
+    pWall->canvasSize = maxCorner - minCorner;
+
+    options.ownFramebuffers = false;
+    Error err;
+    std::tie(pWall->pScenario, err) = Scenario::make(initialTraceCount, pWall->canvasSize, options);
+    if (err != nil) return std::make_pair(nullptr, makeError("could not make video wall:", err.value()));
+    auto& scenario = *pWall->pScenario;
+
+    // the canvas height spans 2 monometric units, as the window does for a scenario of its own
+    float const pixelsToMonometric = 2.0f / pWall->canvasSize.y;
+    pWall->m_canvasLower = glm::vec2{-0.5f * pWall->canvasSize.x * pixelsToMonometric, -1.0f};
+    pWall->m_canvasUpper = glm::vec2{0.5f * pWall->canvasSize.x * pixelsToMonometric, 1.0f};
+
+    for (auto const& panel : panels)
+    {
+        PanelOutput output;
+        output.panel = panel;
+        glm::ivec2 topLeft = glm::ivec2{panel.viewport.x, panel.viewport.y} - minCorner;
+        output.lower = glm::vec2{pWall->m_canvasLower.x + topLeft.x * pixelsToMonometric,
+                                 pWall->m_canvasUpper.y - (topLeft.y + panel.viewport.w) * pixelsToMonometric};
+        output.upper = glm::vec2{pWall->m_canvasLower.x + (topLeft.x + panel.viewport.z) * pixelsToMonometric,
+                                 pWall->m_canvasUpper.y - topLeft.y * pixelsToMonometric};
+
+        std::tie(output.pDoubleFramebuffer, err) = DoubleFramebuffer::make(panel.viewport.z, panel.viewport.w, scenario.feedbackShaderFeatures());
+        if (err != nil) return std::make_pair(nullptr, makeError("could not make video wall panel:", err.value()));
+        output.pDoubleFramebuffer->outputFramebuffer = std::nullopt;
+        output.pDoubleFramebuffer->setBlurStandardDeviationOnBlitAndSwap(options.traceBlurStandardDeviation);
+
+        // a renderer with the scenario's trace program and a vertex buffer of its own
+        std::shared_ptr<TraceFactory> pTraceFactory;
+        std::tie(pTraceFactory, err) = TraceFactory::make(scenario.m_windowHeightOverWidth, scenario.traceShaderFeatures());
+        if (err != nil) return std::make_pair(nullptr, makeError("could not make video wall panel:", err.value()));
+        output.pBulkRenderer = pTraceFactory->getBulkRenderer();
+        output.pBulkRenderer->setLineWidth(options.lineWidth);
+        output.pBulkRenderer->setLineAntialiasing(options.lineAntialiasing);
+        output.pBulkRenderer->setView(output.lower, output.upper);
+        pWall->m_panels.push_back(std::move(output));
+    }
+    return std::make_pair(pWall, nil);
+}
+
+VideoWall::~VideoWall()
+{
+    if (m_drawn) glDeleteSync(m_drawn);
+}
+
+void VideoWall::step()
+{
+    pScenario->step();
+}
+
+void VideoWall::draw()
+{
+    if (!pScenario->m_pBulkRenderer) return;
+    auto startTime = std::chrono::steady_clock::now();
+
+    pScenario->m_pBulkRenderer->takeVertices(m_segmentVertices, m_points);
+    float const pixelsToMonometric = (m_canvasUpper.y - m_canvasLower.y) / canvasSize.y;
+    m_segmentBins.rebuild(m_segmentVertices, 2, m_canvasLower, m_canvasUpper, kBinPixels * pixelsToMonometric, false);
+    m_pointBins.rebuild(m_points, 1, m_canvasLower, m_canvasUpper, kBinPixels * pixelsToMonometric, false);
+
+    // the fade of every panel and then the traces of every panel, binding each program once
+    glClearColor(0, 0, 0, 1.0);
+    DoubleFramebuffer& firstFramebuffer = *m_panels.front().pDoubleFramebuffer;
+    GLuint feedbackProgram = *firstFramebuffer.pFeedbackProgram;
+    firstFramebuffer.useQuadProgram(feedbackProgram);
+    for (auto& output : m_panels)
+    {
+        output.pDoubleFramebuffer->bindFramebuffer();
+        glClear(GL_COLOR_BUFFER_BIT);
+        output.pDoubleFramebuffer->drawPreviousFrame(feedbackProgram, 0.0f, pScenario->m_options.fadeFactor);
+    }
+    firstFramebuffer.unuseQuadProgram(feedbackProgram);
+
+    // segments wider than a pixel reach half their width past their ends
+    float const lineReach = 0.5f * std::max(pScenario->m_options.lineWidth, 1.0f) * pixelsToMonometric;
+    BulkRenderer& firstRenderer = *m_panels.front().pBulkRenderer;
+    firstRenderer.use();
+    for (auto& output : m_panels)
+    {
+        BulkRenderer& renderer = *output.pBulkRenderer;
+        output.segmentCount = 0;
+        m_segmentBins.forEachRunNear(output.lower, output.upper, lineReach, [&](glm::vec2 const* vertices, std::size_t count)
+        {
+            renderer.addSegments(vertices, count);
+            output.segmentCount += count / 2;
+        });
+        m_pointBins.forEachRunNear(output.lower, output.upper, lineReach, [&renderer](glm::vec2 const* points, std::size_t count)
+        {
+            renderer.addPoints(points, count);
+        });
+        output.pDoubleFramebuffer->bindFramebuffer();
+        renderer.bufferData();
+        renderer.setColor(pScenario->m_options.color);
+        renderer.setSecondaryColor(pScenario->m_options.secondaryColor);
+        renderer.draw();
+    }
+    firstRenderer.unuse();
+
+    // the panels present themselves in present(), this only finishes their frames
+    for (auto& output : m_panels) output.pDoubleFramebuffer->drawToScreen(InvalidId);
+
+    if (m_drawn) glDeleteSync(m_drawn);
+    m_drawn = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // other contexts can only wait for the fence once it was sent to the GPU
+    glFlush();
+
+    pScenario->m_lastDrawTime = std::chrono::steady_clock::now() - startTime;
+}
+
+void VideoWall::present(std::size_t panel, GLuint framebuffer, glm::ivec4 const& viewport)
+{
+    DoubleFramebuffer& doubleFramebuffer = *m_panels[panel].pDoubleFramebuffer;
+    if (doubleFramebuffer.noPreviousFrame) return;
+    auto [pProgram, err] = doubleFramebuffer.presentProgram();
+    if (err != nil)
+    {
+        std::cerr << "could not present video wall panel " << panel << ": " << err.value() << std::endl;
+        return;
+    }
+
+    if (m_drawn) glWaitSync(m_drawn, 0, GL_TIMEOUT_IGNORED);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glViewport(viewport.x, viewport.y, viewport.z, viewport.w);
+    doubleFramebuffer.useQuadProgram(*pProgram);
+    // the frame drawPreviousFrame() fades from is the last one finished
+    doubleFramebuffer.drawPreviousFrame(*pProgram, doubleFramebuffer.blurStandardDeviationOnBlitAndSwap(), 1.0f);
+    doubleFramebuffer.unuseQuadProgram(*pProgram);
+}
+
+RenderTarget const& VideoWall::lastFrame(std::size_t panel) const
+{
+    return m_panels[panel].pDoubleFramebuffer->lastFrame();
+}
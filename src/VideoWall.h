@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Error.h"
+#include "RenderTargetPool.h"
+#include "Scenario.h"
+#include "SegmentBins.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+struct BulkRenderer;
+struct DoubleFramebuffer;
+
+// One scenario spread over several displays, e.g. a wall of monitors. The scenario simulates a
+// canvas covering every panel and the bezels between them and draws nothing itself (see
+// Scenario::Options::ownFramebuffers); every panel keeps feedback framebuffers of its own size.
+// draw() sorts the segments of the last step into coarse bins over the canvas so that each panel
+// uploads and draws only the segments near it.
+// Everything but present() runs in the context make() ran in. present() shows a panel's latest
+// frame in any context sharing objects with that one, e.g. the window on the panel's monitor,
+// using nothing but the shared programs, buffers and textures.
+struct VideoWall
+{
+    struct Panel
+    {
+        // x, y, width, height of the panel's pixels on the canvas, y down from the canvas' top left
+        glm::ivec4 viewport;
+    };
+
+    // The canvas is the bounding box of the panels. options.ownFramebuffers is ignored. Needs the GL context.
+    static std::pair<std::shared_ptr<VideoWall>, Error> make(std::vector<Panel> const& panels, std::size_t initialTraceCount, Scenario::Options options);
+    ~VideoWall();
+
+    void step();
+    // draws every panel's next frame
+    void draw();
+    // Draws panel's latest frame into viewport (x, y, width, height) of framebuffer, in the current
+    // context; it must share objects with make()'s and only waits for draw() on the GPU.
+    void present(std::size_t panel, GLuint framebuffer, glm::ivec4 const& viewport);
+
+    std::size_t panelCount() const { return m_panels.size(); }
+    RenderTarget const& lastFrame(std::size_t panel) const;
+    // segments the panel drew in the last draw()
+    std::size_t lastSegmentCount(std::size_t panel) const { return m_panels[panel].segmentCount; }
+
+    // side of the bins, in canvas pixels
+    static int const kBinPixels;
+
+    std::shared_ptr<Scenario> pScenario;
+    glm::ivec2 canvasSize{};
+
+private:
+    struct PanelOutput
+    {
+        Panel panel;
+        // the canvas rectangle the panel shows, in monometric coordinates
+        glm::vec2 lower;
+        glm::vec2 upper;
+        std::shared_ptr<DoubleFramebuffer> pDoubleFramebuffer;
+        std::shared_ptr<BulkRenderer> pBulkRenderer;
+        std::size_t segmentCount{0};
+    };
+
+    std::vector<PanelOutput> m_panels;
+    glm::vec2 m_canvasLower{};
+    glm::vec2 m_canvasUpper{};
+    std::vector<glm::vec2> m_segmentVertices;
+    std::vector<glm::vec2> m_points;
+    SegmentBins m_segmentBins;
+    SegmentBins m_pointBins;
+    // signalled once the GPU finished the last draw(), for present() in other contexts
+    GLsync m_drawn{nullptr};
+};
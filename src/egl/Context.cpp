@@ -0,0 +1,130 @@
+#include "Context.h"
+#include <GL/glew.h>
+#include <EGL/eglext.h>
+#include <cstring>
+#include <string>
+
+using namespace egl;
+
+namespace {
+
+bool hasExtension(char const* extensions, char const* name)
+{
+    if (!extensions) return false;
+    std::size_t const length = std::strlen(name);
+    for (char const* p = std::strstr(extensions, name); p; p = std::strstr(p + length, name))
+    {
+        bool startsWord = p == extensions || p[-1] == ' ';
+        bool endsWord = p[length] == ' ' || p[length] == '\0';
+        if (startsWord && endsWord) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+std::pair<std::shared_ptr<Context>, Error> Context::make()
+{
+    std::shared_ptr<Context> pContext{new (std::nothrow) Context()};
+    if (!pContext) return std::make_pair(nullptr, makeError("could not instantiate egl::Context"));
+
+    // surfaceless needs neither a window system nor a GPU with display outputs
+    char const* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay && hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+    {
+        pContext->display_ = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (pContext->display_ == EGL_NO_DISPLAY)
+    {
+        pContext->display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (pContext->display_ == EGL_NO_DISPLAY || !eglInitialize(pContext->display_, nullptr, nullptr))
+    {
+        pContext->display_ = EGL_NO_DISPLAY;
+        return std::make_pair(nullptr, makeError("could not initialize an EGL display, error ", eglGetError()));
+    }
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        return std::make_pair(nullptr, makeError("EGL display does not support desktop OpenGL"));
+    }
+
+    pContext->surfaceless_ = hasExtension(eglQueryString(pContext->display_, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+    EGLint const configAttributes[] = {
+        EGL_SURFACE_TYPE, pContext->surfaceless_ ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount{0};
+    if (!eglChooseConfig(pContext->display_, configAttributes, &config, 1, &configCount) || configCount == 0)
+    {
+        return std::make_pair(nullptr, makeError("no EGL config for an RGBA8 OpenGL context"));
+    }
+
+    // compatibility profile like the GLFW default context, the renderers draw without a vertex array object
+    EGLint const contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 5,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+        EGL_NONE
+    };
+    pContext->context_ = eglCreateContext(pContext->display_, config, EGL_NO_CONTEXT, contextAttributes);
+    if (pContext->context_ == EGL_NO_CONTEXT)
+    {
+        return std::make_pair(nullptr, makeError("could not create an OpenGL 4.5 context, error ", eglGetError()));
+    }
+
+    if (!pContext->surfaceless_)
+    {
+        EGLint const pbufferAttributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        pContext->surface_ = eglCreatePbufferSurface(pContext->display_, config, pbufferAttributes);
+        if (pContext->surface_ == EGL_NO_SURFACE)
+        {
+            return std::make_pair(nullptr, makeError("could not create pbuffer surface, error ", eglGetError()));
+        }
+    }
+
+    pContext->select();
+    if (eglGetCurrentContext() != pContext->context_)
+    {
+        return std::make_pair(nullptr, makeError("could not make the EGL context current, error ", eglGetError()));
+    }
+
+    glewExperimental = GL_TRUE;
+    GLenum glewError = glewInit();
+    // GLEW built for GLX reports the missing X display, but the GL entry points are loaded regardless
+    if (glewError != GLEW_OK && glewError != GLEW_ERROR_NO_GLX_DISPLAY)
+    {
+        return std::make_pair(nullptr, makeError("could not initialize GLEW: ", glewGetErrorString(glewError)));
+    }
+
+    return std::make_pair(pContext, nil);
+}
+
+Context::~Context()
+{
+    if (display_ == EGL_NO_DISPLAY) return;
+    if (eglGetCurrentContext() == context_)
+    {
+        eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+    if (surface_ != EGL_NO_SURFACE) eglDestroySurface(display_, surface_);
+    if (context_ != EGL_NO_CONTEXT) eglDestroyContext(display_, context_);
+    // the display is not terminated, other contexts of the process may still be using it
+}
+
+void Context::select()
+{
+    if (context_ == EGL_NO_CONTEXT) return;
+    eglMakeCurrent(display_, surface_, surface_, context_);
+}
+
+bool Context::isSurfaceless() const
+{
+    return surfaceless_;
+}
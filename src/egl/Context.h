@@ -0,0 +1,25 @@
+#pragma once
+
+#include "../Error.h"
+#include <EGL/egl.h>
+#include <memory>
+#include <utility>
+
+namespace egl {
+// Offscreen OpenGL 4.5 context for hosts without a window system. Prefers the Mesa surfaceless
+// platform and falls back to a 1x1 pbuffer on the default display. There is no default framebuffer
+// to draw on, everything renders into framebuffer objects.
+struct Context
+{
+    static std::pair<std::shared_ptr<Context>, Error> make();
+    ~Context();
+
+    void select();
+    bool isSurfaceless() const;
+
+    EGLDisplay display_{EGL_NO_DISPLAY};
+    EGLContext context_{EGL_NO_CONTEXT};
+    EGLSurface surface_{EGL_NO_SURFACE};
+    bool surfaceless_{false};
+};
+} // namespace egl
@@ -2,12 +2,27 @@
 #include "../Utils.h"
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
-#include <thread>
 
 using namespace glfw;
 
+namespace {
+
+std::chrono::nanoseconds primaryMonitorRefreshPeriod()
+{
+    GLFWmonitor* pMonitor = glfwGetPrimaryMonitor();
+    GLFWvidmode const* pVideoMode = pMonitor ? glfwGetVideoMode(pMonitor) : nullptr;
+    if (!pVideoMode || pVideoMode->refreshRate <= 0) return periodMs();
+    return std::chrono::nanoseconds{1'000'000'000 / pVideoMode->refreshRate};
+}
+
+} // namespace
+
 Window::Window(int width, int height, std::string const& title, bool borderless)
-    : swapPeriodMs_{periodMs()}
+    : Window{width, height, title, borderless, nullptr}
+{}
+
+Window::Window(int width, int height, std::string const& title, bool borderless, GLFWwindow* pShare)
+    : pacer_{primaryMonitorRefreshPeriod()}
     , width_{width}
     , height_{height}
 {
@@ -17,7 +32,7 @@ Window::Window(int width, int height, std::string const& title, bool borderless)
     }
     glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
     //glfwWindowHint(GLFW_SAMPLES, 4);
-    pWindow_ = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+    pWindow_ = glfwCreateWindow(width, height, title.c_str(), nullptr, pShare);
     select();
     glewInit();
     glfwSwapInterval(1);
@@ -64,18 +79,25 @@ void Window::pollEvents()
     glfwPollEvents();
 }
 
+void Window::beginFrame()
+{
+    pacer_.beginFrame();
+}
+
 void Window::present()
 {
     if (!pWindow_) return;
-//    auto now = std::chrono::steady_clock::now();
-//    if (!lastSwapTime_ || (now - lastSwapTime_.value()) >= swapPeriodMs_)
-//    {
-//        lastSwapTime_ = now;
-//        glfwSwapBuffers(pWindow_);
-//        return;
-//    }
-//    std::this_thread::sleep_until(lastSwapTime_.value() + swapPeriodMs_);
+    pacer_.beforePresent();
     glfwSwapBuffers(pWindow_);
+    pacer_.afterPresent();
+}
+
+void Window::setSwapInterval(int interval)
+{
+    if (!pWindow_) return;
+    select();
+    glfwSwapInterval(interval);
+    pacer_.setPacing(interval > 0);
 }
 
 void Window::setFullscreen(bool fullscreen)
@@ -87,6 +109,12 @@ void Window::setFullscreen(bool fullscreen)
                          GLFW_DONT_CARE);
 }
 
+void Window::setFullscreen(GLFWmonitor* pMonitor)
+{
+    if (!pWindow_) return;
+    glfwSetWindowMonitor(pWindow_, pMonitor, 0, 0, width_, height_, GLFW_DONT_CARE);
+}
+
 Window::operator bool()
 {
     return pWindow_ != nullptr;
@@ -1,15 +1,17 @@
 #pragma once
 
-#include <chrono>
-#include <optional>
+#include "../FramePacer.h"
 #include <string>
 
+struct GLFWmonitor;
 struct GLFWwindow;
 
 namespace glfw {
 struct Window
 {
     Window(int width, int height, std::string const& title, bool borderless);
+    // the window's context shares programs, buffers and textures with pShare's
+    Window(int width, int height, std::string const& title, bool borderless, GLFWwindow* pShare);
 
     Window(int width, int height);
     Window(int width, int height, std::string const& title);
@@ -26,15 +28,22 @@ struct Window
 
     void pollEvents();
 
+    // waits for the latest start of a frame that still makes the next refresh, see FramePacer
+    void beginFrame();
+
     void present();
 
+    // of the window's context; 0 presents at once and turns the pacing off
+    void setSwapInterval(int interval);
+
     void setFullscreen(bool fullscreen);
+    // fullscreen on pMonitor at the window's size
+    void setFullscreen(GLFWmonitor* pMonitor);
 
     operator bool();
 
     GLFWwindow* pWindow_{};
-    std::optional<std::chrono::steady_clock::time_point> lastSwapTime_;
-    std::chrono::milliseconds swapPeriodMs_;
+    FramePacer pacer_;
     int width_;
     int height_;
 };
@@ -1,29 +1,466 @@
 #include "BulkRenderer.h"
 #include "DoubleFramebuffer.h"
 #include "Error.h"
+#include "FramePacer.h"
+#include "FrameReadback.h"
+#include "FrameSink.h"
 #include "Scenario.h"
+#include "TiledCanvas.h"
 #include "Trace.h"
 #include "TraceFactory.h"
 #include "Utils.h"
+#include "VideoWall.h"
 #include "glfw/Lifecycle.h"
 #include "glfw/Window.h"
+#ifdef TRACES_HAS_EGL
+#include "egl/Context.h"
+#endif
 
 
 #include <glm/glm.hpp>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <memory>
 #include <optional>
 #include <string>
 #include <utility>
+#include <vector>
 
 using namespace std::chrono_literals;
 
+struct OfflineOptions
+{
+    std::string sinkSpec;
+    bool headless{false};
+    glm::ivec2 size{3840, 2160};
+    std::size_t frames{600};
+    int framesPerSecond{60};
+};
+
+// [--headless] [--export png:<pattern>|y4m|rgba] [--size WxH] [--frames N] [--fps F]
+std::pair<std::optional<OfflineOptions>, Error> parseOfflineOptions(int argc, char* argv[])
+{
+    OfflineOptions offlineOptions;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--headless") == 0)
+        {
+            offlineOptions.headless = true;
+        }
+        else if (std::strcmp(argv[i], "--export") == 0 && hasValue)
+        {
+            offlineOptions.sinkSpec = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--size") == 0 && hasValue)
+        {
+            if (std::sscanf(argv[++i], "%dx%d", &offlineOptions.size.x, &offlineOptions.size.y) != 2
+                || offlineOptions.size.x <= 0 || offlineOptions.size.y <= 0)
+            {
+                return std::make_pair(std::nullopt, makeError("invalid --size", argv[i], "(expected WxH)"));
+            }
+        }
+        else if (std::strcmp(argv[i], "--frames") == 0 && hasValue)
+        {
+            offlineOptions.frames = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--fps") == 0 && hasValue)
+        {
+            offlineOptions.framesPerSecond = std::atoi(argv[++i]);
+            if (offlineOptions.framesPerSecond <= 0) return std::make_pair(std::nullopt, makeError("invalid --fps", argv[i]));
+        }
+        else
+        {
+            return std::make_pair(std::nullopt, makeError("unknown argument", argv[i]));
+        }
+    }
+    if (!offlineOptions.headless && offlineOptions.sinkSpec.empty()) return std::make_pair(std::nullopt, nil);
+    return std::make_pair(offlineOptions, nil);
+}
+
+// one line of a window's FramePacer statistics over interval
+void printPacing(FramePacer::Statistics const& statistics, std::chrono::nanoseconds interval)
+{
+    auto milliseconds = [](std::chrono::nanoseconds time) { return time.count() / 1e6; };
+    std::cout << std::fixed << std::setprecision(2) << statistics.frames / (interval.count() / 1e9) << "fps"
+              << ", refresh " << milliseconds(statistics.refreshPeriod) << "ms" << (statistics.vsync ? "" : " (no vsync, self-paced)")
+              << ", interval " << milliseconds(statistics.meanInterval) << "ms +-" << milliseconds(statistics.intervalJitter)
+              << " max " << milliseconds(statistics.maxInterval)
+              << ", missed refreshes " << statistics.missedRefreshes
+              << ", work " << milliseconds(statistics.meanWork) << "ms max " << milliseconds(statistics.maxWork)
+              << ", input to photon " << milliseconds(statistics.meanLatency) << "ms max " << milliseconds(statistics.maxLatency)
+              << std::defaultfloat << std::endl;
+}
+
+void printFrameTimes(std::vector<std::chrono::nanoseconds> frameTimes)
+{
+    if (frameTimes.empty()) return;
+    std::sort(frameTimes.begin(), frameTimes.end());
+    auto milliseconds = [](std::chrono::nanoseconds time) { return time.count() / 1e6; };
+    std::chrono::nanoseconds total{0};
+    for (auto frameTime : frameTimes) total += frameTime;
+    std::cerr << "frame time ms: mean " << milliseconds(total / frameTimes.size())
+              << " p50 " << milliseconds(frameTimes[frameTimes.size() / 2])
+              << " p99 " << milliseconds(frameTimes[frameTimes.size() * 99 / 100])
+              << " max " << milliseconds(frameTimes.back()) << std::endl;
+}
+
+// Renders offlineOptions.frames frames with a fixed simulation step as fast as the GPU (and the
+// encoder, when exporting) allow and reports the timing. Without a window the frames only go to the
+// sink; output goes to stderr since the frames may go to stdout.
+int runOffline(OfflineOptions const& offlineOptions)
+{
+    std::optional<glfw::Lifecycle> lc;
+    std::optional<glfw::Window> w;
+#ifdef TRACES_HAS_EGL
+    std::shared_ptr<egl::Context> pContext;
+#endif
+    if (offlineOptions.headless)
+    {
+#ifdef TRACES_HAS_EGL
+        Error contextErr;
+        std::tie(pContext, contextErr) = egl::Context::make();
+        if (contextErr != nil)
+        {
+            std::cerr << "could not make headless context: " << contextErr.value() << std::endl;
+            return -2;
+        }
+        std::cerr << "headless " << (pContext->isSurfaceless() ? "surfaceless" : "pbuffer") << " context on "
+                  << glGetString(GL_RENDERER) << std::endl;
+#else
+        std::cerr << "built without EGL, --headless is unavailable" << std::endl;
+        return -2;
+#endif
+    }
+    else
+    {
+        lc.emplace();
+        w.emplace(64, 64);
+        w->select();
+    }
+
+    Scenario::Options options;
+    options.color = glm::vec3{1.0, 0.0, 1.0};
+    options.stepPeriod = std::chrono::milliseconds{1000 / offlineOptions.framesPerSecond};
+    // offline frames are not bound by wall time, so the population may grow to its cap
+    options.frameBudgetFraction = 1e6f;
+    options.offscreen = offlineOptions.headless;
+    auto [pScenario, err] = Scenario::make(20, offlineOptions.size, options);
+    if (err != nil)
+    {
+        std::cerr << "could not make Scenario: " << err.value() << std::endl;
+        return -2;
+    }
+
+    std::shared_ptr<FrameReadback> pReadback;
+    if (!offlineOptions.sinkSpec.empty())
+    {
+        auto [pSink, sinkErr] = makeFrameSink(offlineOptions.sinkSpec, offlineOptions.framesPerSecond);
+        if (sinkErr != nil)
+        {
+            std::cerr << "could not make frame sink: " << sinkErr.value() << std::endl;
+            return -2;
+        }
+        std::tie(pReadback, err) = FrameReadback::make(offlineOptions.size, pSink);
+        if (err != nil)
+        {
+            std::cerr << "could not make frame readback: " << err.value() << std::endl;
+            return -2;
+        }
+    }
+
+    std::vector<std::chrono::nanoseconds> frameTimes;
+    frameTimes.reserve(offlineOptions.frames);
+    auto startTime = std::chrono::steady_clock::now();
+    for (std::size_t frame = 0; frame < offlineOptions.frames; frame++)
+    {
+        auto frameStartTime = std::chrono::steady_clock::now();
+        pScenario->step();
+        pScenario->draw();
+        if (pReadback)
+        {
+            err = pReadback->capture(pScenario->m_pDoubleFramebuffer->lastFrame().framebuffer);
+            if (err != nil)
+            {
+                std::cerr << "could not capture frame " << frame << ": " << err.value() << std::endl;
+                return -3;
+            }
+        }
+        else
+        {
+            // nothing waits for the GPU otherwise, the frame times would only measure submission
+            glFinish();
+        }
+        frameTimes.push_back(std::chrono::steady_clock::now() - frameStartTime);
+        if ((frame + 1) % 100 == 0) std::cerr << "rendered " << frame + 1 << "/" << offlineOptions.frames << " frames" << std::endl;
+    }
+    if (pReadback)
+    {
+        err = pReadback->finish();
+        if (err != nil)
+        {
+            std::cerr << "could not finish export: " << err.value() << std::endl;
+            return -3;
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+    std::cerr << "rendered " << offlineOptions.frames << " frames of " << offlineOptions.size.x << "x" << offlineOptions.size.y
+              << " in " << elapsed.count() << "s, " << offlineOptions.frames / elapsed.count() << "fps, "
+              << pScenario->m_vpTraces.size() << " traces at the end" << std::endl;
+    printFrameTimes(std::move(frameTimes));
+    return 0;
+}
+
+struct WallOptions
+{
+    // canvas pixels hidden behind the frames between neighbouring monitors
+    glm::ivec2 bezelPixels{0, 0};
+};
+
+// --wall [--bezel WxH]
+std::pair<std::optional<WallOptions>, Error> parseWallOptions(int argc, char* argv[])
+{
+    if (argc < 2 || std::strcmp(argv[1], "--wall") != 0) return std::make_pair(std::nullopt, nil);
+    WallOptions wallOptions;
+    for (int i = 2; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--bezel") == 0 && i + 1 < argc)
+        {
+            if (std::sscanf(argv[++i], "%dx%d", &wallOptions.bezelPixels.x, &wallOptions.bezelPixels.y) != 2
+                || wallOptions.bezelPixels.x < 0 || wallOptions.bezelPixels.y < 0)
+            {
+                return std::make_pair(std::nullopt, makeError("invalid --bezel", argv[i], "(expected WxH)"));
+            }
+        }
+        else
+        {
+            return std::make_pair(std::nullopt, makeError("unknown argument", argv[i]));
+        }
+    }
+    return std::make_pair(wallOptions, nil);
+}
+
+// One scenario over every connected monitor, each showing its part of a canvas laid out as the
+// monitors are on the desktop, with the bezels between the monitors' columns and rows added in.
+int runWall(WallOptions const& wallOptions)
+{
+    glfw::Lifecycle lc;
+    int monitorCount{0};
+    GLFWmonitor** ppMonitors = glfwGetMonitors(&monitorCount);
+    if (monitorCount == 0)
+    {
+        std::cout << "could not make video wall: no monitors" << std::endl;
+        return -2;
+    }
+
+    std::vector<VideoWall::Panel> panels;
+    std::vector<int> columns;
+    std::vector<int> rows;
+    for (int i = 0; i < monitorCount; i++)
+    {
+        glm::ivec2 position{0, 0};
+        glfwGetMonitorPos(ppMonitors[i], &position.x, &position.y);
+        auto pVideoMode{glfwGetVideoMode(ppMonitors[i])};
+        if (!pVideoMode)
+        {
+            std::cout << "could not make video wall: no video mode on monitor " << i << std::endl;
+            return -2;
+        }
+        panels.push_back(VideoWall::Panel{glm::ivec4{position.x, position.y, pVideoMode->width, pVideoMode->height}});
+        columns.push_back(position.x);
+        rows.push_back(position.y);
+    }
+    std::sort(columns.begin(), columns.end());
+    columns.erase(std::unique(columns.begin(), columns.end()), columns.end());
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    for (auto& panel : panels)
+    {
+        auto column = std::lower_bound(columns.begin(), columns.end(), panel.viewport.x) - columns.begin();
+        auto row = std::lower_bound(rows.begin(), rows.end(), panel.viewport.y) - rows.begin();
+        panel.viewport.x += static_cast<int>(column) * wallOptions.bezelPixels.x;
+        panel.viewport.y += static_cast<int>(row) * wallOptions.bezelPixels.y;
+    }
+
+    // every window shares the first one's objects, only the last one waits for the vertical blank
+    std::vector<std::unique_ptr<glfw::Window>> windows;
+    for (int i = 0; i < monitorCount; i++)
+    {
+        GLFWwindow* pShare = windows.empty() ? nullptr : windows.front()->pWindow_;
+        windows.push_back(std::make_unique<glfw::Window>(panels[i].viewport.z, panels[i].viewport.w, "", true, pShare));
+        if (!*windows.back())
+        {
+            std::cout << "could not open window on monitor " << i << std::endl;
+            return -2;
+        }
+        windows.back()->setFullscreen(ppMonitors[i]);
+        if (i + 1 < monitorCount) windows.back()->setSwapInterval(0);
+    }
+
+    windows.front()->select();
+    Scenario::Options options;
+    options.color = glm::vec3{1.0, 0.0, 1.0};
+    auto [pWall, err] = VideoWall::make(panels, 20, options);
+    if (err != nil)
+    {
+        std::cout << "could not make video wall: " << err.value() << std::endl;
+        return -2;
+    }
+    std::cout << "video wall of " << monitorCount << " monitors, canvas " << pWall->canvasSize.x << "x" << pWall->canvasSize.y << std::endl;
+    for (auto& pWindow : windows) pWindow->show();
+
+    auto anyClosed = [&windows]
+    {
+        return std::any_of(windows.begin(), windows.end(), [](auto const& pWindow) { return pWindow->shouldClose(); });
+    };
+    while (!anyClosed())
+    {
+        windows.back()->beginFrame();
+        windows.front()->pollEvents();
+        pWall->step();
+        windows.front()->select();
+        pWall->draw();
+        for (std::size_t i = 0; i < windows.size(); i++)
+        {
+            windows[i]->select();
+            pWall->present(i, 0, glm::ivec4{0, 0, panels[i].viewport.z, panels[i].viewport.w});
+            windows[i]->present();
+        }
+    }
+    // the wall's objects go with the first window's context
+    windows.front()->select();
+    pWall.reset();
+    return 0;
+}
+
+struct CanvasOptions
+{
+    glm::ivec2 worldSize{};
+    std::size_t maxTiles{TiledCanvas::kDefaultMaxTiles};
+};
+
+// --canvas WxH [--tiles N]
+std::pair<std::optional<CanvasOptions>, Error> parseCanvasOptions(int argc, char* argv[])
+{
+    if (argc < 2 || std::strcmp(argv[1], "--canvas") != 0) return std::make_pair(std::nullopt, nil);
+    CanvasOptions canvasOptions;
+    if (argc < 3 || std::sscanf(argv[2], "%dx%d", &canvasOptions.worldSize.x, &canvasOptions.worldSize.y) != 2
+        || canvasOptions.worldSize.x <= 0 || canvasOptions.worldSize.y <= 0)
+    {
+        return std::make_pair(std::nullopt, makeError("invalid --canvas", argc < 3 ? "" : argv[2], "(expected WxH)"));
+    }
+    for (int i = 3; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--tiles") == 0 && i + 1 < argc)
+        {
+            long maxTiles = std::strtol(argv[++i], nullptr, 10);
+            if (maxTiles <= 0) return std::make_pair(std::nullopt, makeError("invalid --tiles", argv[i]));
+            canvasOptions.maxTiles = static_cast<std::size_t>(maxTiles);
+        }
+        else
+        {
+            return std::make_pair(std::nullopt, makeError("unknown argument", argv[i]));
+        }
+    }
+    return std::make_pair(canvasOptions, nil);
+}
+
+namespace {
+
+// scroll wheel steps since runCanvas() last zoomed
+double g_canvasScroll{0.0};
+
+} // namespace
+
+// One scenario over a world larger than the screen; dragging with the mouse pans, the wheel zooms.
+int runCanvas(CanvasOptions const& canvasOptions)
+{
+    glfw::Lifecycle lc;
+    auto [videoMode, err] = getMonitorCurrentVideoMode();
+    if (err != nil)
+    {
+        std::cout << "could not get current monitor video mode:" << err.value();
+        return -2;
+    }
+
+    glfw::Window w{videoMode.x, videoMode.y, true};
+    w.setFullscreen(true);
+    w.select();
+    glfwSetScrollCallback(w.pWindow_, [](GLFWwindow*, double, double yOffset) { g_canvasScroll += yOffset; });
+
+    Scenario::Options options;
+    options.color = glm::vec3{1.0, 0.0, 1.0};
+    std::shared_ptr<TiledCanvas> pCanvas;
+    std::tie(pCanvas, err) = TiledCanvas::make(videoMode, canvasOptions.worldSize, 20, options, canvasOptions.maxTiles);
+    if (err != nil)
+    {
+        std::cout << "could not make tiled canvas: " << err.value() << std::endl;
+        return -2;
+    }
+    w.show();
+
+    std::optional<glm::vec2> dragFrom;
+    while (w && !w.shouldClose())
+    {
+        w.beginFrame();
+        w.pollEvents();
+        glm::vec2 cursor = getMouseCursorPosition(w.pWindow_);
+        if (glfwGetMouseButton(w.pWindow_, GLFW_MOUSE_BUTTON_1) == GLFW_PRESS)
+        {
+            if (dragFrom) pCanvas->pan(cursor - dragFrom.value());
+            dragFrom = cursor;
+        }
+        else
+        {
+            dragFrom.reset();
+        }
+        if (g_canvasScroll != 0.0)
+        {
+            pCanvas->zoomAt(cursor, static_cast<float>(std::pow(1.1, g_canvasScroll)));
+            g_canvasScroll = 0.0;
+        }
+
+        pCanvas->step();
+        pCanvas->draw();
+        w.present();
+    }
+    return 0;
+}
+
 int main(int argc, char* argv[])
 {
+    auto [wallOptions, wallErr] = parseWallOptions(argc, argv);
+    if (wallErr != nil)
+    {
+        std::cerr << wallErr.value() << std::endl;
+        return -1;
+    }
+    if (wallOptions) return runWall(wallOptions.value());
+
+    auto [canvasOptions, canvasErr] = parseCanvasOptions(argc, argv);
+    if (canvasErr != nil)
+    {
+        std::cerr << canvasErr.value() << std::endl;
+        return -1;
+    }
+    if (canvasOptions) return runCanvas(canvasOptions.value());
+
+    auto [offlineOptions, argErr] = parseOfflineOptions(argc, argv);
+    if (argErr != nil)
+    {
+        std::cerr << argErr.value() << std::endl;
+        return -1;
+    }
+    if (offlineOptions) return runOffline(offlineOptions.value());
+
     glfw::Lifecycle lc;
     Error err;
     glm::ivec2 videoMode;
@@ -46,6 +483,7 @@ int main(int argc, char* argv[])
     std::shared_ptr<Scenario> pScenario;
     Scenario::Options options;
     options.color = glm::vec3{1.0, 0.0, 1.0};
+    options.adaptiveQuality = true;
     std::tie(pScenario, err) = Scenario::make(20, videoMode, options);
     if (err != nil)
     {
@@ -56,42 +494,20 @@ int main(int argc, char* argv[])
     w.show();
 
 
-    std::optional<std::chrono::steady_clock::time_point> then;
-    std::size_t missedDeadlines = 0;
-    std::size_t totalIterations = 0;
-
-    bool missedDeadlinesPrinted{false};
-    int partialIterations{0};
-    std::optional<std::chrono::steady_clock::time_point> lastFpsPrint;
-
+    std::optional<std::chrono::steady_clock::time_point> lastStatisticsPrint;
     while (w && !w.shouldClose())
     {
-        ++totalIterations;
-        ++partialIterations;
+        w.beginFrame();
         auto now = std::chrono::steady_clock::now();
-        if (then)
+        if (!lastStatisticsPrint) lastStatisticsPrint = now;
+        if (now - lastStatisticsPrint.value() >= 1s)
         {
-            auto overTime = (now - then.value()).count() / 1'000'000 - periodMs().count();
-            if (overTime > 0)
-            {
-                missedDeadlinesPrinted = false;
-                missedDeadlines++;
-            }
-            if (missedDeadlines % 50 == 0)
-            {
-                missedDeadlinesPrinted = true;
-                std::cout << now.time_since_epoch().count() / 1'000'000 << " MISSED DEADLINES " //<< std::setw(5) << std::setprecision(5)
-                          << 100.0 * static_cast<double>(missedDeadlines) / totalIterations << "%" << std::endl;
-            }
-            auto fpsInterval = now - lastFpsPrint.value_or(now);
-            if (!lastFpsPrint || fpsInterval >= 1s)
-            {
-                std::cout << now.time_since_epoch().count() / 1e9 << " " << partialIterations / (fpsInterval.count()/1e9) << "fps" << std::endl;
-                partialIterations = 0;
-                lastFpsPrint = now;
-            }
+            printPacing(w.pacer_.takeStatistics(), now - lastStatisticsPrint.value());
+            auto renderSize = pScenario->m_pDoubleFramebuffer->renderSize();
+            std::cout << "    quality level " << pScenario->m_qualityGovernor->levelIndex()
+                      << " (" << renderSize.x << "x" << renderSize.y << ")" << std::endl;
+            lastStatisticsPrint = now;
         }
-        then = now;
         w.pollEvents();
 
         pScenario->step();
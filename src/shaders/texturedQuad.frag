@@ -3,11 +3,19 @@ R"(
 
 uniform sampler2D frameTexture;
 in vec2 vertexShaderPosition;
+#ifdef BLUR
 uniform float standardDeviation;
-uniform float fadeFactor;
 uniform float xCorrection;
+#endif
+#ifdef FADE
+uniform float fadeFactor;
+#endif
+#ifdef FADE_TO_BLACK
+uniform float fadeStep;
+#endif
 out vec4 color;
 
+#ifdef BLUR
 float PI = 3.14159265359;
 float E = 2.71828182846;
 
@@ -16,40 +24,42 @@ float gaussian(in vec2 p, in float sigmaSquare)
     float exponent = - (p.x * p.x + p.y * p.y) / (2.0 * sigmaSquare);
     return (1.0 / 2.0 * PI * sigmaSquare) * exp(exponent);
 }
+#endif
 
 void main()
 {
-    //failsafe so we can use turn off the blur by setting the deviation to 0
     vec2 texCoords = 0.5 * (vertexShaderPosition + 1.0);
-    if(standardDeviation <= 0)
-    {
-        color = texture2D(frameTexture, texCoords);
-    }
-    else
-    {
-        float support = 1.0 * standardDeviation;
-        float magnitudeStep = 0.5 * standardDeviation;
+#ifdef BLUR
+    float support = 1.0 * standardDeviation;
+    float magnitudeStep = 0.5 * standardDeviation;
 
-        float sigmaSquare = standardDeviation * standardDeviation;
+    float sigmaSquare = standardDeviation * standardDeviation;
 
-        float factor = gaussian(vec2(0), sigmaSquare);
-        vec3     rgb = texture2D(frameTexture, texCoords).rgb * factor;
-        float    sum = factor;
+    float factor = gaussian(vec2(0), sigmaSquare);
+    vec3     rgb = texture(frameTexture, texCoords).rgb * factor;
+    float    sum = factor;
 
-        for (float magnitude = magnitudeStep; magnitude <= support / 2.0; magnitude += magnitudeStep)
+    for (float magnitude = magnitudeStep; magnitude <= support / 2.0; magnitude += magnitudeStep)
+    {
+        for (float theta = 0; theta <= 2 * PI; theta += PI/2.0)
         {
-            for (float theta = 0; theta <= 2 * PI; theta += PI/2.0)
-            {
-                vec2 v = magnitude * vec2(xCorrection * cos(theta), sin(theta));
-                factor = gaussian(v, sigmaSquare);
-                rgb += texture2D(frameTexture, texCoords + v).rgb * factor;
-                sum += factor;
-            }
+            vec2 v = magnitude * vec2(xCorrection * cos(theta), sin(theta));
+            factor = gaussian(v, sigmaSquare);
+            rgb += texture(frameTexture, texCoords + v).rgb * factor;
+            sum += factor;
         }
-
-        float makesItBrighter = 1.2; // CHEAT, but otherwise the traces are too faint
-        color = vec4(rgb/sum * makesItBrighter, 1.0);
     }
-    color = vec4(color.rgb * fadeFactor, 1.0);
+
+    float makesItBrighter = 1.2; // CHEAT, but otherwise the traces are too faint
+    color = vec4(rgb/sum * makesItBrighter, 1.0);
+#else
+    color = vec4(texture(frameTexture, texCoords).rgb, 1.0);
+#endif
+#ifdef FADE
+    color.rgb *= fadeFactor;
+#endif
+#ifdef FADE_TO_BLACK
+    color.rgb = max(color.rgb - fadeStep, 0.0);
+#endif
 }
 )"
@@ -2,10 +2,19 @@ R"(
 #version 450
 
 uniform vec3 color;
+#ifdef COLOR_GRADIENT
+uniform vec3 secondaryColor;
+in float gradientPosition;
+#endif
+out vec4 fragmentColor;
 
 void main()
 {
-    gl_FragColor = vec4(color, 1.0);
+#ifdef COLOR_GRADIENT
+    fragmentColor = vec4(mix(color, secondaryColor, gradientPosition), 1.0);
+#else
+    fragmentColor = vec4(color, 1.0);
+#endif
 }
 )"
 
@@ -3,10 +3,18 @@ R"(
 
 in vec2 positionMonometric;
 uniform mat2 toNormalCoordinates;
+uniform vec2 normalOffset;
+#ifdef COLOR_GRADIENT
+out float gradientPosition;
+#endif
 
 void main()
 {
-    gl_Position = vec4(toNormalCoordinates * positionMonometric, 0.0, 1.0);
+    gl_Position = vec4(toNormalCoordinates * positionMonometric + normalOffset, 0.0, 1.0);
+#ifdef COLOR_GRADIENT
+    // from the bottom to the top of the whole window, whichever part of it is drawn
+    gradientPosition = 0.5 * (positionMonometric.y + 1.0);
+#endif
 }
 )"
 
@@ -1,13 +1,20 @@
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "traces_render.h"
 
 static struct TracesScenarioOptions getOptions(int width, int height);
+static int runHeadless(int frames);
 
-int main()
+int main(int argc, char* argv[])
 {
+    if (argc > 1 && strcmp(argv[1], "--headless") == 0)
+    {
+        return runHeadless(argc > 2 ? atoi(argv[2]) : 600);
+    }
+
     glfwInit();
     GLFWmonitor* pMonitor = glfwGetPrimaryMonitor();
     GLFWvidmode const * pVideoMode = glfwGetVideoMode(pMonitor);
@@ -54,9 +61,35 @@ int main()
     return 0;
 }
 
+static int runHeadless(int frames)
+{
+    if (createHeadlessContext() != 0) return 1;
+
+    struct TracesScenarioOptions options = getOptions(1920, 1080);
+    ScenarioHandle h = newScenario(options);
+    if (h == SCENARIO_HANDLE_INVALID) return 1;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < frames; i++)
+    {
+        stepScenario(h);
+        drawScenario(h);
+    }
+    glFinish();
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%d headless frames in %.3fs, FPS: %5.2f\n", frames, seconds, frames / seconds);
+
+    releaseScenario(h);
+    destroyHeadlessContext();
+    return 0;
+}
+
 static struct TracesScenarioOptions getOptions(int width, int height)
 {
-    struct TracesScenarioOptions options;
+    struct TracesScenarioOptions options = {0};
 
     options.colorR = 0.0f;
     options.colorG = 1.0f;
@@ -71,5 +104,7 @@ static struct TracesScenarioOptions getOptions(int width, int height)
     options.splitProbability = 0.4f;
     options.stepPeriodMs = 16;
 
+    options.minSegmentPixels = 1.0f;
+
     return options;
 }
@@ -0,0 +1,154 @@
+#ifndef TRACES_FRAME_RING_H
+#define TRACES_FRAME_RING_H
+
+/* Shared memory ring of rendered frames, see publishScenarioFrames in traces_render.h.
+ *
+ * The ring is one memfd mapping: a TracesFrameRingHeader, then slotCount slots of slotSize bytes, each
+ * a TracesFrameSlotHeader followed by height rows of stride bytes, RGBA8, top row first. Frame n
+ * (counting from 1) goes to slot n % slotCount.
+ *
+ * Every slot is a seqlock: its sequence is 2n - 1 while frame n is being written and 2n once it is
+ * complete, and latestFrame is raised to n afterwards. Readers use the pixels in place and check with
+ * tracesFrameRingStillValid afterwards that the writer has not started overwriting them meanwhile,
+ * which takes slotCount - 1 further frames.
+ *
+ * This header is self-contained so that consumers do not need to link the renderer. Linux only. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACES_FRAME_RING_MAGIC "TRCRING"
+#define TRACES_FRAME_RING_VERSION 1u
+#define TRACES_FRAME_RING_FORMAT_RGBA8 1u
+
+struct TracesFrameRingHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t slotCount;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t format;
+    uint32_t reserved;
+    uint64_t slotSize;
+    uint64_t firstSlotOffset;
+    uint64_t latestFrame;
+};
+
+struct TracesFrameSlotHeader
+{
+    uint64_t sequence;
+    uint64_t frame;
+    /* CLOCK_MONOTONIC nanoseconds when the frame was captured on the GPU and published to the ring */
+    uint64_t captureTimeNs;
+    uint64_t publishTimeNs;
+    uint64_t reserved[4];
+};
+
+struct TracesFrameRing
+{
+    void* mapping;
+    size_t mappingSize;
+    struct TracesFrameRingHeader const* header;
+};
+
+struct TracesFrame
+{
+    uint8_t const* pixels;
+    uint64_t frame;
+    uint64_t captureTimeNs;
+    uint64_t publishTimeNs;
+    struct TracesFrameSlotHeader const* slot;
+};
+
+static inline struct TracesFrameSlotHeader const* tracesFrameRingSlot(struct TracesFrameRing const* ring, uint64_t frame)
+{
+    uint8_t const* base = (uint8_t const*)ring->mapping + ring->header->firstSlotOffset;
+    return (struct TracesFrameSlotHeader const*)(base + (frame % ring->header->slotCount) * ring->header->slotSize);
+}
+
+/* Maps the ring behind fd (received over a socket, or opened from /proc/<pid>/fd/<n>).
+ * Returns 0 on success; fd may be closed afterwards. */
+static inline int tracesFrameRingOpen(int fd, struct TracesFrameRing* ring)
+{
+    struct stat status;
+    struct TracesFrameRingHeader const* header;
+    memset(ring, 0, sizeof(*ring));
+    if (fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(struct TracesFrameRingHeader)) return -1;
+    ring->mappingSize = (size_t)status.st_size;
+    ring->mapping = mmap(NULL, ring->mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    if (ring->mapping == MAP_FAILED)
+    {
+        ring->mapping = NULL;
+        return -1;
+    }
+    header = (struct TracesFrameRingHeader const*)ring->mapping;
+    ring->header = header;
+    if (memcmp(header->magic, TRACES_FRAME_RING_MAGIC, sizeof(TRACES_FRAME_RING_MAGIC)) != 0
+        || header->version != TRACES_FRAME_RING_VERSION
+        || header->slotCount == 0
+        || header->slotSize < sizeof(struct TracesFrameSlotHeader) + (uint64_t)header->stride * header->height
+        || header->firstSlotOffset + header->slotSize * header->slotCount > ring->mappingSize)
+    {
+        munmap(ring->mapping, ring->mappingSize);
+        memset(ring, 0, sizeof(*ring));
+        return -1;
+    }
+    return 0;
+}
+
+static inline void tracesFrameRingClose(struct TracesFrameRing* ring)
+{
+    if (ring->mapping) munmap(ring->mapping, ring->mappingSize);
+    memset(ring, 0, sizeof(*ring));
+}
+
+/* Finds the newest complete frame after newerThan. Returns 1 and fills frame, or 0 when there is no
+ * newer frame yet. */
+static inline int tracesFrameRingLatest(struct TracesFrameRing const* ring, uint64_t newerThan, struct TracesFrame* frame)
+{
+    int attempt;
+    for (attempt = 0; attempt < 4; attempt++)
+    {
+        uint64_t latest = __atomic_load_n(&ring->header->latestFrame, __ATOMIC_ACQUIRE);
+        struct TracesFrameSlotHeader const* slot;
+        uint64_t sequence;
+        if (latest == 0 || latest <= newerThan) return 0;
+        slot = tracesFrameRingSlot(ring, latest);
+        sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (sequence != 2 * latest) continue;
+
+        frame->pixels = (uint8_t const*)(slot + 1);
+        frame->frame = slot->frame;
+        frame->captureTimeNs = slot->captureTimeNs;
+        frame->publishTimeNs = slot->publishTimeNs;
+        frame->slot = slot;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == sequence) return 1;
+    }
+    return 0;
+}
+
+/* Returns 1 if frame's pixels were not touched by the writer up to now, i.e. whatever was read from
+ * them since tracesFrameRingLatest is consistent. */
+static inline int tracesFrameRingStillValid(struct TracesFrame const* frame)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&frame->slot->sequence, __ATOMIC_RELAXED) == 2 * frame->frame;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRACES_FRAME_RING_H */
@@ -1,18 +1,99 @@
 #include "traces_render.h"
 
+#include "DoubleFramebuffer.h"
 #include "Error.h"
+#include "FlowField.h"
+#include "ObstacleMask.h"
+#include "GlStateGuard.h"
+#include "HandleTable.h"
 #include "Scenario.h"
+#include "SegmentRecording.h"
+#include "SharedFrameRing.h"
+#ifdef TRACES_HAS_EGL
+#include "egl/Context.h"
+#endif
 
 #include <glm/glm.hpp>
 
 #include <chrono>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <utility>
-#include <unordered_map>
+#include <vector>
 
-static std::unordered_map<ScenarioHandle, std::shared_ptr<Scenario>> g_mapScenarios;
-static std::size_t nextHandle{0};
+static HandleTable<Scenario> g_scenarios;
+
+// cells of the empty field steerScenarioFlowField starts from
+static glm::ivec2 const kDefaultFlowFieldCells{64, 64};
+
+#ifdef TRACES_HAS_EGL
+static std::mutex g_headlessContextMutex;
+static std::shared_ptr<egl::Context> g_pHeadlessContext;
+#endif
+
+// scenarios created in the headless context have no default framebuffer to present to
+static bool headlessContextCurrent()
+{
+#ifdef TRACES_HAS_EGL
+    std::lock_guard<std::mutex> lock{g_headlessContextMutex};
+    return g_pHeadlessContext && eglGetCurrentContext() == g_pHeadlessContext->context_;
+#else
+    return false;
+#endif
+}
+
+// calls f with the live scenarios among handles, holding them until it returns; the storage is
+// kept per thread so that stepping and drawing the same scenarios every frame allocates nothing
+template <typename F>
+static void withScenarios(ScenarioHandle const* handles, size_t count, F&& f)
+{
+    if (!handles) return;
+    thread_local std::vector<HandleTable<Scenario>::Ref> refs;
+    thread_local std::vector<Scenario*> vpScenarios;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        if (auto pScenario = g_scenarios.acquire(handles[i]))
+        {
+            vpScenarios.push_back(pScenario.get());
+            refs.push_back(std::move(pScenario));
+        }
+    }
+    f(vpScenarios.data(), vpScenarios.size());
+    vpScenarios.clear();
+    refs.clear();
+}
+
+int createHeadlessContext()
+{
+#ifdef TRACES_HAS_EGL
+    std::lock_guard<std::mutex> lock{g_headlessContextMutex};
+    if (g_pHeadlessContext)
+    {
+        g_pHeadlessContext->select();
+        return 0;
+    }
+    auto [pContext, err] = egl::Context::make();
+    if (err != nil)
+    {
+        std::cerr << "could not create headless context: " << err.value() << std::endl;
+        return -1;
+    }
+    g_pHeadlessContext = pContext;
+    return 0;
+#else
+    std::cerr << "could not create headless context: built without EGL" << std::endl;
+    return -1;
+#endif
+}
+
+void destroyHeadlessContext()
+{
+#ifdef TRACES_HAS_EGL
+    std::lock_guard<std::mutex> lock{g_headlessContextMutex};
+    g_pHeadlessContext.reset();
+#endif
+}
 
 Scenario::Options toScenarioOptions(TracesScenarioOptions const& c_options)
 {
@@ -22,6 +103,27 @@ Scenario::Options toScenarioOptions(TracesScenarioOptions const& c_options)
     options.splitProbability = c_options.splitProbability;
 
     options.stepPeriod = std::chrono::milliseconds{c_options.stepPeriodMs};
+    options.minSegmentPixels = c_options.minSegmentPixels;
+    if (c_options.lineWidth > 0.0f) options.lineWidth = c_options.lineWidth;
+    options.adaptiveQuality = c_options.adaptiveQuality != 0;
+    options.lineAntialiasing = c_options.lineAntialiasing != 0;
+    if (c_options.colorGradient != 0)
+    {
+        options.colorMode = Scenario::ColorMode::VerticalGradient;
+        options.secondaryColor = glm::vec3{c_options.secondaryColorR, c_options.secondaryColorG, c_options.secondaryColorB};
+    }
+    if (c_options.fadeFactor > 0.0f) options.fadeFactor = c_options.fadeFactor;
+    if (c_options.fadeToBlack != 0) options.fadeMode = Scenario::FadeMode::ToBlack;
+    if (c_options.boundary == 1) options.boundary = Scenario::Boundary::Wrap;
+    if (c_options.boundary == 2) options.boundary = Scenario::Boundary::Reflect;
+    if (c_options.immortalTraces != 0) options.lifetime = Scenario::Lifetime::Immortal;
+    if (c_options.collision == 1) options.collision = Scenario::Collision::Kill;
+    if (c_options.collision == 2) options.collision = Scenario::Collision::Merge;
+    options.avoidancePixels = c_options.avoidancePixels;
+    if (c_options.avoidanceWeight > 0.0f) options.avoidanceWeight = c_options.avoidanceWeight;
+    options.attraction = c_options.attraction;
+    if (c_options.attractionOpeningAngle > 0.0f) options.attractionOpeningAngle = c_options.attractionOpeningAngle;
+    options.offscreen = headlessContextCurrent();
 
     return options;
 }
@@ -40,34 +142,281 @@ ScenarioHandle newScenario(TracesScenarioOptions c_options)
         std::cerr << "could not create Scenario: " << err.value() << std::endl;
         return SCENARIO_HANDLE_INVALID;
     }
-    auto usedHandle = ++nextHandle;
-    g_mapScenarios[usedHandle] = pScenario;
+    auto usedHandle = g_scenarios.insert(pScenario);
+    if (usedHandle == SCENARIO_HANDLE_INVALID)
+    {
+        std::cerr << "could not create Scenario: too many scenarios" << std::endl;
+    }
     return usedHandle;
 }
 
-void releaseScenario(ScenarioHandle handle)
+ScenarioHandle newScenarioAsync(TracesScenarioOptions c_options)
 {
-    auto itScenario = g_mapScenarios.find(handle);
-    if (itScenario != g_mapScenarios.end())
+    auto [pScenario, err] = Scenario::makeAsync(c_options.initialTraceCount,
+                                                glm::ivec2{c_options.width, c_options.height},
+                                                toScenarioOptions(c_options));
+    if (err != nil)
+    {
+        std::cerr << "could not create Scenario: " << err.value() << std::endl;
+        return SCENARIO_HANDLE_INVALID;
+    }
+    auto usedHandle = g_scenarios.insert(pScenario);
+    if (usedHandle == SCENARIO_HANDLE_INVALID)
     {
-        g_mapScenarios.erase(itScenario);
+        std::cerr << "could not create Scenario: too many scenarios" << std::endl;
     }
+    return usedHandle;
+}
+
+int scenarioReady(ScenarioHandle handle)
+{
+    auto pScenario = g_scenarios.acquire(handle);
+    if (!pScenario) return -1;
+    auto [ready, err] = pScenario->advanceSetup();
+    if (err != nil) return -1;
+    return ready ? 1 : 0;
+}
+
+ScenarioHandle loadScenario(TracesScenarioOptions c_options, char const* path)
+{
+    if (!path) return SCENARIO_HANDLE_INVALID;
+    auto [pScenario, err] = Scenario::load(path,
+                                           glm::ivec2{c_options.width, c_options.height},
+                                           toScenarioOptions(c_options));
+    if (err != nil)
+    {
+        std::cerr << "could not load Scenario: " << err.value() << std::endl;
+        return SCENARIO_HANDLE_INVALID;
+    }
+    auto usedHandle = g_scenarios.insert(pScenario);
+    if (usedHandle == SCENARIO_HANDLE_INVALID)
+    {
+        std::cerr << "could not load Scenario: too many scenarios" << std::endl;
+    }
+    return usedHandle;
+}
+
+int saveScenario(ScenarioHandle handle, char const* path, int includeFeedbackTexture)
+{
+    if (!path) return -1;
+    auto pScenario = g_scenarios.acquire(handle);
+    if (!pScenario) return -1;
+    auto err = pScenario->save(path, includeFeedbackTexture != 0);
+    if (err != nil)
+    {
+        std::cerr << "could not save Scenario: " << err.value() << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+int startRecording(ScenarioHandle handle, char const* path, int compress)
+{
+    if (!path) return -1;
+    auto pScenario = g_scenarios.acquire(handle);
+    if (!pScenario) return -1;
+    auto err = pScenario->startRecording(path, compress != 0);
+    if (err != nil)
+    {
+        std::cerr << "could not start recording: " << err.value() << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+int stopRecording(ScenarioHandle handle)
+{
+    auto pScenario = g_scenarios.acquire(handle);
+    if (!pScenario) return -1;
+    auto [droppedFrames, err] = pScenario->stopRecording();
+    if (err != nil)
+    {
+        std::cerr << "could not stop recording: " << err.value() << std::endl;
+        return -1;
+    }
+    return static_cast<int>(droppedFrames);
+}
+
+ScenarioHandle newReplayScenario(TracesScenarioOptions c_options, char const* path, float speed)
+{
+    if (!path) return SCENARIO_HANDLE_INVALID;
+    auto [pScenario, err] = Scenario::makeReplay(path,
+                                                 glm::ivec2{c_options.width, c_options.height},
+                                                 toScenarioOptions(c_options),
+                                                 speed);
+    if (err != nil)
+    {
+        std::cerr << "could not create replay Scenario: " << err.value() << std::endl;
+        return SCENARIO_HANDLE_INVALID;
+    }
+    auto usedHandle = g_scenarios.insert(pScenario);
+    if (usedHandle == SCENARIO_HANDLE_INVALID)
+    {
+        std::cerr << "could not create replay Scenario: too many scenarios" << std::endl;
+    }
+    return usedHandle;
+}
+
+int publishScenarioFrames(ScenarioHandle handle, size_t slotCount)
+{
+    auto pScenario = g_scenarios.acquire(handle);
+    if (!pScenario) return -1;
+    if (slotCount == 0)
+    {
+        pScenario->setFrameSink(nullptr);
+        return 0;
+    }
+    if (!pScenario->ready())
+    {
+        std::cerr << "could not publish Scenario frames: scenario is not set up yet" << std::endl;
+        return -1;
+    }
+    auto [pRing, err] = SharedFrameRing::make(pScenario->m_pDoubleFramebuffer->screenSize, slotCount);
+    if (err == nil) err = pScenario->setFrameSink(pRing);
+    if (err != nil)
+    {
+        std::cerr << "could not publish Scenario frames: " << err.value() << std::endl;
+        return -1;
+    }
+    return pRing->fd();
+}
+
+int useCurlNoiseFlowField(ScenarioHandle handle, int cellsX, int cellsY, float featureSize, unsigned int seed, float weight)
+{
+    auto pScenario = g_scenarios.acquire(handle);
+    if (!pScenario) return -1;
+    auto [pField, err] = FlowField::makeCurlNoise(glm::ivec2{cellsX, cellsY}, featureSize, seed);
+    if (err != nil)
+    {
+        std::cerr << "could not generate flow field: " << err.value() << std::endl;
+        return -1;
+    }
+    pScenario->m_options.pFlowField = pField;
+    pScenario->m_options.flowWeight = weight;
+    return 0;
+}
+
+int loadScenarioFlowField(ScenarioHandle handle, char const* path, float weight)
+{
+    if (!path) return -1;
+    auto pScenario = g_scenarios.acquire(handle);
+    if (!pScenario) return -1;
+    auto [pField, err] = FlowField::load(path);
+    if (err != nil)
+    {
+        std::cerr << err.value() << std::endl;
+        return -1;
+    }
+    pScenario->m_options.pFlowField = pField;
+    pScenario->m_options.flowWeight = weight;
+    return 0;
+}
+
+void clearScenarioFlowField(ScenarioHandle handle)
+{
+    auto pScenario = g_scenarios.acquire(handle);
+    if (!pScenario) return;
+    pScenario->m_options.pFlowField.reset();
+}
+
+void steerScenarioFlowField(ScenarioHandle handle, float x, float y, float radius, float dx, float dy, float strength)
+{
+    auto pScenario = g_scenarios.acquire(handle);
+    if (!pScenario) return;
+    auto& pField = pScenario->m_options.pFlowField;
+    if (!pField)
+    {
+        auto [pEmptyField, err] = FlowField::make(kDefaultFlowFieldCells);
+        if (err != nil)
+        {
+            std::cerr << "could not make flow field: " << err.value() << std::endl;
+            return;
+        }
+        pField = pEmptyField;
+    }
+    // the field runs bottom up
+    pField->steer(glm::vec2{x, 1.0f - y}, radius, glm::vec2{dx, -dy}, strength);
+}
+
+int loadScenarioObstacleMask(ScenarioHandle handle, char const* path, int invert, int deflect)
+{
+    if (!path) return -1;
+    auto pScenario = g_scenarios.acquire(handle);
+    // the initial traces may still be spawning on a worker thread
+    if (!pScenario || !pScenario->ready()) return -1;
+    auto [pMask, err] = ObstacleMask::load(path, invert != 0);
+    if (err != nil)
+    {
+        std::cerr << err.value() << std::endl;
+        return -1;
+    }
+    pScenario->setObstacleMask(pMask, deflect ? Scenario::ObstacleResponse::Deflect : Scenario::ObstacleResponse::Kill);
+    return 0;
+}
+
+int clearScenarioObstacleMask(ScenarioHandle handle)
+{
+    auto pScenario = g_scenarios.acquire(handle);
+    if (!pScenario || !pScenario->ready()) return -1;
+    pScenario->setObstacleMask(nullptr, pScenario->m_options.obstacleResponse);
+    return 0;
+}
+
+void releaseScenario(ScenarioHandle handle)
+{
+    g_scenarios.remove(handle);
 }
 
 void stepScenario(ScenarioHandle handle)
 {
-    auto itScenario = g_mapScenarios.find(handle);
-    if (itScenario != g_mapScenarios.end())
+    if (auto pScenario = g_scenarios.acquire(handle))
     {
-        itScenario->second->step();
+        pScenario->step();
     }
 }
 
+void stepScenarios(ScenarioHandle const* handles, size_t count)
+{
+    withScenarios(handles, count, [](Scenario* const* ppScenarios, std::size_t scenarioCount)
+    {
+        Scenario::stepAll(ppScenarios, scenarioCount);
+    });
+}
+
 void drawScenario(ScenarioHandle handle)
 {
-    auto itScenario = g_mapScenarios.find(handle);
-    if (itScenario != g_mapScenarios.end())
+    if (auto pScenario = g_scenarios.acquire(handle))
+    {
+        pScenario->draw();
+    }
+}
+
+void drawScenarioToFramebuffer(ScenarioHandle handle, unsigned int fbo, int x, int y, int width, int height)
+{
+    auto pScenario = g_scenarios.acquire(handle);
+    if (!pScenario) return;
+    GlStateGuard stateGuard;
+    pScenario->drawTo(fbo, glm::ivec4{x, y, width, height});
+}
+
+int drawScenarioToTexture(ScenarioHandle handle, unsigned int texture)
+{
+    auto pScenario = g_scenarios.acquire(handle);
+    if (!pScenario) return -1;
+    GlStateGuard stateGuard;
+    auto err = pScenario->drawToTexture(texture);
+    if (err != nil)
     {
-        itScenario->second->draw();
+        std::cerr << "could not draw Scenario to texture: " << err.value() << std::endl;
+        return -1;
     }
+    return 0;
+}
+
+void drawScenarios(ScenarioHandle const* handles, size_t count)
+{
+    withScenarios(handles, count, [](Scenario* const* ppScenarios, std::size_t scenarioCount)
+    {
+        Scenario::drawAll(ppScenarios, scenarioCount);
+    });
 }
@@ -23,18 +23,154 @@ struct TracesScenarioOptions
     float splitProbability;
     size_t stepPeriodMs;
 
+    /* not used, scenarios made through this API draw without blur */
     float traceBlurStandardDeviation;
 
     float colorR;
     float colorG;
     float colorB;
+
+    /* segments shorter than this many pixels are merged with the following steps, 0 disables */
+    float minSegmentPixels;
+
+    /* trace width in pixels, 0 means 1 */
+    float lineWidth;
+    /* non-zero lowers the render resolution and line width in steps while the smoothed frame time
+     * (GPU time where it can be measured) is above 0.45 stepPeriodMs, 0.9 of the half of the step
+     * period a scenario budgets for its frames, and raises them again after the CPU and GPU times
+     * both stayed below 0.3 stepPeriodMs for 120 frames */
+    int adaptiveQuality;
+
+    /* non-zero smooths the edges of the traces */
+    int lineAntialiasing;
+    /* non-zero blends from colorRGB at the bottom of the window to secondaryColorRGB at the top */
+    int colorGradient;
+    float secondaryColorR;
+    float secondaryColorG;
+    float secondaryColorB;
+    /* share of their brightness the trails keep per step, 0 means 0.985; with fadeToBlack non-zero
+     * they lose 1 - fadeFactor of full brightness per step instead and end at black */
+    float fadeFactor;
+    int fadeToBlack;
+
+    /* traces reaching the edge of the window: 0 die, 1 come back in on the opposite side, 2 bounce off */
+    int boundary;
+    /* non-zero lets traces live until they reach a boundary that kills them */
+    int immortalTraces;
+
+    /* a trace crossing the trail an older trace drew in the same step: 0 passes, 1 dies, 2 dies
+     * joined to it at the crossing */
+    int collision;
+    /* traces turn away from traces nearer than this many pixels, 0 disables; avoidanceWeight from
+     * 0 to 1 is how hard, 0 means 0.5 */
+    float avoidancePixels;
+    float avoidanceWeight;
+
+    /* traces bend towards the tips of the others, or away from them when negative; about 1 turns a
+     * trace fully towards a crowd half the window height away, 0 disables. attractionOpeningAngle
+     * trades accuracy for speed, larger is faster, 0 means 0.8 */
+    float attraction;
+    float attractionOpeningAngle;
 };
 
+/* Creates an offscreen OpenGL context (EGL, surfaceless where Mesa supports it, else a pbuffer) and
+ * makes it current on the calling thread, for hosts without a window system. Scenarios created while
+ * it is current render only into their own framebuffers. Returns 0 on success, -1 when EGL is not
+ * available. destroyHeadlessContext must not be called before every scenario created in it is released. */
+int            createHeadlessContext(void);
+void           destroyHeadlessContext(void);
+
+/* Linked shader programs are cached on disk so that later processes skip compiling them, in
+ * $TRACES_PROGRAM_CACHE_DIR, else $XDG_CACHE_HOME/traces/programs or ~/.cache/traces/programs
+ * (%LOCALAPPDATA%\traces\programs on Windows). Setting TRACES_PROGRAM_CACHE_DIR to an empty string
+ * disables the cache. */
+
+/* All functions may be called concurrently from several threads, as long as calls on one handle
+ * do not overlap (releaseScenario excepted: it waits for in-flight calls on its handle to return).
+ * newScenario, releaseScenario and the draw functions need the scenario's GL context to be current;
+ * stepScenario does not touch GL. A released handle stays invalid: its slot is handed out again
+ * only under a new generation. */
 ScenarioHandle newScenario(struct TracesScenarioOptions c_options);
 void           releaseScenario(ScenarioHandle handle);
 void           stepScenario(ScenarioHandle handle);
 void           drawScenario(ScenarioHandle handle);
 
+/* Like newScenario, but returns at once. Shaders compile on the driver's threads where
+ * GL_KHR_parallel_shader_compile is available (or come from the program cache) and the initial
+ * traces are generated on a worker thread. Every draw call and scenarioReady call moves the setup on
+ * without blocking (both need the GL context the scenario was created in); until it is done the
+ * scenario steps and draws nothing. scenarioReady returns 1 once the scenario is ready, 0 while it
+ * is being set up and -1 if the setup failed or the handle is invalid. */
+ScenarioHandle newScenarioAsync(struct TracesScenarioOptions c_options);
+int            scenarioReady(ScenarioHandle handle);
+
+/* Steps count scenarios in parallel on a library-wide thread pool, large scenarios split into chunks,
+ * and returns once all of them have finished the tick. */
+void           stepScenarios(ScenarioHandle const* handles, size_t count);
+
+/* Saves the scenario's traces, simulation clock and random state (and, when includeFeedbackTexture
+ * is non-zero, the trails drawn so far, which needs the GL context) to path. Returns 0 on success. */
+int            saveScenario(ScenarioHandle handle, char const* path, int includeFeedbackTexture);
+/* Like newScenario, but starts from a snapshot written by saveScenario instead of initialTraceCount
+ * random traces. */
+ScenarioHandle loadScenario(struct TracesScenarioOptions c_options, char const* path);
+
+/* Records the segments drawn by every step of the scenario to path, LZ4-style compressed when
+ * compress is non-zero. Returns 0 on success. stopRecording returns the number of frames that were
+ * dropped because the disk could not keep up, or -1 if the recording could not be finished. */
+int            startRecording(ScenarioHandle handle, char const* path, int compress);
+int            stopRecording(ScenarioHandle handle);
+/* Scenario replaying a recording at speed recorded frames per stepScenario call, without simulating.
+ * c_options gives the window size; color comes from the recording. Like every scenario made through
+ * this API, it draws without blur. */
+ScenarioHandle newReplayScenario(struct TracesScenarioOptions c_options, char const* path, float speed);
+
+/* Steer the scenario's traces along a flow field, pulled towards it by weight from 0 (plain random
+ * walk) to 1. useCurlNoiseFlowField generates swirls about featureSize (a fraction of the window)
+ * across on a cellsX by cellsY grid; loadScenarioFlowField reads a PGM image whose gray levels are
+ * directions, black pointing right and going round counterclockwise to white. Both return 0 on
+ * success. clearScenarioFlowField goes back to the random walk.
+ * steerScenarioFlowField turns the field within radius of (x, y) towards (dx, dy), by strength (0 to
+ * 1) at the center fading out towards radius, e.g. following the cursor. Positions and radius are
+ * fractions of the window, from its top left, and dy points down. A scenario without a field gets an
+ * empty one first, in which traces keep walking randomly until steered. None of these need the GL
+ * context. */
+int            useCurlNoiseFlowField(ScenarioHandle handle, int cellsX, int cellsY, float featureSize, unsigned int seed, float weight);
+int            loadScenarioFlowField(ScenarioHandle handle, char const* path, float weight);
+void           clearScenarioFlowField(ScenarioHandle handle);
+void           steerScenarioFlowField(ScenarioHandle handle, float x, float y, float radius, float dx, float dy, float strength);
+
+/* Confines the scenario's traces to the light parts of a PGM image stretched over the window, or to
+ * the dark parts when invert is non-zero. Traces stepping elsewhere die, or turn away from the edge
+ * when deflect is non-zero, and new traces only spawn in the allowed parts. Both return 0 on success
+ * and -1 on failure, including while a scenario from newScenarioAsync is not ready yet. Neither needs
+ * the GL context. */
+int            loadScenarioObstacleMask(ScenarioHandle handle, char const* path, int invert, int deflect);
+int            clearScenarioObstacleMask(ScenarioHandle handle);
+
+/* Publishes every frame the scenario draws into a shared memory ring of slotCount frames, read back
+ * from the GPU asynchronously, and returns a file descriptor of the ring that other processes can map
+ * with traces_frame_ring.h (pass it over a unix socket or open /proc/<pid>/fd/<fd>). Returns -1 on
+ * failure or on platforms without memfd. slotCount 0 stops publishing, closes the descriptor and
+ * returns 0.
+ * Needs the scenario's GL context. */
+int            publishScenarioFrames(ScenarioHandle handle, size_t slotCount);
+
+/* Like drawScenario, but present the finished frame into the host's framebuffer fbo, covering the
+ * viewport (x, y, width, height), or into all of level 0 of texture, a color-renderable GL_TEXTURE_2D,
+ * instead of the default framebuffer. drawScenarioToTexture returns 0 on success.
+ * Host state contract: framebuffer bindings, viewport, program, array and pixel pack buffer bindings,
+ * the vertex array object binding, the active texture unit, the 2D texture of unit 0, the clear color,
+ * the pack alignment and the enables of blending, culling, depth, stencil and scissor tests and sRGB
+ * conversion are restored before returning; these enables are ignored while drawing. Attribute
+ * arrays of vertex array object 0 may be changed. Any other state must be at its default. */
+void           drawScenarioToFramebuffer(ScenarioHandle handle, unsigned int fbo, int x, int y, int width, int height);
+int            drawScenarioToTexture(ScenarioHandle handle, unsigned int texture);
+
+/* Draws count scenarios in one go, binding the programs they share once per pass.
+ * All scenarios must have been created in the same GL context (or in contexts sharing objects). */
+void           drawScenarios(ScenarioHandle const* handles, size_t count);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,209 @@
+// Fails if stepping and drawing scenarios, or running batches on a ThreadPool, allocate from the heap
+// once they have warmed up. Every form of operator new is replaced and counted on all threads, so
+// allocations made by the pool's workers count as well.
+
+#include "ThreadPool.h"
+#include "traces_render.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <vector>
+
+namespace {
+
+std::atomic<bool> g_countAllocations{false};
+std::atomic<std::size_t> g_allocations{0};
+
+std::size_t const kScenarioCount{3};
+std::size_t const kWarmupFrames{300};
+std::size_t const kCountedFrames{300};
+std::size_t const kPoolWorkers{3};
+std::size_t const kPoolBatches{200};
+std::size_t const kPoolTasksPerBatch{97};
+// returned when there is no headless context to render in, see add_test in CMakeLists.txt
+int const kSkipped{77};
+
+void* allocate(std::size_t size)
+{
+    if (g_countAllocations.load(std::memory_order_relaxed)) g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* allocateAligned(std::size_t size, std::align_val_t alignment)
+{
+    if (g_countAllocations.load(std::memory_order_relaxed)) g_allocations.fetch_add(1, std::memory_order_relaxed);
+    auto bytes = static_cast<std::size_t>(alignment);
+    // aligned_alloc wants a multiple of the alignment
+    std::size_t roundedSize = (std::max<std::size_t>(size, 1) + bytes - 1) / bytes * bytes;
+#ifdef _WIN32
+    return _aligned_malloc(roundedSize, bytes);
+#else
+    return std::aligned_alloc(bytes, roundedSize);
+#endif
+}
+
+void deallocate(void* p)
+{
+    std::free(p);
+}
+
+void deallocateAligned(void* p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+struct TracesScenarioOptions getOptions()
+{
+    struct TracesScenarioOptions options{};
+    options.width = 320;
+    options.height = 180;
+    options.initialTraceCount = 20;
+    options.maxTraces = 200;
+    options.splitProbability = 0.4f;
+    options.stepPeriodMs = 16;
+    options.colorG = 1.0f;
+    options.minSegmentPixels = 1.0f;
+    return options;
+}
+
+void countTask(void* pContext, std::size_t)
+{
+    static_cast<std::atomic<std::size_t>*>(pContext)->fetch_add(1, std::memory_order_relaxed);
+}
+
+// the steps and draws of kCountedFrames frames after kWarmupFrames, or -1 without a headless context
+long long countScenarioAllocations()
+{
+    if (createHeadlessContext() != 0) return -1;
+    std::vector<ScenarioHandle> handles;
+    for (std::size_t i = 0; i < kScenarioCount; i++)
+    {
+        ScenarioHandle handle = newScenario(getOptions());
+        if (handle == SCENARIO_HANDLE_INVALID) return -1;
+        handles.push_back(handle);
+    }
+
+    for (std::size_t frame = 0; frame < kWarmupFrames + kCountedFrames; frame++)
+    {
+        g_countAllocations = frame >= kWarmupFrames;
+        stepScenarios(handles.data(), handles.size());
+        drawScenarios(handles.data(), handles.size());
+        g_countAllocations = false;
+    }
+    std::size_t allocations = g_allocations.exchange(0);
+
+    for (auto handle : handles) releaseScenario(handle);
+    destroyHeadlessContext();
+    return static_cast<long long>(allocations);
+}
+
+// batches run through ThreadPool::run(count, fn, pContext) and parallelFor() once the queues have grown
+std::size_t countPoolAllocations()
+{
+    ThreadPool pool{kPoolWorkers};
+    std::atomic<std::size_t> done{0};
+    std::function<void(std::size_t, std::size_t)> range = [&done](std::size_t begin, std::size_t end)
+    {
+        done.fetch_add(end - begin, std::memory_order_relaxed);
+    };
+    for (std::size_t batch = 0; batch < 2 * kPoolBatches; batch++)
+    {
+        g_countAllocations = batch >= kPoolBatches;
+        pool.run(kPoolTasksPerBatch, countTask, &done);
+        pool.parallelFor(kPoolTasksPerBatch, 7, range);
+        g_countAllocations = false;
+    }
+    if (done != 4 * kPoolBatches * kPoolTasksPerBatch)
+    {
+        std::cerr << "the pool ran " << done << " of " << 4 * kPoolBatches * kPoolTasksPerBatch << " tasks" << std::endl;
+        return static_cast<std::size_t>(-1);
+    }
+    return g_allocations.exchange(0);
+}
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    if (void* p = allocate(size)) return p;
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size)
+{
+    if (void* p = allocate(size)) return p;
+    throw std::bad_alloc{};
+}
+
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size, std::nothrow_t const&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    if (void* p = allocateAligned(size, alignment)) return p;
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    if (void* p = allocateAligned(size, alignment)) return p;
+    throw std::bad_alloc{};
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, std::nothrow_t const&) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, std::nothrow_t const&) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void operator delete(void* p) noexcept { deallocate(p); }
+void operator delete[](void* p) noexcept { deallocate(p); }
+void operator delete(void* p, std::size_t) noexcept { deallocate(p); }
+void operator delete[](void* p, std::size_t) noexcept { deallocate(p); }
+void operator delete(void* p, std::nothrow_t const&) noexcept { deallocate(p); }
+void operator delete[](void* p, std::nothrow_t const&) noexcept { deallocate(p); }
+void operator delete(void* p, std::align_val_t) noexcept { deallocateAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { deallocateAligned(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { deallocateAligned(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { deallocateAligned(p); }
+void operator delete(void* p, std::align_val_t, std::nothrow_t const&) noexcept { deallocateAligned(p); }
+void operator delete[](void* p, std::align_val_t, std::nothrow_t const&) noexcept { deallocateAligned(p); }
+
+int main()
+{
+    int result = 0;
+
+    std::size_t poolAllocations = countPoolAllocations();
+    std::cerr << poolAllocations << " heap allocations in " << kPoolBatches << " warm thread pool batches" << std::endl;
+    if (poolAllocations != 0) result = 1;
+
+    long long scenarioAllocations = countScenarioAllocations();
+    if (scenarioAllocations < 0)
+    {
+        std::cerr << "no headless context, scenarios not checked" << std::endl;
+        return result != 0 ? result : kSkipped;
+    }
+    std::cerr << scenarioAllocations << " heap allocations in " << kCountedFrames << " steps and draws of "
+              << kScenarioCount << " scenarios after " << kWarmupFrames << " warm-up frames" << std::endl;
+    if (scenarioAllocations != 0) result = 1;
+    return result;
+}
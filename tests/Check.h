@@ -0,0 +1,27 @@
+#pragma once
+
+#include <iostream>
+
+// What the tests here report failures with: check() prints and counts every condition that does
+// not hold, and main() returns checkResult().
+
+inline int& checkFailures()
+{
+    static int failures{0};
+    return failures;
+}
+
+inline void check(bool condition, char const* what)
+{
+    if (condition) return;
+    std::cerr << "failed: " << what << std::endl;
+    checkFailures()++;
+}
+
+// 0 after printing passed when every check held, 1 otherwise
+inline int checkResult(char const* passed)
+{
+    if (checkFailures() != 0) return 1;
+    std::cerr << passed << std::endl;
+    return 0;
+}
@@ -0,0 +1,118 @@
+// Checks that FlowField::steer() keeps the cells it turns at full length, so that traces sampling
+// them turn as hard and move as fast as before the field was steered.
+
+#include "Check.h"
+#include "FlowField.h"
+#include "RandomSource.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+glm::ivec2 const kCells{16, 16};
+float const kTolerance{1e-4f};
+// Trace::steeredDirection() measures angles with fastAtan2()
+float const kAngleTolerance{0.005f};
+float const kPi{3.14159265359f};
+
+float length(glm::vec2 const& v)
+{
+    return std::sqrt(v.x * v.x + v.y * v.y);
+}
+
+// every cell pointing at angle
+std::shared_ptr<FlowField> makeUniformField(float angle)
+{
+    auto [pField, err] = FlowField::make(kCells);
+    if (err != nil) return nullptr;
+    for (int y = 0; y < kCells.y; y++)
+    {
+        for (int x = 0; x < kCells.x; x++) pField->set(glm::ivec2{x, y}, angle);
+    }
+    return pField;
+}
+
+// the field sampled at the center of every cell, with the field spanning (0, 0) to (1, 1)
+template <typename F>
+void forEachCell(FlowField const& field, F&& f)
+{
+    for (int y = 0; y < kCells.y; y++)
+    {
+        for (int x = 0; x < kCells.x; x++)
+        {
+            glm::vec2 position = (glm::vec2{static_cast<float>(x), static_cast<float>(y)} + 0.5f) / glm::vec2{kCells};
+            glm::vec2 direction;
+            field.sample(&position, 1, glm::vec2{0.0f, 0.0f}, glm::vec2{1.0f, 1.0f}, &direction);
+            f(direction);
+        }
+    }
+}
+
+void testUnitCellsStayUnit()
+{
+    for (float steerAngle : {0.5f * kPi, 0.75f * kPi, kPi})
+    {
+        for (float strength : {0.1f, 0.5f, 0.9f, 1.0f})
+        {
+            auto pField = makeUniformField(0.0f);
+            pField->steer(glm::vec2{0.5f, 0.5f}, 0.4f, glm::vec2{std::cos(steerAngle), std::sin(steerAngle)}, strength);
+            bool unit = true;
+            forEachCell(*pField, [&](glm::vec2 const& direction)
+            {
+                unit = unit && std::abs(length(direction) - 1.0f) < kTolerance;
+            });
+            check(unit, "steered cells of a unit field are unit vectors");
+        }
+    }
+}
+
+void testEmptyCellsFadeIn()
+{
+    auto [pField, err] = FlowField::make(kCells);
+    check(err == nil, "make an empty field");
+    if (err != nil) return;
+    pField->steer(glm::vec2{0.5f, 0.5f}, 0.4f, glm::vec2{0.0f, 1.0f}, 0.25f);
+    float longest{0.0f};
+    forEachCell(*pField, [&](glm::vec2 const& direction) { longest = std::max(longest, length(direction)); });
+    check(longest > 0.0f && longest <= 0.25f + kTolerance, "an empty field steered by 0.25 is at most 0.25 long");
+}
+
+// a trace heading along +x through cells turned half way to +y takes the cells' direction and
+// keeps moving the same distance every step
+void testTraceKeepsTurnAndSpeed()
+{
+    auto pField = makeUniformField(0.0f);
+    pField->steer(glm::vec2{0.5f, 0.5f}, 1.0f, glm::vec2{0.0f, 1.0f}, 0.5f);
+    glm::vec2 position{0.5f, 0.5f};
+    glm::vec2 steering;
+    pField->sample(&position, 1, glm::vec2{0.0f, 0.0f}, glm::vec2{1.0f, 1.0f}, &steering);
+    check(std::abs(length(steering) - 1.0f) < kTolerance, "the steered field samples to a unit vector");
+
+    RandomSource random;
+    Trace trace{glm::vec2{0.0f, 0.0f}, 0.0f, glm::vec3{1.0f}, std::chrono::steady_clock::now(), random, nullptr, nullptr};
+    float expected = std::atan2(steering.y, steering.x);
+    check(std::abs(trace.steeredDirection(steering, 1.0f) - expected) < kAngleTolerance, "a trace steered with weight 1 takes the field's direction");
+
+    std::chrono::milliseconds const stepPeriod{16};
+    // speeds are signed, a negative one moves the trace backwards
+    float const stepLength = std::abs(trace.speed_) * Trace::kMaxStepMagnitude * stepPeriod.count();
+    bool sameSpeed = true;
+    for (int i = 0; i < 100; i++)
+    {
+        trace.step(stepPeriod, steering, 1.0f, random);
+        sameSpeed = sameSpeed && std::abs(length(trace.position_ - trace.prevPosition_) - stepLength) < kTolerance * stepLength + 1e-6f;
+    }
+    check(sameSpeed, "a steered trace moves the same distance every step");
+}
+
+} // namespace
+
+int main()
+{
+    testUnitCellsStayUnit();
+    testEmptyCellsFadeIn();
+    testTraceKeepsTurnAndSpeed();
+    return checkResult("flow field steering keeps unit cells");
+}
@@ -0,0 +1,79 @@
+// Checks that MaintenanceScheduler::runUntil() runs nothing once a frame is out of time, runs a
+// long task again once its estimate fits the time left, and runs everything when there is time.
+
+#include "Check.h"
+#include "MaintenanceScheduler.h"
+#include <chrono>
+#include <cstddef>
+#include <thread>
+
+namespace {
+
+std::size_t const kCalls{100};
+std::size_t const kSlices{1000};
+std::chrono::milliseconds const kLongSlice{4};
+std::chrono::milliseconds const kTimeLeft{1};
+
+// a task of slices slices, counting the ones run into done
+MaintenanceScheduler::Task countingTask(std::size_t slices, std::size_t& done)
+{
+    return [slices, &done]
+    {
+        done++;
+        return done < slices;
+    };
+}
+
+void testPastDeadlineRunsNothing()
+{
+    MaintenanceScheduler scheduler;
+    std::size_t done{0};
+    scheduler.post(countingTask(kSlices, done));
+    auto const past = MaintenanceScheduler::Clock::now() - std::chrono::milliseconds{1};
+    for (std::size_t i = 0; i < kCalls; i++) scheduler.runUntil(past);
+    check(done == 0 && scheduler.pendingTasks() == 1, "calls past the deadline run no slice");
+}
+
+// a first slice longer than the frames leave holds the task back only until its estimate decays
+void testLongSliceRunsAgain()
+{
+    MaintenanceScheduler scheduler;
+    std::size_t done{0};
+    scheduler.post([&done]
+    {
+        if (done++ == 0) std::this_thread::sleep_for(kLongSlice);
+        return done < kSlices;
+    });
+    scheduler.runUntil(MaintenanceScheduler::Clock::now() + kTimeLeft);
+    check(done == 1, "a slice without an estimate starts when there is time left");
+
+    std::size_t calls{0};
+    while (done == 1 && calls < kCalls)
+    {
+        scheduler.runUntil(MaintenanceScheduler::Clock::now() + kTimeLeft);
+        calls++;
+    }
+    check(calls > 1, "a slice does not start while the last one says it will not fit");
+    check(done > 1, "a slice starts again once the decayed estimate fits");
+}
+
+void testTimeLeftRunsEverything()
+{
+    MaintenanceScheduler scheduler;
+    std::size_t first{0};
+    std::size_t second{0};
+    scheduler.post(countingTask(kSlices, first));
+    scheduler.post(countingTask(kSlices, second));
+    scheduler.runUntil(MaintenanceScheduler::Clock::now() + std::chrono::seconds{10});
+    check(first == kSlices && second == kSlices && scheduler.pendingTasks() == 0, "a far deadline runs every task to the end");
+}
+
+} // namespace
+
+int main()
+{
+    testPastDeadlineRunsNothing();
+    testLongSliceRunsAgain();
+    testTimeLeftRunsEverything();
+    return checkResult("maintenance runs only in the time frames leave");
+}